@@ -0,0 +1,230 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <streambuf>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "AssetArchive.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+
+static const char ARCHIVE_MAGIC[4] = { 'G', 'P', 'A', 'K' };
+
+struct ArchiveHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t alignment;
+    uint64_t table_offset; // entry_count ArchiveEntry records
+    uint64_t names_offset; // the paths, not terminated
+    uint64_t names_size;
+    uint8_t reserved[24];
+};
+
+struct ArchiveEntry {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t hash;
+    int64_t mtime;
+    uint32_t name_offset;
+    uint32_t name_length;
+    uint8_t reserved[8];
+};
+
+static_assert(sizeof(ArchiveHeader) == 64, "archive header must stay 64 bytes");
+static_assert(sizeof(ArchiveEntry) == 48, "archive entries are 48 bytes");
+
+/* Read-only view of a blob for the stream based loaders */
+class MemoryStreamBuffer : public std::streambuf {
+
+public:
+
+    MemoryStreamBuffer(const unsigned char* data, size_t size) {
+        char* begin = (char*)data;
+        setg(begin, begin, begin + size);
+    }
+
+};
+
+class MemoryStream : public std::istream {
+
+public:
+
+    MemoryStream(const unsigned char* data, size_t size) : std::istream(nullptr), buffer(data, size) {
+        rdbuf(&this->buffer);
+    }
+
+private:
+
+    MemoryStreamBuffer buffer;
+
+};
+
+/* The mounted archive, written once by mount() before anything reads it */
+static MappedFile mounted_file;
+static std::unordered_map<std::string, AssetBlob> mounted_blobs;
+
+static std::string normalize_path(const char* path) {
+    std::string normalized = path;
+    for (char& c : normalized) {
+        if (c == '\\') {
+            c = '/';
+        }
+    }
+    return normalized;
+}
+
+bool AssetArchive::mount(const char* path) {
+    mounted_blobs.clear();
+    mounted_file.close();
+
+    if (!mounted_file.open(path)) {
+        return false;
+    }
+
+    ArchiveHeader header;
+    if (mounted_file.size() < sizeof(header)) {
+        std::cout << "Asset archive " << path << " is truncated" << std::endl;
+        mounted_file.close();
+        return false;
+    }
+    memcpy(&header, mounted_file.data(), sizeof(header));
+
+    if (memcmp(header.magic, ARCHIVE_MAGIC, 4) != 0 || header.version != VERSION ||
+        header.table_offset + (uint64_t)header.entry_count * sizeof(ArchiveEntry) > mounted_file.size() ||
+        header.names_offset + header.names_size > mounted_file.size()) {
+        std::cout << "Asset archive " << path << " is not a version " << VERSION << " archive" << std::endl;
+        mounted_file.close();
+        return false;
+    }
+
+    const unsigned char* names = mounted_file.data() + header.names_offset;
+    for (uint32_t i = 0; i < header.entry_count; i++) {
+        ArchiveEntry entry;
+        memcpy(&entry, mounted_file.data() + header.table_offset + i * sizeof(ArchiveEntry), sizeof(entry));
+
+        if (entry.offset + entry.size > mounted_file.size() || (uint64_t)entry.name_offset + entry.name_length > header.names_size) {
+            std::cout << "Asset archive " << path << " has a broken entry, not using it" << std::endl;
+            mounted_blobs.clear();
+            mounted_file.close();
+            return false;
+        }
+
+        std::string name((const char*)names + entry.name_offset, entry.name_length);
+        mounted_blobs[name] = { mounted_file.data() + entry.offset, (size_t)entry.size, entry.hash, entry.mtime };
+    }
+
+    std::cout << "Mounted " << path << " with " << header.entry_count << " files" << std::endl;
+    return true;
+}
+
+bool AssetArchive::is_mounted() {
+    return mounted_file.is_open();
+}
+
+bool AssetArchive::find(const char* path, AssetBlob& blob) {
+    if (mounted_blobs.empty()) {
+        return false;
+    }
+
+    auto found = mounted_blobs.find(normalize_path(path));
+    if (found == mounted_blobs.end()) {
+        return false;
+    }
+    blob = found->second;
+    return true;
+}
+
+std::unique_ptr<std::istream> AssetArchive::open_stream(const char* path) {
+    AssetBlob blob;
+    if (find(path, blob)) {
+        return std::unique_ptr<std::istream>(new MemoryStream(blob.data, blob.size));
+    }
+    return std::unique_ptr<std::istream>(new std::ifstream(path, std::ios::binary));
+}
+
+bool AssetArchive::write(const char* output_path, const std::vector<std::string>& files) {
+    std::string temp_path = std::string(output_path) + ".tmp";
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cout << "Could not create " << temp_path << std::endl;
+        return false;
+    }
+
+    ArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    out.write((const char*)&header, sizeof(header));
+
+    std::vector<ArchiveEntry> entries;
+    std::string names;
+    uint64_t offset = sizeof(header);
+    const char padding[ALIGNMENT] = {};
+
+    for (const std::string& file : files) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) {
+            std::cout << "Could not read " << file << std::endl;
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(temp_path, ec);
+            return false;
+        }
+        std::vector<char> contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        /* Same key MeshCache builds for the loose file, so caches stay valid whichever way it is read */
+        std::error_code ec;
+        int64_t mtime = (int64_t)std::filesystem::last_write_time(file, ec).time_since_epoch().count();
+
+        std::string name = normalize_path(file.c_str());
+        ArchiveEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.offset = offset;
+        entry.size = contents.size();
+        entry.hash = MeshCache::hash_bytes(contents.data(), contents.size());
+        entry.mtime = ec ? 0 : mtime;
+        entry.name_offset = (uint32_t)names.size();
+        entry.name_length = (uint32_t)name.size();
+        entries.push_back(entry);
+        names += name;
+
+        out.write(contents.data(), contents.size());
+        offset += contents.size();
+
+        size_t pad = (size_t)((ALIGNMENT - offset % ALIGNMENT) % ALIGNMENT);
+        out.write(padding, pad);
+        offset += pad;
+    }
+
+    header.table_offset = offset;
+    out.write((const char*)entries.data(), entries.size() * sizeof(ArchiveEntry));
+    header.names_offset = offset + entries.size() * sizeof(ArchiveEntry);
+    header.names_size = names.size();
+    out.write(names.data(), names.size());
+
+    memcpy(header.magic, ARCHIVE_MAGIC, 4);
+    header.version = VERSION;
+    header.entry_count = (uint32_t)entries.size();
+    header.alignment = (uint32_t)ALIGNMENT;
+    out.seekp(0);
+    out.write((const char*)&header, sizeof(header));
+    out.close();
+
+    if (!out) {
+        std::cout << "Could not write " << temp_path << std::endl;
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, output_path, ec);
+    if (ec) {
+        std::cout << "Could not replace " << output_path << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* A file inside the mounted archive, pointing straight into the mapping */
+struct AssetBlob {
+    const unsigned char* data;
+    size_t size;
+    uint64_t hash; // MeshCache::hash_bytes of the contents
+    int64_t mtime; // of the loose file it was packed from
+};
+
+/*
+ * Single file asset archive. A 64 byte header is followed by every file's contents, each starting on a
+ * 64 byte boundary, then a table of offsets and the relative paths they were packed from. The archive is
+ * mapped once with mount() and loaders look their files up by the same relative path they would open,
+ * anything not in it is still read from disk. Built by the assetpacker target.
+ */
+class AssetArchive {
+
+public:
+
+    static const uint32_t VERSION = 1;
+
+    /* Blob alignment, enough for any SIMD load the parsers do on the contents */
+    static const size_t ALIGNMENT = 64;
+
+    /* Maps path and indexes its table. Call before any loader threads start, lookups never lock */
+    static bool mount(const char* path);
+
+    static bool is_mounted();
+
+    static bool find(const char* path, AssetBlob& blob);
+
+    /* The packed file as a stream without copying it, or the loose file if it is not packed */
+    static std::unique_ptr<std::istream> open_stream(const char* path);
+
+    /* Packs files (relative paths) into an archive at output_path, returns false if any could not be read */
+    static bool write(const char* output_path, const std::vector<std::string>& files);
+
+};
@@ -0,0 +1,194 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+
+#include "AssetCooker.h"
+
+static const char MANIFEST_MAGIC[] = "GCOOK";
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+AssetCooker::AssetCooker(const std::string& manifest_path) {
+    this->manifest_path = manifest_path;
+    this->wall_ms = 0.0;
+    this->thread_count = 0;
+}
+
+void AssetCooker::add(const std::string& input, const std::string& output, uint32_t format_version, std::function<bool()> cook) {
+    this->jobs.push_back({ input, output, format_version, std::move(cook) });
+}
+
+bool AssetCooker::stat_input(const std::string& input, uint64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    size = (uint64_t)std::filesystem::file_size(input, ec);
+    if (ec) {
+        return false;
+    }
+    mtime = (int64_t)std::filesystem::last_write_time(input, ec).time_since_epoch().count();
+    return !ec;
+}
+
+void AssetCooker::load_manifest() {
+    this->records.clear();
+
+    std::ifstream in(this->manifest_path);
+    std::string magic;
+    uint32_t version = 0;
+    if (!(in >> magic >> version) || magic != MANIFEST_MAGIC || version != VERSION) {
+        /* Missing or from another version, everything gets cooked */
+        return;
+    }
+    in.ignore(1);
+
+    /* output, input, input size, input mtime, format version, tab separated */
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string output;
+        Record record;
+        if (std::getline(fields, output, '\t') && std::getline(fields, record.input, '\t') &&
+            fields >> record.input_size >> record.input_mtime >> record.format_version) {
+            this->records[output] = record;
+        }
+    }
+}
+
+bool AssetCooker::save_manifest() {
+    std::string temp_path = this->manifest_path + ".tmp";
+    std::ofstream out(temp_path, std::ios::trunc);
+    if (!out) {
+        std::cout << "Could not write " << temp_path << std::endl;
+        return false;
+    }
+
+    out << MANIFEST_MAGIC << " " << VERSION << "\n";
+    for (const auto& entry : this->records) {
+        const Record& record = entry.second;
+        out << entry.first << "\t" << record.input << "\t" << record.input_size << "\t" << record.input_mtime << "\t" << record.format_version << "\n";
+    }
+    out.close();
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, this->manifest_path, ec);
+    if (!out || ec) {
+        std::cout << "Could not replace " << this->manifest_path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool AssetCooker::run(ThreadPool& pool, bool force) {
+    auto start = std::chrono::steady_clock::now();
+    this->thread_count = pool.size();
+    this->results.assign(this->jobs.size(), CookResult());
+    this->load_manifest();
+
+    /* Only stats here, an output is stale when its input was touched, its format changed or it went missing */
+    std::vector<size_t> stale;
+    std::vector<Record> keys(this->jobs.size());
+    for (size_t i = 0; i < this->jobs.size(); i++) {
+        const Job& job = this->jobs[i];
+        CookResult& result = this->results[i];
+        result.input = job.input;
+        result.output = job.output;
+        result.cooked = false;
+        result.failed = false;
+        result.ms = 0.0;
+        result.output_bytes = 0;
+
+        Record& key = keys[i];
+        key.input = job.input;
+        key.format_version = job.format_version;
+        if (!stat_input(job.input, key.input_size, key.input_mtime)) {
+            std::cout << "Missing input " << job.input << std::endl;
+            result.failed = true;
+            continue;
+        }
+
+        auto found = this->records.find(job.output);
+        bool up_to_date = !force && found != this->records.end() &&
+            found->second.input == key.input &&
+            found->second.input_size == key.input_size &&
+            found->second.input_mtime == key.input_mtime &&
+            found->second.format_version == key.format_version &&
+            std::filesystem::exists(job.output);
+        if (!up_to_date) {
+            stale.push_back(i);
+        }
+    }
+
+    ThreadPool::for_each(&pool, stale.size(), [this, &stale, force](size_t i) {
+        const Job& job = this->jobs[stale[i]];
+        CookResult& result = this->results[stale[i]];
+
+        /* The loaders cooking an output return early when it is still valid, forced jobs have to start without one */
+        auto cook_start = std::chrono::steady_clock::now();
+        if (force) {
+            std::error_code ec;
+            std::filesystem::remove(job.output, ec);
+        }
+        result.cooked = true;
+        result.failed = !job.cook() || !std::filesystem::exists(job.output);
+        result.ms = elapsed_ms(cook_start);
+    });
+
+    bool success = true;
+    for (size_t i = 0; i < this->jobs.size(); i++) {
+        CookResult& result = this->results[i];
+        if (result.failed) {
+            /* Forget it so the next run tries again */
+            this->records.erase(result.output);
+            success = false;
+            continue;
+        }
+
+        std::error_code ec;
+        result.output_bytes = (size_t)std::filesystem::file_size(result.output, ec);
+        if (result.cooked) {
+            this->records[result.output] = keys[i];
+        }
+    }
+
+    success = this->save_manifest() && success;
+    this->wall_ms = elapsed_ms(start);
+    return success;
+}
+
+const std::vector<CookResult>& AssetCooker::get_results() {
+    return this->results;
+}
+
+void AssetCooker::print_report() {
+    size_t cooked = 0;
+    size_t failed = 0;
+    size_t output_bytes = 0;
+    double cook_ms = 0.0;
+
+    std::cout << "Asset cooker\n";
+    for (const CookResult& result : this->results) {
+        const char* status = result.failed ? "FAILED" : result.cooked ? "cooked" : "up to date";
+        cooked += result.cooked && !result.failed ? 1 : 0;
+        failed += result.failed ? 1 : 0;
+        output_bytes += result.output_bytes;
+        cook_ms += result.ms;
+
+        char line[512];
+        snprintf(line, sizeof(line), "  %-24s -> %-34s %-10s %9.1f ms %8.2f MB\n",
+            result.input.c_str(), result.output.c_str(), status, result.ms, result.output_bytes / (1024.0 * 1024.0));
+        std::cout << line;
+    }
+
+    char summary[256];
+    snprintf(summary, sizeof(summary), "  %zu cooked, %zu up to date, %zu failed, %.2f MB of output\n",
+        cooked, this->results.size() - cooked - failed, failed, output_bytes / (1024.0 * 1024.0));
+    std::cout << summary;
+
+    snprintf(summary, sizeof(summary), "  %.1f ms of cooking in %.1f ms on %u threads\n", cook_ms, this->wall_ms, this->thread_count);
+    std::cout << summary << std::flush;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+
+/* Outcome of one job in the last run */
+struct CookResult {
+    std::string input;
+    std::string output;
+    bool cooked; // false when it was already up to date
+    bool failed;
+    double ms;
+    size_t output_bytes;
+};
+
+/*
+ * Keeps runtime ready files in sync with the assets they are built from. Every job turns one input into one
+ * output written in some format version, and a manifest remembers the input size and mtime each output was
+ * cooked from. A run only stats the inputs and cooks, in parallel, the jobs whose input, format or output changed.
+ */
+class AssetCooker {
+
+public:
+
+    /* Bump whenever the manifest layout changes */
+    static const uint32_t VERSION = 1;
+
+    explicit AssetCooker(const std::string& manifest_path);
+
+    /* cook writes output from input and returns false if it could not, format_version is the output format's VERSION */
+    void add(const std::string& input, const std::string& output, uint32_t format_version, std::function<bool()> cook);
+
+    /* Cooks every job that is out of date, or all of them with force, which deletes their outputs first. Returns false if any failed */
+    bool run(ThreadPool& pool, bool force);
+
+    const std::vector<CookResult>& get_results();
+
+    void print_report();
+
+private:
+
+    struct Job {
+        std::string input;
+        std::string output;
+        uint32_t format_version;
+        std::function<bool()> cook;
+    };
+
+    /* What an output was last cooked from */
+    struct Record {
+        std::string input;
+        uint64_t input_size;
+        int64_t input_mtime;
+        uint32_t format_version;
+    };
+
+    std::string manifest_path;
+    std::vector<Job> jobs;
+    std::map<std::string, Record> records; // by output path
+    std::vector<CookResult> results;
+    double wall_ms;
+    unsigned int thread_count;
+
+    void load_manifest();
+
+    bool save_manifest();
+
+    static bool stat_input(const std::string& input, uint64_t& size, int64_t& mtime);
+
+};
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "AssetStreamer.h"
+
+static double ms_between(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+AssetStreamer::AssetStreamer(ThreadPool& pool) : pool(pool) {
+    this->start = std::chrono::steady_clock::now();
+    this->outstanding_work = 0;
+    this->pending_uploads = 0;
+    this->cancelled = false;
+    this->first_frame_ms = -1.0;
+    this->loaded_ms = -1.0;
+    this->frames_while_loading = 0;
+    this->longest_frame_upload_ms = 0.0;
+    this->last_frame_end = this->start;
+    this->loading_at_frame_start = false;
+    this->loading_frames = 0;
+    this->hitch_frames = 0;
+    this->longest_loading_frame_ms = 0.0;
+}
+
+AssetStreamer::~AssetStreamer() {
+    cancel();
+}
+
+void AssetStreamer::cancel() {
+    std::deque<ReadyUpload> dropped;
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->cancelled = true;
+        this->work_done.wait(lock, [this] { return this->outstanding_work == 0; });
+        dropped.swap(this->ready);
+    }
+
+    /* The results of dropped uploads are released here, while whatever they borrowed from is still around */
+    dropped.clear();
+}
+
+size_t AssetStreamer::begin_asset(const std::string& name) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    StreamedAssetStats entry;
+    entry.name = name;
+    entry.work_ms = 0.0;
+    entry.wait_ms = 0.0;
+    entry.upload_ms = 0.0;
+    entry.ready_ms = 0.0;
+    entry.uploaded = false;
+    this->stats.push_back(entry);
+
+    this->outstanding_work++;
+    this->pending_uploads++;
+    return this->stats.size() - 1;
+}
+
+size_t AssetStreamer::begin_background() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->outstanding_work++;
+    return BACKGROUND;
+}
+
+bool AssetStreamer::should_run() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return !this->cancelled;
+}
+
+void AssetStreamer::finish_work(size_t slot, double work_ms, std::function<void()> upload) {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (slot != BACKGROUND) {
+            this->stats[slot].work_ms = work_ms;
+        }
+        if (upload) {
+            this->ready.push_back({ slot, std::chrono::steady_clock::now(), std::move(upload) });
+        }
+        this->outstanding_work--;
+    }
+    this->work_done.notify_all();
+}
+
+size_t AssetStreamer::pump(double budget_ms) {
+    auto pump_start = std::chrono::steady_clock::now();
+    size_t uploaded = 0;
+    double asset_upload_ms = 0.0;
+
+    while (true) {
+        ReadyUpload next;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (this->ready.empty() || (uploaded > 0 && ms_between(pump_start, std::chrono::steady_clock::now()) >= budget_ms)) {
+                if (this->pending_uploads > 0) {
+                    this->frames_while_loading++;
+                }
+                break;
+            }
+            next = std::move(this->ready.front());
+            this->ready.pop_front();
+        }
+
+        /* The upload runs without the lock so workers can keep queueing */
+        auto upload_start = std::chrono::steady_clock::now();
+        next.upload();
+        auto upload_end = std::chrono::steady_clock::now();
+        uploaded++;
+        if (next.slot == BACKGROUND) {
+            continue;
+        }
+        asset_upload_ms += ms_between(upload_start, upload_end);
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        StreamedAssetStats& entry = this->stats[next.slot];
+        entry.wait_ms = ms_between(next.ready_time, upload_start);
+        entry.upload_ms = ms_between(upload_start, upload_end);
+        entry.ready_ms = ms_between(this->start, upload_end);
+        entry.uploaded = true;
+        this->pending_uploads--;
+
+        if (this->pending_uploads == 0 && this->loaded_ms < 0.0) {
+            this->loaded_ms = entry.ready_ms;
+        }
+    }
+
+    this->longest_frame_upload_ms = std::max(this->longest_frame_upload_ms, asset_upload_ms);
+    return uploaded;
+}
+
+bool AssetStreamer::is_done() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->pending_uploads == 0;
+}
+
+void AssetStreamer::end_frame() {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    if (this->first_frame_ms < 0.0) {
+        this->first_frame_ms = ms_between(this->start, now);
+    } else if (this->loading_at_frame_start) {
+        double frame_ms = ms_between(this->last_frame_end, now);
+        this->loading_frames++;
+        this->longest_loading_frame_ms = std::max(this->longest_loading_frame_ms, frame_ms);
+        if (frame_ms > HITCH_FRAME_MS) {
+            this->hitch_frames++;
+        }
+    }
+
+    this->last_frame_end = now;
+    this->loading_at_frame_start = this->pending_uploads > 0;
+}
+
+double AssetStreamer::elapsed_ms() const {
+    return ms_between(this->start, std::chrono::steady_clock::now());
+}
+
+void AssetStreamer::print_report() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    std::cout << "Asset streaming (" << this->pool.size() << " worker threads)\n";
+    for (const StreamedAssetStats& entry : this->stats) {
+        char line[256];
+        if (entry.uploaded) {
+            snprintf(line, sizeof(line), "  %-28s work %9.2f ms  queued %8.2f ms  upload %8.2f ms  ready at %9.2f ms\n",
+                entry.name.c_str(), entry.work_ms, entry.wait_ms, entry.upload_ms, entry.ready_ms);
+        } else {
+            snprintf(line, sizeof(line), "  %-28s not loaded\n", entry.name.c_str());
+        }
+        std::cout << line;
+    }
+
+    char summary[256];
+    snprintf(summary, sizeof(summary), "  first frame at %.2f ms, fully loaded at %.2f ms, %zu frames drawn while loading, longest upload frame %.2f ms\n",
+        this->first_frame_ms, this->loaded_ms, this->frames_while_loading, this->longest_frame_upload_ms);
+    std::cout << summary;
+
+    snprintf(summary, sizeof(summary), "  %zu of %zu frames while loading were hitches over %.1f ms, longest frame %.2f ms\n",
+        this->hitch_frames, this->loading_frames, HITCH_FRAME_MS, this->longest_loading_frame_ms);
+    std::cout << summary << std::flush;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+
+/* Timing for one asset, from submission to the end of its upload */
+struct StreamedAssetStats {
+    std::string name;
+    double work_ms; // decoding and post processing on a worker
+    double wait_ms; // finished but queued behind the upload budget
+    double upload_ms; // GL work on the main thread
+    double ready_ms; // since the streamer started, when the upload finished
+    bool uploaded;
+};
+
+/*
+ * Loads assets in the background while the scene is already rendering. Each asset is a work step run on a
+ * ThreadPool, returning whatever it decoded, and an upload step that receives the result on the GL thread.
+ * Finished work waits in a queue that pump() drains once per frame within a time budget, so a burst of
+ * completed loads is spread over several frames instead of stalling one.
+ */
+class AssetStreamer {
+
+public:
+
+    /* Upload time allowed per frame, a little over a quarter of a 60 Hz frame */
+    static constexpr double DEFAULT_UPLOAD_BUDGET_MS = 4.0;
+
+    /* A frame drawn while assets stream in that takes longer than two 60 Hz frames is a hitch */
+    static constexpr double HITCH_FRAME_MS = 33.3;
+
+    explicit AssetStreamer(ThreadPool& pool);
+
+    /* Cancels, uploads still queued are dropped */
+    ~AssetStreamer();
+
+    AssetStreamer(const AssetStreamer&) = delete;
+
+    AssetStreamer& operator=(const AssetStreamer&) = delete;
+
+    /* work() runs on the pool, upload(result) runs later on the thread calling pump() */
+    template <typename W, typename U>
+    void submit(const std::string& name, W work, U upload);
+
+    /*
+     * As submit, for loads made while the scene runs rather than to build it. They share the pool and the upload budget
+     * but are left out of the report, is_done() and the frames counted as loading, their owner keeps its own numbers
+     */
+    template <typename W, typename U>
+    void submit_background(W work, U upload);
+
+    /* GL thread, once per frame. Runs queued uploads until budget_ms is spent, always at least one. Returns how many ran */
+    size_t pump(double budget_ms);
+
+    /* True once every submitted asset has been uploaded */
+    bool is_done();
+
+    /* Skips work that has not started yet, waits for work that has and drops the uploads still queued, for owners of anything the work writes into */
+    void cancel();
+
+    /* Call after every buffer swap, times the first frame and every frame that began with uploads outstanding */
+    void end_frame();
+
+    double elapsed_ms() const;
+
+    void print_report();
+
+private:
+
+    /* Stats slot of background loads, which have none */
+    static constexpr size_t BACKGROUND = SIZE_MAX;
+
+    /* Upload step of one finished asset */
+    struct ReadyUpload {
+        size_t slot;
+        std::chrono::steady_clock::time_point ready_time;
+        std::function<void()> upload;
+    };
+
+    ThreadPool& pool;
+    std::chrono::steady_clock::time_point start;
+
+    std::mutex mutex;
+    std::condition_variable work_done;
+    std::deque<ReadyUpload> ready;
+    std::vector<StreamedAssetStats> stats;
+    size_t outstanding_work; // submitted to the pool and not finished yet, background loads included
+    size_t pending_uploads; // submitted and not uploaded yet, background loads excluded
+    bool cancelled;
+
+    double first_frame_ms;
+    double loaded_ms;
+    size_t frames_while_loading;
+    double longest_frame_upload_ms;
+
+    std::chrono::steady_clock::time_point last_frame_end;
+    bool loading_at_frame_start;
+    size_t loading_frames; // timed by end_frame, from one swap to the next
+    size_t hitch_frames;
+    double longest_loading_frame_ms;
+
+    size_t begin_asset(const std::string& name);
+
+    size_t begin_background();
+
+    /* False when the streamer is being destroyed and the work should be skipped */
+    bool should_run();
+
+    void finish_work(size_t slot, double work_ms, std::function<void()> upload);
+
+    template <typename W, typename U>
+    void submit_slot(size_t slot, W work, U upload);
+
+};
+
+template <typename W, typename U>
+void AssetStreamer::submit(const std::string& name, W work, U upload) {
+    submit_slot(begin_asset(name), work, upload);
+}
+
+template <typename W, typename U>
+void AssetStreamer::submit_background(W work, U upload) {
+    submit_slot(begin_background(), work, upload);
+}
+
+template <typename W, typename U>
+void AssetStreamer::submit_slot(size_t slot, W work, U upload) {
+    this->pool.submit([this, slot, work, upload]() mutable {
+        if (!should_run()) {
+            finish_work(slot, 0.0, nullptr);
+            return;
+        }
+
+        auto work_start = std::chrono::steady_clock::now();
+
+        /* Shared so the upload step stays copyable for std::function */
+        auto result = std::make_shared<decltype(work())>(work());
+        double work_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - work_start).count();
+
+        finish_work(slot, work_ms, [result, upload]() mutable { upload(*result); });
+    });
+}
@@ -0,0 +1,1385 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FAST_OBJ_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "FastObjParser.h"
+#include "AssetArchive.h"
+#include "MappedFile.h"
+#include "ObjTriangulator.h"
+#include "ThreadPool.h"
+
+static inline bool is_space(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static inline bool is_digit(char c) {
+    return (unsigned int)(c - '0') < 10u;
+}
+
+static inline unsigned int count_trailing_zeros(uint64_t bits) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return (unsigned int)index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index, (unsigned long)bits)) {
+        return (unsigned int)index;
+    }
+    _BitScanForward(&index, (unsigned long)(bits >> 32));
+    return (unsigned int)index + 32;
+#else
+    return (unsigned int)__builtin_ctzll(bits);
+#endif
+}
+
+/*
+ * Classifies the buffer 64 bytes at a time into line ends ('\n', '\r', '\0') and separators (line ends, ' ', '\t').
+ * Parsing only moves forward, so the block asked for is almost always the one classified last.
+ */
+class ObjScanner {
+
+public:
+
+    ObjScanner(const char* data, size_t size)
+        : data(data), size(size), block_start((size_t)-1), line_end_bits(0), separator_bits(0) {
+    }
+
+    /* First line end at or after p, the end of the buffer if there is none */
+    const char* find_line_end(const char* p) {
+        return this->find(p, false);
+    }
+
+    /* First space, tab or line end at or after p */
+    const char* find_separator(const char* p) {
+        return this->find(p, true);
+    }
+
+private:
+
+    const char* find(const char* p, bool separators) {
+        size_t pos = (size_t)(p - this->data);
+        while (pos < this->size) {
+            size_t block = pos & ~(size_t)63;
+            if (block != this->block_start) {
+                this->classify(block);
+            }
+
+            uint64_t bits = (separators ? this->separator_bits : this->line_end_bits) >> (pos - block);
+            if (bits != 0) {
+                pos += count_trailing_zeros(bits);
+                return this->data + std::min(pos, this->size);
+            }
+            pos = block + 64;
+        }
+        return this->data + this->size;
+    }
+
+    void classify(size_t block) {
+        const char* src = this->data + block;
+
+        /* The last block is padded with zeros, which read as line ends past the end of the buffer */
+        char tail[64];
+        if (block + 64 > this->size) {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, src, this->size - block);
+            src = tail;
+        }
+
+        uint64_t line_ends = 0;
+        uint64_t separators = 0;
+
+#ifdef FAST_OBJ_SSE2
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i carriage_return = _mm_set1_epi8('\r');
+        const __m128i nul = _mm_setzero_si128();
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i tab = _mm_set1_epi8('\t');
+
+        for (int i = 0; i < 4; i++) {
+            __m128i bytes = _mm_loadu_si128((const __m128i*)(src + i * 16));
+            __m128i ends = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, newline), _mm_cmpeq_epi8(bytes, carriage_return)),
+                _mm_cmpeq_epi8(bytes, nul));
+            __m128i seps = _mm_or_si128(ends, _mm_or_si128(_mm_cmpeq_epi8(bytes, space), _mm_cmpeq_epi8(bytes, tab)));
+            line_ends |= (uint64_t)(uint32_t)_mm_movemask_epi8(ends) << (i * 16);
+            separators |= (uint64_t)(uint32_t)_mm_movemask_epi8(seps) << (i * 16);
+        }
+#else
+        for (int i = 0; i < 64; i++) {
+            char c = src[i];
+            if (c == '\n' || c == '\r' || c == '\0') {
+                line_ends |= 1ull << i;
+                separators |= 1ull << i;
+            } else if (is_space(c)) {
+                separators |= 1ull << i;
+            }
+        }
+#endif
+
+        this->block_start = block;
+        this->line_end_bits = line_ends;
+        this->separator_bits = separators;
+    }
+
+    const char* data;
+    size_t size;
+    size_t block_start;
+    uint64_t line_end_bits;
+    uint64_t separator_bits;
+
+};
+
+/* tinyobj's own float grammar, used whenever from_chars would read a token differently (leading '+', "1e", overflow) */
+static bool parse_double_like_tinyobj(const char* s, const char* s_end, double* result) {
+    if (s >= s_end) {
+        return false;
+    }
+
+    double mantissa = 0.0;
+    int exponent = 0;
+    char sign = '+';
+    char exp_sign = '+';
+    const char* curr = s;
+    int read = 0;
+    bool end_not_reached = false;
+    bool leading_decimal_dots = false;
+
+    if (*curr == '+' || *curr == '-') {
+        sign = *curr;
+        curr++;
+        if ((curr != s_end) && (*curr == '.')) {
+            leading_decimal_dots = true;
+        }
+    } else if (is_digit(*curr)) {
+    } else if (*curr == '.') {
+        leading_decimal_dots = true;
+    } else {
+        return false;
+    }
+
+    end_not_reached = (curr != s_end);
+    if (!leading_decimal_dots) {
+        while (end_not_reached && is_digit(*curr)) {
+            mantissa *= 10;
+            mantissa += static_cast<int>(*curr - 0x30);
+            curr++;
+            read++;
+            end_not_reached = (curr != s_end);
+        }
+        if (read == 0) {
+            return false;
+        }
+    }
+
+    if (end_not_reached) {
+        if (*curr == '.') {
+            curr++;
+            read = 1;
+            end_not_reached = (curr != s_end);
+            while (end_not_reached && is_digit(*curr)) {
+                static const double pow_lut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+                const int lut_entries = sizeof pow_lut / sizeof pow_lut[0];
+                mantissa += static_cast<int>(*curr - 0x30) * (read < lut_entries ? pow_lut[read] : std::pow(10.0, -read));
+                read++;
+                curr++;
+                end_not_reached = (curr != s_end);
+            }
+        } else if (*curr != 'e' && *curr != 'E') {
+            end_not_reached = false;
+        }
+    }
+
+    /* The exponent check reads one past a bare "1e", which is the line terminator in tinyobj */
+    if (end_not_reached && (*curr == 'e' || *curr == 'E')) {
+        curr++;
+        end_not_reached = (curr != s_end);
+        if (end_not_reached && (*curr == '+' || *curr == '-')) {
+            exp_sign = *curr;
+            curr++;
+        } else if (!end_not_reached || !is_digit(*curr)) {
+            return false;
+        }
+
+        read = 0;
+        end_not_reached = (curr != s_end);
+        while (end_not_reached && is_digit(*curr)) {
+            if (exponent > (2147483647 / 10)) {
+                return false;
+            }
+            exponent *= 10;
+            exponent += static_cast<int>(*curr - 0x30);
+            curr++;
+            read++;
+            end_not_reached = (curr != s_end);
+        }
+        exponent *= (exp_sign == '+' ? 1 : -1);
+        if (read == 0) {
+            return false;
+        }
+    }
+
+    *result = (sign == '+' ? 1 : -1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+    return true;
+}
+
+/*
+ * Clinger's fast path for the plain "-12.3456" numbers exporters write: a mantissa below 2^24 and
+ * at most 10 decimals are both exact floats, so one float division is already correctly rounded.
+ */
+static bool parse_short_decimal(const char* s, const char* end, tinyobj::real_t* out) {
+    static const float pow10[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+    bool negative = (*s == '-');
+    const char* p = negative ? s + 1 : s;
+
+    uint32_t mantissa = 0;
+    int digit_count = 0;
+    int decimals = 0;
+    while (p < end && is_digit(*p)) {
+        mantissa = mantissa * 10 + (uint32_t)(*p - '0');
+        digit_count++;
+        p++;
+        if (mantissa >= (1u << 24) / 10) {
+            break;
+        }
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && is_digit(*p) && mantissa < (1u << 24) / 10) {
+            mantissa = mantissa * 10 + (uint32_t)(*p - '0');
+            digit_count++;
+            decimals++;
+            p++;
+        }
+    }
+
+    if (p != end || digit_count == 0 || decimals > 10 || mantissa >= (1u << 24)) {
+        return false;
+    }
+
+    float value = (float)mantissa / pow10[decimals];
+    *out = negative ? -value : value;
+    return true;
+}
+
+/* Reads one number from [s, end), end being the next separator. Leaves out untouched on failure */
+static bool parse_real(const char* s, const char* end, tinyobj::real_t* out) {
+    if (s >= end) {
+        return false;
+    }
+
+    if (parse_short_decimal(s, end, out)) {
+        return true;
+    }
+
+    const char* digits = (*s == '-') ? s + 1 : s;
+    if (digits < end && (is_digit(*digits) || *digits == '.')) {
+        tinyobj::real_t value;
+        std::from_chars_result result = std::from_chars(s, end, value);
+        if (result.ec == std::errc() && (result.ptr == end || (*result.ptr != 'e' && *result.ptr != 'E'))) {
+            *out = value;
+            return true;
+        }
+    }
+
+    double value;
+    if (!parse_double_like_tinyobj(s, end, &value)) {
+        return false;
+    }
+    *out = static_cast<tinyobj::real_t>(value);
+    return true;
+}
+
+/* atoi limited to the current line */
+static int parse_int(const char* p, const char* line_end) {
+    while (p < line_end && (is_space(*p) || *p == '\v' || *p == '\f')) {
+        p++;
+    }
+
+    bool negative = false;
+    if (p < line_end && (*p == '+' || *p == '-')) {
+        negative = (*p == '-');
+        p++;
+    }
+
+    unsigned int value = 0;
+    while (p < line_end && is_digit(*p)) {
+        value = value * 10 + (unsigned int)(*p - '0');
+        p++;
+    }
+    return negative ? -(int)value : (int)value;
+}
+
+static inline const char* skip_space(const char* p, const char* line_end) {
+    while (p < line_end && is_space(*p)) {
+        p++;
+    }
+    return p;
+}
+
+/* strcspn(p, "/ \t\r") limited to the current line */
+static inline const char* skip_index(const char* p, const char* line_end) {
+    while (p < line_end && *p != '/' && !is_space(*p)) {
+        p++;
+    }
+    return p;
+}
+
+/* Make index zero based, negative indices are relative to the count at the face */
+static inline int fix_index(int idx, int n) {
+    return idx > 0 ? idx - 1 : n + idx;
+}
+
+/* Reads one index of a triple, 0 is not a valid obj index */
+static inline bool read_index(const char* p, const char* line_end, int* ret) {
+    *ret = parse_int(p, line_end);
+    return *ret != 0;
+}
+
+/* Same walk as tinyobj's parseTriple (i, i/j/k, i//k, i/j) but keeps the raw obj indices, 0 marks a missing one */
+static bool parse_triple(const char** token, const char* line_end, tinyobj::index_t* ret) {
+    tinyobj::index_t index;
+    index.vertex_index = 0;
+    index.normal_index = 0;
+    index.texcoord_index = 0;
+
+    const char* p = *token;
+    if (!read_index(p, line_end, &index.vertex_index)) {
+        return false;
+    }
+
+    p = skip_index(p, line_end);
+    if (p == line_end || *p != '/') {
+        *token = p;
+        *ret = index;
+        return true;
+    }
+    p++;
+
+    /* i//k */
+    if (p < line_end && *p == '/') {
+        p++;
+        if (!read_index(p, line_end, &index.normal_index)) {
+            return false;
+        }
+        *token = skip_index(p, line_end);
+        *ret = index;
+        return true;
+    }
+
+    /* i/j/k or i/j */
+    if (!read_index(p, line_end, &index.texcoord_index)) {
+        return false;
+    }
+
+    p = skip_index(p, line_end);
+    if (p == line_end || *p != '/') {
+        *token = p;
+        *ret = index;
+        return true;
+    }
+
+    /* i/j/k */
+    p++;
+    if (!read_index(p, line_end, &index.normal_index)) {
+        return false;
+    }
+    *token = skip_index(p, line_end);
+    *ret = index;
+    return true;
+}
+
+/* Same as tinyobj's SplitString, used on mtllib lines */
+static void split_string(const std::string& s, char delim, char escape, std::vector<std::string>& elems) {
+    std::string token;
+
+    bool escaping = false;
+    for (size_t i = 0; i < s.size(); ++i) {
+        char ch = s[i];
+        if (escaping) {
+            escaping = false;
+        } else if (ch == escape) {
+            escaping = true;
+            continue;
+        } else if (ch == delim) {
+            if (!token.empty()) {
+                elems.push_back(token);
+            }
+            token.clear();
+            continue;
+        }
+        token += ch;
+    }
+
+    elems.push_back(token);
+}
+
+/* A polygon as read from the file. Its corners keep raw obj indices until the merge pass knows the chunk offsets */
+struct ObjFace {
+    size_t first_corner;
+    size_t corner_count;
+    unsigned int smoothing_group_id;
+
+    /* Positions, normals and texcoords read by the chunk before this face, for relative indices */
+    int v_count;
+    int vn_count;
+    int vt_count;
+};
+
+/* A line whose effect depends on what came before it, replayed in file order by the merge pass */
+struct ObjEvent {
+    enum Type {
+        USEMTL,
+        MTLLIB,
+        GROUP,
+        OBJECT
+    };
+
+    Type type;
+    size_t face_count; // faces of the chunk before this line
+    size_t v_count; // positions of the chunk before this line
+    size_t line_num; // line inside the chunk
+    std::string text; // material name, mtllib arguments, group or object name
+    bool empty_name; // g without any names
+};
+
+enum ObjChunkStatus {
+    CHUNK_OK,
+    CHUNK_ERROR,
+    CHUNK_UNSUPPORTED
+};
+
+/* One run of whole lines, parsed on its own without knowing anything about the lines before it */
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+
+    ObjChunkStatus status;
+    size_t line_count;
+
+    std::vector<tinyobj::real_t> v;
+    std::vector<tinyobj::real_t> vn;
+    std::vector<tinyobj::real_t> vt;
+    std::vector<tinyobj::real_t> vc;
+    std::vector<ObjFace> faces;
+    std::vector<tinyobj::index_t> corners;
+    std::vector<ObjEvent> events;
+
+    /* Faces before the first s line carry on with the smoothing group the previous chunk ended in */
+    size_t inherited_smoothing_faces;
+    bool sets_smoothing;
+    unsigned int smoothing_group_id;
+
+    /* Filled in by the merge pass */
+    size_t v_offset;
+    size_t vn_offset;
+    size_t vt_offset;
+    unsigned int entry_smoothing_group_id;
+    std::vector<size_t> segments;
+    int greatest_v_idx;
+    int greatest_vn_idx;
+    int greatest_vt_idx;
+};
+
+/* Faces of one chunk exported together, with the material and vertex count tinyobj would have had at that point */
+struct ObjSegment {
+    size_t chunk;
+    size_t first_face;
+    size_t face_count;
+    int material_id;
+    size_t position_count;
+
+    std::vector<tinyobj::index_t> indices;
+    std::vector<unsigned int> smoothing_group_ids;
+    std::string warnings;
+
+    size_t shape; // index into the output shapes, -1 if the shape was dropped
+    size_t triangle_offset;
+};
+
+/* A shape as tinyobj would build it, pushed only if its segments end up with triangles or keep_if_empty is set */
+struct ObjShapePlan {
+    std::string name;
+    std::vector<size_t> segments;
+    bool keep_if_empty;
+};
+
+/* Warning text, or the face warnings of a segment when segment is set */
+struct ObjWarning {
+    size_t segment;
+    std::string text;
+};
+
+static const size_t NO_SEGMENT = (size_t)-1;
+
+static ObjEvent make_event(const ObjChunk& chunk, ObjEvent::Type type, std::string text) {
+    ObjEvent event;
+    event.type = type;
+    event.face_count = chunk.faces.size();
+    event.v_count = chunk.v.size() / 3;
+    event.line_num = chunk.line_count;
+    event.text = std::move(text);
+    event.empty_name = false;
+    return event;
+}
+
+static bool starts_with(const char* token, const char* line_end, const char* prefix) {
+    size_t length = strlen(prefix);
+    return (size_t)(line_end - token) >= length && memcmp(token, prefix, length) == 0;
+}
+
+/* parseReal: skips blanks, reads up to the next separator and always moves past it */
+static bool next_real(const char** token, const char* line_end, ObjScanner& scanner, tinyobj::real_t* out) {
+    const char* start = skip_space(*token, line_end);
+    const char* end = scanner.find_separator(start);
+    *token = end;
+    return parse_real(start, end, out);
+}
+
+static std::string next_string(const char* token, const char* line_end, ObjScanner& scanner) {
+    const char* start = skip_space(token, line_end);
+    return std::string(start, scanner.find_separator(start));
+}
+
+static ObjChunkStatus parse_face(ObjChunk& chunk, const char* token, const char* line_end) {
+    ObjFace face;
+    face.first_corner = chunk.corners.size();
+    face.smoothing_group_id = chunk.smoothing_group_id;
+    face.v_count = (int)(chunk.v.size() / 3);
+    face.vn_count = (int)(chunk.vn.size() / 3);
+    face.vt_count = (int)(chunk.vt.size() / 2);
+
+    while (token < line_end) {
+        tinyobj::index_t index;
+        if (!parse_triple(&token, line_end, &index)) {
+            return CHUNK_ERROR;
+        }
+        chunk.corners.push_back(index);
+        token = skip_space(token, line_end);
+    }
+
+    face.corner_count = chunk.corners.size() - face.first_corner;
+    chunk.faces.push_back(face);
+    return CHUNK_OK;
+}
+
+/* One line of tinyobj::LoadObj's loop, with everything that needs earlier lines left as an event */
+static ObjChunkStatus parse_line(ObjChunk& chunk, const char* token, const char* line_end, ObjScanner& scanner) {
+    token = skip_space(token, line_end);
+    if (token == line_end || token[0] == '#') {
+        return CHUNK_OK;
+    }
+
+    /* Characters past the end of the line read as the terminator, like the c string tinyobj walks */
+    char c0 = token[0];
+    char c1 = (token + 1 < line_end) ? token[1] : '\0';
+    char c2 = (token + 2 < line_end) ? token[2] : '\0';
+
+    if (c0 == 'v' && is_space(c1)) {
+        const char* p = token + 2;
+        tinyobj::real_t x = 0.0f, y = 0.0f, z = 0.0f;
+        tinyobj::real_t r = 1.0f, g = 1.0f, b = 1.0f;
+        next_real(&p, line_end, scanner, &x);
+        next_real(&p, line_end, scanner, &y);
+        next_real(&p, line_end, scanner, &z);
+
+        bool found_color = next_real(&p, line_end, scanner, &r) && next_real(&p, line_end, scanner, &g) &&
+            next_real(&p, line_end, scanner, &b);
+        if (!found_color) {
+            r = g = b = 1.0f;
+        }
+
+        chunk.v.push_back(x);
+        chunk.v.push_back(y);
+        chunk.v.push_back(z);
+
+        /* LoadObj's default_vcols_fallback is on, so colors are always kept */
+        chunk.vc.push_back(r);
+        chunk.vc.push_back(g);
+        chunk.vc.push_back(b);
+        return CHUNK_OK;
+    }
+
+    if (c0 == 'v' && c1 == 'n' && is_space(c2)) {
+        const char* p = token + 3;
+        tinyobj::real_t x = 0.0f, y = 0.0f, z = 0.0f;
+        next_real(&p, line_end, scanner, &x);
+        next_real(&p, line_end, scanner, &y);
+        next_real(&p, line_end, scanner, &z);
+        chunk.vn.push_back(x);
+        chunk.vn.push_back(y);
+        chunk.vn.push_back(z);
+        return CHUNK_OK;
+    }
+
+    if (c0 == 'v' && c1 == 't' && is_space(c2)) {
+        const char* p = token + 3;
+        tinyobj::real_t x = 0.0f, y = 0.0f;
+        next_real(&p, line_end, scanner, &x);
+        next_real(&p, line_end, scanner, &y);
+        chunk.vt.push_back(x);
+        chunk.vt.push_back(y);
+        return CHUNK_OK;
+    }
+
+    /* Skin weights, lines, points and tags are rare enough to leave to tinyobj */
+    if ((c0 == 'v' && c1 == 'w' && is_space(c2)) || ((c0 == 'l' || c0 == 'p' || c0 == 't') && is_space(c1))) {
+        return CHUNK_UNSUPPORTED;
+    }
+
+    if (c0 == 'f' && is_space(c1)) {
+        return parse_face(chunk, skip_space(token + 2, line_end), line_end);
+    }
+
+    if (starts_with(token, line_end, "usemtl")) {
+        chunk.events.push_back(make_event(chunk, ObjEvent::USEMTL, next_string(token + 6, line_end, scanner)));
+        return CHUNK_OK;
+    }
+
+    if (starts_with(token, line_end, "mtllib") && token + 6 < line_end && is_space(token[6])) {
+        chunk.events.push_back(make_event(chunk, ObjEvent::MTLLIB, std::string(token + 7, line_end)));
+        return CHUNK_OK;
+    }
+
+    if (c0 == 'g' && is_space(c1)) {
+        /* The first name is the 'g' itself, several group names are joined with spaces */
+        std::vector<std::string> names;
+        const char* p = token;
+        while (p < line_end) {
+            names.push_back(next_string(p, line_end, scanner));
+            p = skip_space(scanner.find_separator(skip_space(p, line_end)), line_end);
+        }
+
+        std::string name;
+        for (size_t i = 1; i < names.size(); i++) {
+            name += (i > 1 ? " " : "") + names[i];
+        }
+
+        ObjEvent event = make_event(chunk, ObjEvent::GROUP, name);
+        event.empty_name = names.size() < 2;
+        chunk.events.push_back(event);
+        return CHUNK_OK;
+    }
+
+    if (c0 == 'o' && is_space(c1)) {
+        chunk.events.push_back(make_event(chunk, ObjEvent::OBJECT, std::string(token + 2, line_end)));
+        return CHUNK_OK;
+    }
+
+    if (c0 == 's' && is_space(c1)) {
+        const char* p = skip_space(token + 2, line_end);
+        if (p == line_end) {
+            return CHUNK_OK;
+        }
+
+        if (!chunk.sets_smoothing) {
+            chunk.sets_smoothing = true;
+            chunk.inherited_smoothing_faces = chunk.faces.size();
+        }
+
+        if (line_end - p >= 3 && p[0] == 'o' && p[1] == 'f' && p[2] == 'f') {
+            chunk.smoothing_group_id = 0;
+        } else {
+            /* Parse errors fall back to no smoothing */
+            int smoothing_id = parse_int(p, line_end);
+            chunk.smoothing_group_id = smoothing_id < 0 ? 0 : (unsigned int)smoothing_id;
+        }
+        return CHUNK_OK;
+    }
+
+    /* Unknown commands are ignored */
+    return CHUNK_OK;
+}
+
+static void parse_chunk(ObjChunk& chunk) {
+    chunk.status = CHUNK_OK;
+    chunk.line_count = 0;
+    chunk.sets_smoothing = false;
+    chunk.smoothing_group_id = 0;
+
+    const char* end = chunk.end;
+    ObjScanner scanner(chunk.begin, (size_t)(end - chunk.begin));
+
+    const char* line = chunk.begin;
+    while (line < end) {
+        /* A '\0' ends the line for tinyobj too, the rest up to the real line end is skipped */
+        const char* line_end = scanner.find_line_end(line);
+        const char* next = line_end;
+        while (next < end && *next == '\0') {
+            next = scanner.find_line_end(next + 1);
+        }
+        if (next < end) {
+            next += (next[0] == '\r' && next + 1 < end && next[1] == '\n') ? 2 : 1;
+        }
+
+        chunk.line_count++;
+        chunk.status = parse_line(chunk, line, line_end, scanner);
+        if (chunk.status != CHUNK_OK) {
+            break;
+        }
+
+        line = next;
+    }
+
+    if (!chunk.sets_smoothing) {
+        chunk.inherited_smoothing_faces = chunk.faces.size();
+    }
+}
+
+/* Cuts the buffer into chunk_count runs of whole lines, a "\r\n" pair never gets split */
+static std::vector<ObjChunk> split_chunks(const char* data, size_t size, size_t chunk_count) {
+    std::vector<ObjChunk> chunks;
+    const char* end = data + size;
+    const char* begin = data;
+
+    for (size_t i = 1; i <= chunk_count && begin < end; i++) {
+        const char* split = (i == chunk_count) ? end : data + (size / chunk_count) * i;
+        if (split < begin) {
+            split = begin;
+        }
+        while (split < end && *split != '\n' && *split != '\r') {
+            split++;
+        }
+        if (split < end) {
+            split += (split[0] == '\r' && split + 1 < end && split[1] == '\n') ? 2 : 1;
+        }
+
+        ObjChunk chunk = ObjChunk();
+        chunk.begin = begin;
+        chunk.end = split;
+        chunks.push_back(std::move(chunk));
+        begin = split;
+    }
+    return chunks;
+}
+
+/*
+ * Replays the chunk events in file order with the state tinyobj::LoadObj keeps across lines: materials,
+ * group and object names, smoothing groups and the faces waiting to be exported. Nothing is triangulated
+ * here, the result is a list of segments and the shapes they go into.
+ */
+class ObjMergePlan {
+
+public:
+
+    ObjMergePlan(tinyobj::MaterialReader* material_reader, std::vector<tinyobj::material_t>* materials,
+        std::string* warn, std::string* err)
+        : material_reader(material_reader), materials(materials), warn(warn), err(err) {
+        this->material = -1;
+        this->smoothing_group_id = 0;
+        this->line_offset = 0;
+        this->position_count = 0;
+        this->pending_chunk = 0;
+        this->pending_face = 0;
+        this->bounds_warning_position = 0;
+    }
+
+    /* Returns the chunk that stopped the parse, or chunks.size() if every line was read */
+    size_t replay(std::vector<ObjChunk>& chunks) {
+        size_t vn_count = 0;
+        size_t vt_count = 0;
+
+        for (size_t c = 0; c < chunks.size(); c++) {
+            ObjChunk& chunk = chunks[c];
+            chunk.v_offset = this->position_count / 3;
+            chunk.vn_offset = vn_count;
+            chunk.vt_offset = vt_count;
+            chunk.entry_smoothing_group_id = this->smoothing_group_id;
+            if (chunk.sets_smoothing) {
+                this->smoothing_group_id = chunk.smoothing_group_id;
+            }
+
+            for (const ObjEvent& event : chunk.events) {
+                size_t event_positions = this->position_count + event.v_count * 3;
+                replay_event(chunks, c, event, event_positions);
+            }
+
+            if (chunk.status != CHUNK_OK) {
+                this->error_line = this->line_offset + chunk.line_count;
+                return c;
+            }
+
+            this->line_offset += chunk.line_count;
+            this->position_count += chunk.v.size();
+            vn_count += chunk.vn.size() / 3;
+            vt_count += chunk.vt.size() / 2;
+        }
+
+        /* Bounds warnings come right before the last export's face warnings */
+        this->bounds_warning_position = this->warnings.size();
+
+        /* A usemtl on the last line leaves nothing to export, but earlier faces still make a shape */
+        bool ret = export_faces(chunks, chunks.size(), 0, this->position_count);
+        close_shape(ret);
+        return chunks.size();
+    }
+
+    std::vector<ObjSegment> segments;
+    std::vector<ObjShapePlan> shapes;
+    std::vector<ObjWarning> warnings;
+    size_t bounds_warning_position;
+    size_t line_offset;
+    size_t error_line;
+
+private:
+
+    void replay_event(std::vector<ObjChunk>& chunks, size_t chunk, const ObjEvent& event, size_t event_positions) {
+        switch (event.type) {
+        case ObjEvent::USEMTL: {
+            int new_material_id = -1;
+            std::map<std::string, int>::const_iterator it = this->material_map.find(event.text);
+            if (it != this->material_map.end()) {
+                new_material_id = it->second;
+            } else {
+                add_warning("material [ '" + event.text + "' ] not found in .mtl\n");
+            }
+
+            /* Materials change per face, so the shape keeps going and only the pending faces are flushed */
+            if (new_material_id != this->material) {
+                export_faces(chunks, chunk, event.face_count, event_positions);
+                this->material = new_material_id;
+            }
+            break;
+        }
+        case ObjEvent::MTLLIB:
+            load_material_libraries(event.text);
+            break;
+        case ObjEvent::GROUP:
+            export_faces(chunks, chunk, event.face_count, event_positions);
+            close_shape(false);
+            if (event.empty_name) {
+                if (this->warn) {
+                    std::stringstream ss;
+                    ss << "Empty group name. line: " << this->line_offset + event.line_num << "\n";
+                    add_warning(ss.str());
+                    this->name = "";
+                }
+            } else {
+                this->name = event.text;
+            }
+            break;
+        case ObjEvent::OBJECT:
+            export_faces(chunks, chunk, event.face_count, event_positions);
+            close_shape(false);
+            this->name = event.text;
+            break;
+        }
+    }
+
+    /* exportGroupsToShape: everything from the last export up to (end_chunk, end_face) goes into the current shape */
+    bool export_faces(std::vector<ObjChunk>& chunks, size_t end_chunk, size_t end_face, size_t positions) {
+        bool any = false;
+        for (size_t c = this->pending_chunk; c <= end_chunk && c < chunks.size(); c++) {
+            size_t first = (c == this->pending_chunk) ? this->pending_face : 0;
+            size_t last = (c == end_chunk) ? end_face : chunks[c].faces.size();
+            if (last <= first) {
+                continue;
+            }
+
+            ObjSegment segment = ObjSegment();
+            segment.chunk = c;
+            segment.first_face = first;
+            segment.face_count = last - first;
+            segment.material_id = this->material;
+            segment.position_count = positions;
+            segment.shape = NO_SEGMENT;
+
+            chunks[c].segments.push_back(this->segments.size());
+            this->shape.segments.push_back(this->segments.size());
+            this->warnings.push_back(ObjWarning{ this->segments.size(), std::string() });
+            this->segments.push_back(std::move(segment));
+            any = true;
+        }
+
+        this->pending_chunk = end_chunk;
+        this->pending_face = end_face;
+
+        if (any) {
+            this->shape.name = this->name;
+        }
+        return any;
+    }
+
+    void close_shape(bool keep_if_empty) {
+        if (!this->shape.segments.empty()) {
+            this->shape.keep_if_empty = keep_if_empty;
+            this->shapes.push_back(std::move(this->shape));
+        }
+        this->shape = ObjShapePlan();
+    }
+
+    void add_warning(const std::string& text) {
+        if (this->warn) {
+            this->warnings.push_back(ObjWarning{ NO_SEGMENT, text });
+        }
+    }
+
+    void load_material_libraries(const std::string& line) {
+        if (!this->material_reader) {
+            return;
+        }
+
+        std::vector<std::string> filenames;
+        split_string(line, ' ', '\\', filenames);
+
+        bool found = false;
+        for (size_t s = 0; s < filenames.size(); s++) {
+            if (this->material_filenames.count(filenames[s]) > 0) {
+                found = true;
+                continue;
+            }
+
+            std::string warn_mtl;
+            std::string err_mtl;
+            bool ok = (*this->material_reader)(filenames[s].c_str(), this->materials, &this->material_map, &warn_mtl, &err_mtl);
+            if (!warn_mtl.empty()) {
+                add_warning(warn_mtl);
+            }
+            if (this->err && !err_mtl.empty()) {
+                (*this->err) += err_mtl;
+            }
+
+            if (ok) {
+                found = true;
+                this->material_filenames.insert(filenames[s]);
+                break;
+            }
+        }
+
+        if (!found) {
+            add_warning("Failed to load material file(s). Use default material.\n");
+        }
+    }
+
+    tinyobj::MaterialReader* material_reader;
+    std::vector<tinyobj::material_t>* materials;
+    std::string* warn;
+    std::string* err;
+
+    std::set<std::string> material_filenames;
+    std::map<std::string, int> material_map;
+    int material;
+    std::string name;
+    unsigned int smoothing_group_id;
+    size_t position_count;
+
+    ObjShapePlan shape;
+    size_t pending_chunk;
+    size_t pending_face;
+};
+
+/* Concatenates the chunk attributes and turns raw face indices into final 0 based ones */
+static void resolve_chunk(ObjChunk& chunk, tinyobj::attrib_t& attrib) {
+    std::copy(chunk.v.begin(), chunk.v.end(), attrib.vertices.begin() + chunk.v_offset * 3);
+    std::copy(chunk.vc.begin(), chunk.vc.end(), attrib.colors.begin() + chunk.v_offset * 3);
+    std::copy(chunk.vn.begin(), chunk.vn.end(), attrib.normals.begin() + chunk.vn_offset * 3);
+    std::copy(chunk.vt.begin(), chunk.vt.end(), attrib.texcoords.begin() + chunk.vt_offset * 2);
+
+    chunk.greatest_v_idx = -1;
+    chunk.greatest_vn_idx = -1;
+    chunk.greatest_vt_idx = -1;
+
+    for (size_t f = 0; f < chunk.faces.size(); f++) {
+        ObjFace& face = chunk.faces[f];
+        if (f < chunk.inherited_smoothing_faces) {
+            face.smoothing_group_id = chunk.entry_smoothing_group_id;
+        }
+
+        int v_count = (int)chunk.v_offset + face.v_count;
+        int vn_count = (int)chunk.vn_offset + face.vn_count;
+        int vt_count = (int)chunk.vt_offset + face.vt_count;
+
+        for (size_t i = face.first_corner; i < face.first_corner + face.corner_count; i++) {
+            tinyobj::index_t& index = chunk.corners[i];
+            index.vertex_index = fix_index(index.vertex_index, v_count);
+            index.normal_index = index.normal_index ? fix_index(index.normal_index, vn_count) : -1;
+            index.texcoord_index = index.texcoord_index ? fix_index(index.texcoord_index, vt_count) : -1;
+
+            chunk.greatest_v_idx = std::max(chunk.greatest_v_idx, index.vertex_index);
+            chunk.greatest_vn_idx = std::max(chunk.greatest_vn_idx, index.normal_index);
+            chunk.greatest_vt_idx = std::max(chunk.greatest_vt_idx, index.texcoord_index);
+        }
+    }
+
+    std::vector<tinyobj::real_t>().swap(chunk.v);
+    std::vector<tinyobj::real_t>().swap(chunk.vn);
+    std::vector<tinyobj::real_t>().swap(chunk.vt);
+    std::vector<tinyobj::real_t>().swap(chunk.vc);
+}
+
+/* Triangulates the chunk's segments against the positions tinyobj had read when each one was exported */
+static void triangulate_chunk(const ObjChunk& chunk, std::vector<ObjSegment>& segments, const std::vector<tinyobj::real_t>& positions) {
+    for (size_t s : chunk.segments) {
+        ObjSegment& segment = segments[s];
+        segment.indices.reserve(segment.face_count * 3);
+
+        for (size_t f = segment.first_face; f < segment.first_face + segment.face_count; f++) {
+            const ObjFace& face = chunk.faces[f];
+            size_t first_index = segment.indices.size();
+            if (!ObjTriangulator::triangulate(&chunk.corners[face.first_corner], face.corner_count,
+                positions.data(), segment.position_count, segment.indices)) {
+                segment.warnings += face.corner_count < 3 ? "Degenerated face found\n." : "Face with invalid vertex index found.\n";
+                continue;
+            }
+
+            size_t triangle_count = (segment.indices.size() - first_index) / 3;
+            segment.smoothing_group_ids.insert(segment.smoothing_group_ids.end(), triangle_count, face.smoothing_group_id);
+        }
+    }
+}
+
+/* Copies the chunk's triangles into the shapes they were planned for */
+static void fill_shapes_from_chunk(const ObjChunk& chunk, std::vector<ObjSegment>& segments, std::vector<tinyobj::shape_t>& shapes) {
+    for (size_t s : chunk.segments) {
+        ObjSegment& segment = segments[s];
+        if (segment.shape != NO_SEGMENT) {
+            tinyobj::mesh_t& mesh = shapes[segment.shape].mesh;
+            size_t triangle_count = segment.smoothing_group_ids.size();
+            size_t offset = segment.triangle_offset;
+
+            std::copy(segment.indices.begin(), segment.indices.end(), mesh.indices.begin() + offset * 3);
+            std::copy(segment.smoothing_group_ids.begin(), segment.smoothing_group_ids.end(), mesh.smoothing_group_ids.begin() + offset);
+            std::fill(mesh.num_face_vertices.begin() + offset, mesh.num_face_vertices.begin() + offset + triangle_count, (unsigned char)3);
+            std::fill(mesh.material_ids.begin() + offset, mesh.material_ids.begin() + offset + triangle_count, segment.material_id);
+        }
+
+        std::vector<tinyobj::index_t>().swap(segment.indices);
+        std::vector<unsigned int>().swap(segment.smoothing_group_ids);
+    }
+}
+
+bool FastObjParser::parse(const char* data, size_t size, tinyobj::MaterialReader* material_reader, ThreadPool* pool,
+    tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes, std::vector<tinyobj::material_t>* materials,
+    std::string* warn, std::string* err, bool* unsupported) {
+    *unsupported = false;
+
+    size_t chunk_count = 1;
+    if (pool != nullptr) {
+        chunk_count = std::min((size_t)pool->size() * 4, std::max((size_t)1, size / MIN_CHUNK_BYTES));
+    }
+
+    /* Every chunk is parsed in parallel without looking at the others */
+    std::vector<ObjChunk> chunks = split_chunks(data, size, chunk_count);
+    ThreadPool::for_each(pool, chunks.size(), [&chunks](size_t c) { parse_chunk(chunks[c]); });
+
+    for (const ObjChunk& chunk : chunks) {
+        if (chunk.status == CHUNK_UNSUPPORTED) {
+            *unsupported = true;
+            return false;
+        }
+        if (chunk.status == CHUNK_ERROR) {
+            break;
+        }
+    }
+
+    /* The serial part: replay state changes in file order to know offsets, materials and shape boundaries */
+    ObjMergePlan plan(material_reader, materials, warn, err);
+    size_t stopped_chunk = plan.replay(chunks);
+    bool success = stopped_chunk == chunks.size();
+    if (!success) {
+        chunks.resize(stopped_chunk + 1);
+    }
+
+    size_t vertex_count = 0, normal_count = 0, texcoord_count = 0;
+    for (const ObjChunk& chunk : chunks) {
+        vertex_count += chunk.v.size();
+        normal_count += chunk.vn.size();
+        texcoord_count += chunk.vt.size();
+    }
+
+    tinyobj::attrib_t merged;
+    merged.vertices.resize(vertex_count);
+    merged.colors.resize(vertex_count);
+    merged.normals.resize(normal_count);
+    merged.texcoords.resize(texcoord_count);
+
+    ThreadPool::for_each(pool, chunks.size(), [&chunks, &merged](size_t c) { resolve_chunk(chunks[c], merged); });
+    ThreadPool::for_each(pool, chunks.size(), [&chunks, &plan, &merged](size_t c) {
+        triangulate_chunk(chunks[c], plan.segments, merged.vertices);
+    });
+
+    /* Shapes are only pushed if they got triangles, so their sizes are only known now */
+    for (const ObjShapePlan& shape_plan : plan.shapes) {
+        size_t triangle_count = 0;
+        for (size_t s : shape_plan.segments) {
+            plan.segments[s].triangle_offset = triangle_count;
+            triangle_count += plan.segments[s].smoothing_group_ids.size();
+        }
+        if (triangle_count == 0 && !shape_plan.keep_if_empty) {
+            continue;
+        }
+
+        for (size_t s : shape_plan.segments) {
+            plan.segments[s].shape = shapes->size();
+        }
+
+        tinyobj::shape_t shape;
+        shape.name = shape_plan.name;
+        shape.mesh.indices.resize(triangle_count * 3);
+        shape.mesh.num_face_vertices.resize(triangle_count);
+        shape.mesh.material_ids.resize(triangle_count);
+        shape.mesh.smoothing_group_ids.resize(triangle_count);
+        shapes->push_back(std::move(shape));
+    }
+
+    ThreadPool::for_each(pool, chunks.size(), [&chunks, &plan, shapes](size_t c) {
+        fill_shapes_from_chunk(chunks[c], plan.segments, *shapes);
+    });
+
+    if (warn) {
+        int greatest_v_idx = -1, greatest_vn_idx = -1, greatest_vt_idx = -1;
+        for (const ObjChunk& chunk : chunks) {
+            greatest_v_idx = std::max(greatest_v_idx, chunk.greatest_v_idx);
+            greatest_vn_idx = std::max(greatest_vn_idx, chunk.greatest_vn_idx);
+            greatest_vt_idx = std::max(greatest_vt_idx, chunk.greatest_vt_idx);
+        }
+
+        for (size_t i = 0; i <= plan.warnings.size(); i++) {
+            if (success && i == plan.bounds_warning_position) {
+                std::stringstream ss;
+                if (greatest_v_idx >= (int)(vertex_count / 3)) {
+                    ss << "Vertex indices out of bounds (line " << plan.line_offset << ".)\n\n";
+                }
+                if (greatest_vn_idx >= (int)(normal_count / 3)) {
+                    ss << "Vertex normal indices out of bounds (line " << plan.line_offset << ".)\n\n";
+                }
+                if (greatest_vt_idx >= (int)(texcoord_count / 2)) {
+                    ss << "Vertex texcoord indices out of bounds (line " << plan.line_offset << ".)\n\n";
+                }
+                (*warn) += ss.str();
+            }
+            if (i < plan.warnings.size()) {
+                const ObjWarning& warning = plan.warnings[i];
+                (*warn) += warning.segment == NO_SEGMENT ? warning.text : plan.segments[warning.segment].warnings;
+            }
+        }
+    }
+
+    if (!success) {
+        if (err) {
+            std::stringstream ss;
+            ss << "Failed parse `f' line(e.g. zero value for face index. line " << plan.error_line << ".)\n";
+            (*err) += ss.str();
+        }
+        return false;
+    }
+
+    attrib->vertices.swap(merged.vertices);
+    attrib->normals.swap(merged.normals);
+    attrib->texcoords.swap(merged.texcoords);
+    attrib->colors.swap(merged.colors);
+    attrib->vertex_weights.clear();
+    attrib->texcoord_ws.clear();
+    attrib->skin_weights.clear();
+    return true;
+}
+
+bool FastObjParser::load(tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes,
+    std::vector<tinyobj::material_t>* materials, std::string* warn, std::string* err, const char* path) {
+    attrib->vertices.clear();
+    attrib->normals.clear();
+    attrib->texcoords.clear();
+    attrib->colors.clear();
+    shapes->clear();
+
+    /* Packed objs are parsed where they sit in the mounted archive */
+    AssetBlob blob;
+    MappedFile file;
+    bool packed = AssetArchive::find(path, blob);
+    if (!packed) {
+        if (!file.open(path)) {
+            if (err) {
+                (*err) = "Cannot open file [" + std::string(path) + "]\n";
+            }
+            return false;
+        }
+        blob.data = file.data();
+        blob.size = file.size();
+    }
+
+    size_t material_count = materials->size();
+    size_t warn_length = warn ? warn->size() : 0;
+    size_t err_length = err ? err->size() : 0;
+
+    /* No mtl base directory, same as LoadObj's default */
+    tinyobj::MaterialFileReader material_reader("");
+    ThreadPool* pool = blob.size >= 2 * MIN_CHUNK_BYTES ? &ThreadPool::shared() : nullptr;
+
+    bool unsupported = false;
+    bool success = parse((const char*)blob.data, blob.size, &material_reader, pool, attrib, shapes, materials, warn, err, &unsupported);
+    if (!unsupported) {
+        return success;
+    }
+
+    /* Start over with tinyobj, dropping anything the partial parse produced */
+    materials->resize(material_count);
+    if (warn) {
+        warn->resize(warn_length);
+    }
+    if (err) {
+        err->resize(err_length);
+    }
+    file.close();
+
+    if (packed) {
+        std::unique_ptr<std::istream> stream = AssetArchive::open_stream(path);
+        return tinyobj::LoadObj(attrib, shapes, materials, warn, err, stream.get(), &material_reader);
+    }
+    return tinyobj::LoadObj(attrib, shapes, materials, warn, err, path);
+}
+
+static bool same_floats(const std::vector<tinyobj::real_t>& a, const std::vector<tinyobj::real_t>& b, size_t* mismatches) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (memcmp(&a[i], &b[i], sizeof(tinyobj::real_t)) != 0) {
+            (*mismatches)++;
+        }
+    }
+    return true;
+}
+
+static bool same_shapes(const std::vector<tinyobj::shape_t>& a, const std::vector<tinyobj::shape_t>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t s = 0; s < a.size(); s++) {
+        const tinyobj::mesh_t& ma = a[s].mesh;
+        const tinyobj::mesh_t& mb = b[s].mesh;
+        if (a[s].name != b[s].name || ma.indices.size() != mb.indices.size() ||
+            ma.num_face_vertices != mb.num_face_vertices || ma.material_ids != mb.material_ids ||
+            ma.smoothing_group_ids != mb.smoothing_group_ids) {
+            return false;
+        }
+        for (size_t i = 0; i < ma.indices.size(); i++) {
+            if (ma.indices[i].vertex_index != mb.indices[i].vertex_index ||
+                ma.indices[i].normal_index != mb.indices[i].normal_index ||
+                ma.indices[i].texcoord_index != mb.indices[i].texcoord_index) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void FastObjParser::benchmark(const std::vector<std::string>& paths, int iterations) {
+    /* Largest files first */
+    std::vector<std::pair<size_t, std::string>> files;
+    for (const std::string& path : paths) {
+        MappedFile file;
+        if (!file.open(path.c_str())) {
+            std::cout << "Skipping " << path << ", cannot open it" << std::endl;
+            continue;
+        }
+        files.push_back(std::make_pair(file.size(), path));
+    }
+    std::sort(files.begin(), files.end(), [](const std::pair<size_t, std::string>& a, const std::pair<size_t, std::string>& b) {
+        return a.first > b.first;
+    });
+
+    static const unsigned int thread_counts[] = { 1, 2, 4, 8 };
+
+    char line[320];
+    std::cout << "Obj parser benchmark in MB/s, best of " << iterations << " runs\n";
+    snprintf(line, sizeof(line), "  %-24s %9s %9s %9s %9s %9s %9s\n", "", "size MB", "tinyobj", "1 thread", "2 threads", "4 threads", "8 threads");
+    std::cout << line;
+
+    for (const std::pair<size_t, std::string>& file : files) {
+        const char* path = file.second.c_str();
+        double megabytes = (double)file.first / (1024.0 * 1024.0);
+
+        tinyobj::attrib_t tinyobj_attrib;
+        std::vector<tinyobj::shape_t> tinyobj_shapes;
+        double tinyobj_ms = 0.0;
+        for (int i = 0; i < iterations; i++) {
+            std::vector<tinyobj::material_t> materials;
+            std::string warning, error;
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            tinyobj::LoadObj(&tinyobj_attrib, &tinyobj_shapes, &materials, &warning, &error, path);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            tinyobj_ms = (i == 0) ? ms : std::min(tinyobj_ms, ms);
+        }
+
+        MappedFile mapped;
+        mapped.open(path);
+
+        double thread_ms[4] = { 0.0, 0.0, 0.0, 0.0 };
+        bool same = true;
+        bool unsupported = false;
+        size_t float_mismatches = 0;
+
+        for (int t = 0; t < 4 && !unsupported; t++) {
+            ThreadPool pool(thread_counts[t]);
+
+            for (int i = 0; i < iterations && !unsupported; i++) {
+                tinyobj::attrib_t attrib;
+                std::vector<tinyobj::shape_t> shapes;
+                std::vector<tinyobj::material_t> materials;
+                std::string warning, error;
+                tinyobj::MaterialFileReader material_reader("");
+
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                FastObjParser::parse((const char*)mapped.data(), mapped.size(), &material_reader, thread_counts[t] > 1 ? &pool : nullptr,
+                    &attrib, &shapes, &materials, &warning, &error, &unsupported);
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                thread_ms[t] = (i == 0) ? ms : std::min(thread_ms[t], ms);
+
+                /* from_chars rounds correctly where tinyobj can be a bit off, so count values that differ at all */
+                if (i == 0 && !unsupported) {
+                    size_t mismatches = 0;
+                    same = same && same_floats(tinyobj_attrib.vertices, attrib.vertices, &mismatches) &&
+                        same_floats(tinyobj_attrib.normals, attrib.normals, &mismatches) &&
+                        same_floats(tinyobj_attrib.texcoords, attrib.texcoords, &mismatches) &&
+                        same_floats(tinyobj_attrib.colors, attrib.colors, &mismatches) &&
+                        same_shapes(tinyobj_shapes, shapes);
+                    float_mismatches = std::max(float_mismatches, mismatches);
+                }
+            }
+        }
+
+        if (unsupported) {
+            snprintf(line, sizeof(line), "  %-24s %9.2f %9.2f  uses records only tinyobj reads\n", path, megabytes,
+                tinyobj_ms > 0.0 ? megabytes * 1000.0 / tinyobj_ms : 0.0);
+            std::cout << line;
+            continue;
+        }
+
+        snprintf(line, sizeof(line), "  %-24s %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f  %s", path, megabytes,
+            tinyobj_ms > 0.0 ? megabytes * 1000.0 / tinyobj_ms : 0.0,
+            thread_ms[0] > 0.0 ? megabytes * 1000.0 / thread_ms[0] : 0.0,
+            thread_ms[1] > 0.0 ? megabytes * 1000.0 / thread_ms[1] : 0.0,
+            thread_ms[2] > 0.0 ? megabytes * 1000.0 / thread_ms[2] : 0.0,
+            thread_ms[3] > 0.0 ? megabytes * 1000.0 / thread_ms[3] : 0.0,
+            !same ? "MISMATCH" : (float_mismatches == 0 ? "identical" : "same layout"));
+        std::cout << line;
+        if (same && float_mismatches > 0) {
+            std::cout << ", " << float_mismatches << " floats differ in rounding";
+        }
+        std::cout << "\n";
+    }
+    std::cout << std::flush;
+}
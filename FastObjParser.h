@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "tiny_obj_loader.h"
+
+class ThreadPool;
+
+/*
+ * Alternate obj front end. The file is memory mapped and classified 64 bytes at a time with SSE2 to find
+ * line and token boundaries, numbers are read with std::from_chars. The output is the same attrib_t/shape_t
+ * tinyobj::LoadObj gives with its default arguments (triangulated, default vertex colors).
+ * Files using records it does not handle (l, p, t, vw) are handed to tinyobj::LoadObj instead.
+ *
+ * Large files are cut into chunks at line boundaries and parsed on a thread pool. Relative indices,
+ * materials and g/o/usemtl shape boundaries depend on earlier lines, so those are settled afterwards
+ * by a short serial pass over the few state changing lines before triangulation runs in parallel again.
+ */
+class FastObjParser {
+
+public:
+
+    /* Files are never cut into chunks smaller than this */
+    static const size_t MIN_CHUNK_BYTES = 1024 * 1024;
+
+    /* Drop in replacement for tinyobj::LoadObj(attrib, shapes, materials, warn, err, path) */
+    static bool load(tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes,
+        std::vector<tinyobj::material_t>* materials, std::string* warn, std::string* err, const char* path);
+
+    /*
+     * Parses an obj that is already in memory, on the pool if one is given.
+     * Returns false with unsupported set if only tinyobj can read it
+     */
+    static bool parse(const char* data, size_t size, tinyobj::MaterialReader* material_reader, ThreadPool* pool,
+        tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes, std::vector<tinyobj::material_t>* materials,
+        std::string* warn, std::string* err, bool* unsupported);
+
+    /* Loads each obj with tinyobj and with this parser on 1 to 8 threads, prints MB/s and checks the results match */
+    static void benchmark(const std::vector<std::string>& paths, int iterations);
+
+};
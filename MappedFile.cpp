@@ -0,0 +1,134 @@
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+MappedFile::MappedFile() {
+    this->mapped_data = nullptr;
+    this->mapped_size = 0;
+#ifdef _WIN32
+    this->file_handle = INVALID_HANDLE_VALUE;
+    this->mapping_handle = nullptr;
+#else
+    this->file_descriptor = -1;
+#endif
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const char* path) {
+    close();
+
+#ifdef _WIN32
+    this->file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (this->file_handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(this->file_handle, &file_size)) {
+        close();
+        return false;
+    }
+    this->mapped_size = (size_t)file_size.QuadPart;
+
+    /* Zero sized files cannot be mapped, treat them as open but empty */
+    if (this->mapped_size == 0) {
+        return true;
+    }
+
+    this->mapping_handle = CreateFileMappingA(this->file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (this->mapping_handle == nullptr) {
+        close();
+        return false;
+    }
+
+    this->mapped_data = (const unsigned char*)MapViewOfFile(this->mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    if (this->mapped_data == nullptr) {
+        close();
+        return false;
+    }
+#else
+    this->file_descriptor = ::open(path, O_RDONLY);
+    if (this->file_descriptor < 0) {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(this->file_descriptor, &file_stat) != 0) {
+        close();
+        return false;
+    }
+    this->mapped_size = (size_t)file_stat.st_size;
+
+    /* Zero sized files cannot be mapped, treat them as open but empty */
+    if (this->mapped_size == 0) {
+        return true;
+    }
+
+    void* address = mmap(nullptr, this->mapped_size, PROT_READ, MAP_PRIVATE, this->file_descriptor, 0);
+    if (address == MAP_FAILED) {
+        close();
+        return false;
+    }
+    madvise(address, this->mapped_size, MADV_SEQUENTIAL);
+    this->mapped_data = (const unsigned char*)address;
+#endif
+
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (this->mapped_data != nullptr) {
+        UnmapViewOfFile(this->mapped_data);
+    }
+    if (this->mapping_handle != nullptr) {
+        CloseHandle(this->mapping_handle);
+    }
+    if (this->file_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(this->file_handle);
+    }
+    this->file_handle = INVALID_HANDLE_VALUE;
+    this->mapping_handle = nullptr;
+#else
+    if (this->mapped_data != nullptr) {
+        munmap((void*)this->mapped_data, this->mapped_size);
+    }
+    if (this->file_descriptor >= 0) {
+        ::close(this->file_descriptor);
+    }
+    this->file_descriptor = -1;
+#endif
+
+    this->mapped_data = nullptr;
+    this->mapped_size = 0;
+}
+
+bool MappedFile::is_open() const {
+#ifdef _WIN32
+    return this->file_handle != INVALID_HANDLE_VALUE;
+#else
+    return this->file_descriptor >= 0;
+#endif
+}
+
+const unsigned char* MappedFile::data() const {
+    return this->mapped_data;
+}
+
+size_t MappedFile::size() const {
+    return this->mapped_size;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/* Read-only memory mapping of a whole file. Not copyable, share it through a pointer instead */
+class MappedFile {
+
+public:
+
+    MappedFile();
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path);
+
+    void close();
+
+    bool is_open() const;
+
+    const unsigned char* data() const;
+
+    size_t size() const;
+
+private:
+
+    const unsigned char* mapped_data;
+    size_t mapped_size;
+
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#else
+    int file_descriptor;
+#endif
+
+};
@@ -0,0 +1,447 @@
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+#include "AssetArchive.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshCodec.h"
+#include "ThreadPool.h"
+
+static const char MESH_CACHE_DIR[] = "Cache";
+static const char MESH_CACHE_MAGIC[4] = { 'M', 'S', 'H', 'C' };
+
+/* Fixed 64 byte header, the compressed vertex blocks start right after it and the index blocks follow them */
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t floats_per_vertex;
+    uint32_t index_size;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t source_hash;
+    uint64_t path_hash;
+    uint64_t float_count; // decoded counts
+    uint64_t index_count;
+};
+
+static_assert(sizeof(MeshCacheHeader) == 64, "mesh cache header must stay 64 bytes");
+
+/* LOD table after the indices: a uint32_t count, then one entry per level */
+static_assert(sizeof(MeshLod) == 12, "mesh cache LOD entries are 12 bytes");
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/* Word at a time hash, fast enough to run over a whole obj on every start */
+uint64_t MeshCache::hash_bytes(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t lanes[4] = {
+        seed + 0x9E3779B97F4A7C15ULL,
+        seed + 0xC2B2AE3D27D4EB4FULL,
+        seed + 0x165667B19E3779F9ULL,
+        seed + 0x27D4EB2F165667C5ULL
+    };
+
+    /* Four independent lanes keep the multiplies pipelined */
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t word;
+            memcpy(&word, bytes + i + lane * 8, 8);
+            lanes[lane] = rotl64(lanes[lane] ^ (word * 0x87C37B91114253D5ULL), 31) * 0x4CF5AD432745937FULL;
+        }
+    }
+
+    uint64_t h = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) + rotl64(lanes[2], 12) + rotl64(lanes[3], 18);
+
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        h = rotl64(h ^ (word * 0x87C37B91114253D5ULL), 27) * 0x4CF5AD432745937FULL;
+    }
+
+    uint64_t tail = 0;
+    for (size_t t = 0; i < size; i++, t++) {
+        tail |= (uint64_t)bytes[i] << (t * 8);
+    }
+
+    return mix64(h ^ mix64(tail) ^ (uint64_t)size);
+}
+
+bool MeshCache::read_source_key(const char* source_path, MeshSourceKey& key) {
+    /* Packed sources carry the key of the file they were packed from */
+    AssetBlob blob;
+    if (AssetArchive::find(source_path, blob)) {
+        key.size = blob.size;
+        key.mtime = blob.mtime;
+        key.hash = blob.hash;
+        return true;
+    }
+
+    std::error_code ec;
+    std::filesystem::path path(source_path);
+
+    key.size = (uint64_t)std::filesystem::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+
+    key.mtime = (int64_t)std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+    if (ec) {
+        return false;
+    }
+
+    MappedFile source;
+    if (!source.open(source_path)) {
+        return false;
+    }
+    key.hash = hash_bytes(source.data(), source.size());
+
+    return true;
+}
+
+std::string MeshCache::cache_path(const char* source_path, unsigned int floats_per_vertex) {
+    /* Flatten the relative asset path into a single file name, eg. 3D/shark.obj -> 3D_shark_obj.14.mesh */
+    std::string name = source_path;
+    for (char& c : name) {
+        if (c == '/' || c == '\\' || c == ':' || c == '.') {
+            c = '_';
+        }
+    }
+
+    return std::string(MESH_CACHE_DIR) + "/" + name + "." + std::to_string(floats_per_vertex) + ".mesh";
+}
+
+bool MeshCache::load(const char* source_path, const MeshSourceKey& key, unsigned int floats_per_vertex, MeshCacheEntry& entry) {
+    std::string path = cache_path(source_path, floats_per_vertex);
+
+    MappedFile file;
+    if (!file.open(path.c_str())) {
+        return false;
+    }
+
+    if (file.size() < sizeof(MeshCacheHeader)) {
+        return false;
+    }
+
+    MeshCacheHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+
+    /* Every block takes at least its size and, for vertices, the range of each channel, which bounds the counts */
+    uint64_t vertex_blocks = (header.float_count / std::max(floats_per_vertex, 1u) + MeshCodec::VERTEX_BLOCK - 1) / MeshCodec::VERTEX_BLOCK;
+    uint64_t index_blocks = (header.index_count + MeshCodec::INDEX_BLOCK - 1) / MeshCodec::INDEX_BLOCK;
+    uint64_t smallest_size = sizeof(MeshCacheHeader) + vertex_blocks * (sizeof(uint32_t) + floats_per_vertex * 12) +
+        index_blocks * (sizeof(uint32_t) + 8) + sizeof(uint32_t);
+
+    /* Any mismatch means the obj or the format changed since the cache was written */
+    if (memcmp(header.magic, MESH_CACHE_MAGIC, 4) != 0 ||
+        header.version != VERSION ||
+        header.floats_per_vertex != floats_per_vertex ||
+        header.source_size != key.size ||
+        header.source_mtime != key.mtime ||
+        header.source_hash != key.hash ||
+        header.path_hash != hash_bytes(source_path, strlen(source_path)) ||
+        header.float_count % floats_per_vertex != 0 ||
+        header.index_size != index_type_size(pick_index_type(header.float_count / floats_per_vertex)) ||
+        file.size() < smallest_size) {
+        std::cout << "Mesh cache for " << source_path << " is stale, rebuilding" << std::endl;
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    GLenum index_type = pick_index_type(header.float_count / floats_per_vertex);
+    size_t vertex_bytes = (size_t)header.float_count * sizeof(GLfloat);
+    entry.storage.resize(vertex_bytes + (size_t)header.index_count * header.index_size);
+
+    const unsigned char* blocks = file.data() + sizeof(MeshCacheHeader);
+    size_t remaining = file.size() - sizeof(MeshCacheHeader);
+    size_t vertex_stream = 0;
+    size_t index_stream = 0;
+    bool decoded = MeshCodec::decode_vertices(blocks, remaining, (size_t)header.float_count / floats_per_vertex, floats_per_vertex,
+        (GLfloat*)entry.storage.data(), vertex_stream, &ThreadPool::shared()) &&
+        MeshCodec::decode_indices(blocks + vertex_stream, remaining - vertex_stream, (size_t)header.index_count, index_type,
+            entry.storage.data() + vertex_bytes, index_stream, &ThreadPool::shared());
+
+    size_t lod_table = sizeof(MeshCacheHeader) + vertex_stream + index_stream;
+    uint32_t lod_count = 0;
+    if (decoded && file.size() >= lod_table + sizeof(uint32_t)) {
+        memcpy(&lod_count, file.data() + lod_table, sizeof(lod_count));
+    }
+    if (!decoded || lod_count == 0 || file.size() != lod_table + sizeof(uint32_t) + (uint64_t)lod_count * sizeof(MeshLod)) {
+        std::cout << "Mesh cache for " << source_path << " is stale, rebuilding" << std::endl;
+        std::vector<unsigned char>().swap(entry.storage);
+        return false;
+    }
+
+    entry.lods.resize(lod_count);
+    memcpy(entry.lods.data(), file.data() + lod_table + sizeof(uint32_t), lod_count * sizeof(MeshLod));
+    for (const MeshLod& lod : entry.lods) {
+        if ((uint64_t)lod.first_index + lod.index_count > header.index_count) {
+            std::cout << "Mesh cache for " << source_path << " is stale, rebuilding" << std::endl;
+            std::vector<unsigned char>().swap(entry.storage);
+            return false;
+        }
+    }
+
+    entry.vertices = (const GLfloat*)entry.storage.data();
+    entry.float_count = (size_t)header.float_count;
+    entry.indices = entry.storage.data() + vertex_bytes;
+    entry.index_count = (size_t)header.index_count;
+    entry.index_type = index_type;
+    entry.file_bytes = file.size();
+    entry.decode_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    return true;
+}
+
+bool MeshCache::store(const char* source_path, const MeshSourceKey& key, unsigned int floats_per_vertex,
+    const GLfloat* vertices, size_t float_count, const GLuint* indices, size_t index_count,
+    const std::vector<MeshLod>& lods) {
+    MeshCacheWriter writer;
+
+    if (!writer.begin(source_path, key, floats_per_vertex)) {
+        return false;
+    }
+    writer.set_lods(lods);
+    return writer.write_vertices(vertices, float_count) &&
+        writer.write_indices(indices, index_count) &&
+        writer.finish();
+}
+
+GLenum MeshCache::pick_index_type(size_t vertex_count) {
+    return vertex_count <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+size_t MeshCache::index_type_size(GLenum index_type) {
+    return index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+MeshCacheWriter::MeshCacheWriter() {
+    this->floats_per_vertex = 0;
+    this->float_count = 0;
+    this->index_count = 0;
+    this->writing_indices = false;
+    this->active = false;
+}
+
+MeshCacheWriter::~MeshCacheWriter() {
+    abort();
+}
+
+bool MeshCacheWriter::begin(const char* source_path, const MeshSourceKey& key, unsigned int floats_per_vertex) {
+    abort();
+
+    std::error_code ec;
+    std::filesystem::create_directories(MESH_CACHE_DIR, ec);
+
+    this->source_path = source_path;
+    this->path = MeshCache::cache_path(source_path, floats_per_vertex);
+    this->temp_path = this->path + ".tmp";
+    this->key = key;
+    this->floats_per_vertex = floats_per_vertex;
+    this->vertex_block.clear();
+    this->index_block.clear();
+    this->float_count = 0;
+    this->index_count = 0;
+    this->writing_indices = false;
+    this->lods.clear();
+
+    /* Write to a temporary file first so a crash never leaves a half written cache behind */
+    this->out.open(this->temp_path, std::ios::binary | std::ios::trunc);
+    this->active = true;
+
+    if (!this->out) {
+        std::cout << "Could not write mesh cache " << this->temp_path << std::endl;
+        abort();
+        return false;
+    }
+
+    /* Placeholder, the real header is written by finish() once the counts are known */
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    this->out.write((const char*)&header, sizeof(header));
+
+    return true;
+}
+
+bool MeshCacheWriter::encode_vertices(const GLfloat* vertices, size_t float_count) {
+    this->encoded.clear();
+    MeshCodec::encode_vertex_block(vertices, float_count / this->floats_per_vertex, this->floats_per_vertex, this->encoded);
+    this->out.write((const char*)this->encoded.data(), this->encoded.size());
+    return (bool)this->out;
+}
+
+bool MeshCacheWriter::encode_indices(const GLuint* indices, size_t index_count) {
+    this->encoded.clear();
+    MeshCodec::encode_index_block(indices, index_count, this->encoded);
+    this->out.write((const char*)this->encoded.data(), this->encoded.size());
+    return (bool)this->out;
+}
+
+bool MeshCacheWriter::write_vertices(const GLfloat* vertices, size_t float_count) {
+    if (!this->active || this->writing_indices) {
+        return false;
+    }
+    this->float_count += float_count;
+
+    /* Whole blocks are encoded where they are, only what is left over waits for the next call */
+    size_t block_floats = MeshCodec::VERTEX_BLOCK * this->floats_per_vertex;
+    while (float_count > 0) {
+        if (this->vertex_block.empty() && float_count >= block_floats) {
+            if (!encode_vertices(vertices, block_floats)) {
+                return false;
+            }
+            vertices += block_floats;
+            float_count -= block_floats;
+            continue;
+        }
+
+        size_t count = std::min(float_count, block_floats - this->vertex_block.size());
+        this->vertex_block.insert(this->vertex_block.end(), vertices, vertices + count);
+        vertices += count;
+        float_count -= count;
+        if (this->vertex_block.size() == block_floats) {
+            if (!encode_vertices(this->vertex_block.data(), block_floats)) {
+                return false;
+            }
+            this->vertex_block.clear();
+        }
+    }
+    return true;
+}
+
+bool MeshCacheWriter::write_indices(const GLuint* indices, size_t index_count) {
+    if (!this->active) {
+        return false;
+    }
+
+    /* The last vertex block is short, the first indices close it */
+    this->writing_indices = true;
+    if (!this->vertex_block.empty()) {
+        if (!encode_vertices(this->vertex_block.data(), this->vertex_block.size())) {
+            return false;
+        }
+        this->vertex_block.clear();
+    }
+    this->index_count += index_count;
+
+    while (index_count > 0) {
+        if (this->index_block.empty() && index_count >= MeshCodec::INDEX_BLOCK) {
+            if (!encode_indices(indices, MeshCodec::INDEX_BLOCK)) {
+                return false;
+            }
+            indices += MeshCodec::INDEX_BLOCK;
+            index_count -= MeshCodec::INDEX_BLOCK;
+            continue;
+        }
+
+        size_t count = std::min(index_count, MeshCodec::INDEX_BLOCK - this->index_block.size());
+        this->index_block.insert(this->index_block.end(), indices, indices + count);
+        indices += count;
+        index_count -= count;
+        if (this->index_block.size() == MeshCodec::INDEX_BLOCK) {
+            if (!encode_indices(this->index_block.data(), MeshCodec::INDEX_BLOCK)) {
+                return false;
+            }
+            this->index_block.clear();
+        }
+    }
+    return true;
+}
+
+void MeshCacheWriter::set_lods(const std::vector<MeshLod>& lods) {
+    this->lods = lods;
+}
+
+bool MeshCacheWriter::finish() {
+    if (!this->active) {
+        return false;
+    }
+
+    if (this->float_count % this->floats_per_vertex != 0 ||
+        (!this->vertex_block.empty() && !encode_vertices(this->vertex_block.data(), this->vertex_block.size())) ||
+        (!this->index_block.empty() && !encode_indices(this->index_block.data(), this->index_block.size()))) {
+        std::cout << "Could not write mesh cache " << this->temp_path << std::endl;
+        abort();
+        return false;
+    }
+    this->vertex_block.clear();
+    this->index_block.clear();
+
+    GLenum index_type = MeshCache::pick_index_type(this->float_count / this->floats_per_vertex);
+
+    if (this->lods.empty()) {
+        this->lods.push_back({ 0, (uint32_t)this->index_count, 0.0f });
+    }
+    uint32_t lod_count = (uint32_t)this->lods.size();
+    this->out.write((const char*)&lod_count, sizeof(lod_count));
+    this->out.write((const char*)this->lods.data(), lod_count * sizeof(MeshLod));
+
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+    header.version = MeshCache::VERSION;
+    header.floats_per_vertex = this->floats_per_vertex;
+    header.index_size = (uint32_t)MeshCache::index_type_size(index_type);
+    header.source_size = this->key.size;
+    header.source_mtime = this->key.mtime;
+    header.source_hash = this->key.hash;
+    header.path_hash = MeshCache::hash_bytes(this->source_path.c_str(), this->source_path.size());
+    header.float_count = this->float_count;
+    header.index_count = this->index_count;
+
+    this->out.seekp(0);
+    this->out.write((const char*)&header, sizeof(header));
+    this->out.close();
+
+    if (!this->out) {
+        std::cout << "Could not write mesh cache " << this->temp_path << std::endl;
+        abort();
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(this->temp_path, this->path, ec);
+    if (ec) {
+        abort();
+        return false;
+    }
+
+    this->active = false;
+    return true;
+}
+
+/* Drops whatever was written so far */
+void MeshCacheWriter::abort() {
+    if (!this->active) {
+        return;
+    }
+
+    this->out.close();
+    std::vector<GLfloat>().swap(this->vertex_block);
+    std::vector<GLuint>().swap(this->index_block);
+
+    std::error_code ec;
+    std::filesystem::remove(this->temp_path, ec);
+
+    this->active = false;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/* Identity of a source obj, a cache file is only valid for the exact same key */
+struct MeshSourceKey {
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+};
+
+/* One level of detail, a range of the shared index buffer drawn with the full vertex buffer */
+struct MeshLod {
+    uint32_t first_index;
+    uint32_t index_count;
+    float error; // how far the surface moved, relative to the mesh radius, 0 for the full mesh
+};
+
+/* Interleaved vertex buffer and its index buffer decoded from a cache file */
+struct MeshCacheEntry {
+    std::vector<unsigned char> storage; // the decoded vertices followed by the indices
+    const GLfloat* vertices;
+    size_t float_count;
+    const void* indices;
+    size_t index_count;
+    GLenum index_type; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    std::vector<MeshLod> lods; // index ranges of every level, the full mesh first
+    size_t file_bytes; // size of the compressed cache file
+    double decode_ms;
+};
+
+/*
+ * On-disk cache of the final interleaved vertex buffers built by Model3D.
+ * Files live in Cache/ and hold a fixed 64 byte header followed by the vertices and the indices,
+ * both compressed with MeshCodec, so a warm start reads a fraction of the bytes and decodes them
+ * into buffers that can be handed to glBufferData. A small table of the LOD index ranges trails the indices.
+ */
+class MeshCache {
+
+public:
+
+    /* Bump whenever the header, the vertex layouts or the block encoding change */
+    static const uint32_t VERSION = 7;
+
+    static bool read_source_key(const char* source_path, MeshSourceKey& key);
+
+    static bool load(const char* source_path, const MeshSourceKey& key, unsigned int floats_per_vertex, MeshCacheEntry& entry);
+
+    static bool store(const char* source_path, const MeshSourceKey& key, unsigned int floats_per_vertex,
+        const GLfloat* vertices, size_t float_count, const GLuint* indices, size_t index_count,
+        const std::vector<MeshLod>& lods);
+
+    /* 16 bit indices whenever every vertex can be addressed with them */
+    static GLenum pick_index_type(size_t vertex_count);
+
+    static size_t index_type_size(GLenum index_type);
+
+    static std::string cache_path(const char* source_path, unsigned int floats_per_vertex);
+
+    static uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0);
+
+};
+
+/*
+ * Writes a cache file piece by piece, vertices first and then indices. Each is compressed a block at a time as
+ * soon as a whole block has been written, so MeshCache::store encodes straight out of the mesh it is given and
+ * the streaming loader never holds one. The header is filled in by finish(), once the counts are known.
+ */
+class MeshCacheWriter {
+
+public:
+
+    MeshCacheWriter();
+
+    ~MeshCacheWriter();
+
+    MeshCacheWriter(const MeshCacheWriter&) = delete;
+
+    MeshCacheWriter& operator=(const MeshCacheWriter&) = delete;
+
+    bool begin(const char* source_path, const MeshSourceKey& key, unsigned int floats_per_vertex);
+
+    /* False once indices have been written */
+    bool write_vertices(const GLfloat* vertices, size_t float_count);
+
+    bool write_indices(const GLuint* indices, size_t index_count);
+
+    /* Without this the file gets a single level covering every index */
+    void set_lods(const std::vector<MeshLod>& lods);
+
+    bool finish();
+
+    void abort();
+
+private:
+
+    std::string source_path;
+    std::string path;
+    std::string temp_path;
+    MeshSourceKey key;
+    unsigned int floats_per_vertex;
+    std::ofstream out;
+    std::vector<GLfloat> vertex_block; // written vertices short of a whole block
+    std::vector<GLuint> index_block;
+    std::vector<unsigned char> encoded;
+    uint64_t float_count;
+    uint64_t index_count;
+    bool writing_indices;
+    std::vector<MeshLod> lods;
+    bool active;
+
+    /* Compresses one block and appends it to the file */
+    bool encode_vertices(const GLfloat* vertices, size_t float_count);
+
+    bool encode_indices(const GLuint* indices, size_t index_count);
+
+};
@@ -0,0 +1,675 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESH_CODEC_SSE2
+#endif
+
+#include "MeshCodec.h"
+
+/* rANS with 32 bit states renormalized 16 bits at a time, so a symbol never needs more than one refill */
+static const uint32_t RANS_PROB_BITS = 12;
+static const uint32_t RANS_PROB_SCALE = 1u << RANS_PROB_BITS;
+static const uint32_t RANS_LOWER_BOUND = 1u << 16;
+
+/* Interleaved states, symbol i uses state i % RANS_STATES so neighbouring symbols decode without waiting on each other */
+static const size_t RANS_STATES = 4;
+
+/* How a byte plane is stored */
+enum PlaneMode : uint8_t {
+    PLANE_RAW = 0,
+    PLANE_CONSTANT = 1, // every byte the same, stored once
+    PLANE_RANS = 2,
+    PLANE_PACKED = 3 // groups of PACKED_GROUP bytes in as few bits as the group needs
+};
+
+/* Packed planes start with a 2 bit width code per group, four to a byte, then the packed groups in order */
+static const size_t PACKED_GROUP = 16;
+static const unsigned int PACKED_BITS[4] = { 0, 2, 4, 8 };
+
+static const float QUANTIZED_MAX = 65535.0f;
+
+static void append_bytes(std::vector<unsigned char>& out, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+template <typename T>
+static void append_value(std::vector<unsigned char>& out, T value) {
+    append_bytes(out, &value, sizeof(value));
+}
+
+/* Reads a T at p if it fits before end and moves past it */
+template <typename T>
+static bool read_value(const unsigned char*& p, const unsigned char* end, T& value) {
+    if ((size_t)(end - p) < sizeof(T)) {
+        return false;
+    }
+    memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+/* Scales symbol counts to frequencies summing to RANS_PROB_SCALE, every symbol that occurs keeps at least 1 */
+static void normalize_frequencies(const uint32_t* counts, size_t total, uint32_t* freqs) {
+    uint32_t sum = 0;
+    for (int s = 0; s < 256; s++) {
+        freqs[s] = counts[s] == 0 ? 0 : std::max<uint32_t>(1, (uint32_t)((uint64_t)counts[s] * RANS_PROB_SCALE / total));
+        sum += freqs[s];
+    }
+
+    /* Rounding leaves the sum a little off, take it from or give it to the most frequent symbols */
+    while (sum != RANS_PROB_SCALE) {
+        int largest = -1;
+        for (int s = 0; s < 256; s++) {
+            if (freqs[s] > 1 && (largest < 0 || freqs[s] > freqs[largest])) {
+                largest = s;
+            }
+        }
+        if (sum > RANS_PROB_SCALE) {
+            uint32_t take = std::min(sum - RANS_PROB_SCALE, freqs[largest] - 1);
+            freqs[largest] -= take;
+            sum -= take;
+        } else {
+            freqs[largest] += RANS_PROB_SCALE - sum;
+            sum = RANS_PROB_SCALE;
+        }
+    }
+}
+
+/* Packs every group of the plane at the narrowest width that holds all of its values */
+static void encode_packed(const unsigned char* bytes, size_t count, std::vector<unsigned char>& packed) {
+    size_t groups = (count + PACKED_GROUP - 1) / PACKED_GROUP;
+    packed.assign((groups + 3) / 4, 0);
+
+    for (size_t g = 0; g < groups; g++) {
+        /* The last group is padded with zeros */
+        unsigned char values[PACKED_GROUP] = {};
+        size_t first = g * PACKED_GROUP;
+        memcpy(values, bytes + first, std::min(PACKED_GROUP, count - first));
+
+        unsigned char largest = *std::max_element(values, values + PACKED_GROUP);
+        unsigned int code = 0;
+        while (largest >= (1u << PACKED_BITS[code]) && PACKED_BITS[code] < 8) {
+            code++;
+        }
+        packed[g / 4] |= (unsigned char)(code << ((g % 4) * 2));
+
+        unsigned int bits = PACKED_BITS[code];
+        if (bits == 8) {
+            append_bytes(packed, values, PACKED_GROUP);
+        } else if (bits > 0) {
+            unsigned int per_byte = 8 / bits;
+            for (size_t b = 0; b < PACKED_GROUP / per_byte; b++) {
+                unsigned char byte = 0;
+                for (unsigned int k = 0; k < per_byte; k++) {
+                    byte |= (unsigned char)(values[b * per_byte + k] << (k * bits));
+                }
+                packed.push_back(byte);
+            }
+        }
+    }
+}
+
+static void encode_plane(const unsigned char* bytes, size_t count, std::vector<unsigned char>& out) {
+    uint32_t counts[256] = {};
+    for (size_t i = 0; i < count; i++) {
+        counts[bytes[i]]++;
+    }
+
+    int distinct = 0;
+    for (int s = 0; s < 256; s++) {
+        distinct += counts[s] != 0 ? 1 : 0;
+    }
+    if (distinct <= 1) {
+        append_value<uint8_t>(out, PLANE_CONSTANT);
+        append_value<uint8_t>(out, count > 0 ? bytes[0] : 0);
+        return;
+    }
+
+    std::vector<unsigned char> packed;
+    encode_packed(bytes, count, packed);
+    size_t fast_bytes = std::min(packed.size(), count);
+
+    uint32_t freqs[256];
+    uint32_t starts[256];
+    normalize_frequencies(counts, count, freqs);
+    uint32_t start = 0;
+    for (int s = 0; s < 256; s++) {
+        starts[s] = start;
+        start += freqs[s];
+    }
+
+    /* No symbol costs more than 12 bits, the states add 16 bytes */
+    std::vector<unsigned char> encoded(count * 2 + 32);
+    unsigned char* end = encoded.data() + encoded.size();
+    unsigned char* p = end;
+    uint32_t states[RANS_STATES];
+    for (size_t k = 0; k < RANS_STATES; k++) {
+        states[k] = RANS_LOWER_BOUND;
+    }
+
+    for (size_t i = count; i-- > 0;) {
+        uint32_t& x = states[i % RANS_STATES];
+        uint32_t freq = freqs[bytes[i]];
+        uint32_t x_max = ((RANS_LOWER_BOUND >> RANS_PROB_BITS) << 16) * freq;
+        if (x >= x_max) {
+            uint16_t word = (uint16_t)x;
+            p -= 2;
+            memcpy(p, &word, 2);
+            x >>= 16;
+        }
+        x = ((x / freq) << RANS_PROB_BITS) + (x % freq) + starts[bytes[i]];
+    }
+    for (size_t k = RANS_STATES; k-- > 0;) {
+        p -= 4;
+        memcpy(p, &states[k], 4);
+    }
+
+    /*
+     * Raw and packed planes decode 16 bytes at a time, several times faster than rANS goes symbol by symbol. rANS is
+     * only kept where it cuts the plane to a third, in practice nearly constant planes with a few outliers
+     */
+    size_t table_bytes = 2 + distinct * 3;
+    size_t payload = (size_t)(end - p);
+    if (table_bytes + 4 + payload > fast_bytes / 3) {
+        if (packed.size() < count) {
+            append_value<uint8_t>(out, PLANE_PACKED);
+            append_bytes(out, packed.data(), packed.size());
+        } else {
+            append_value<uint8_t>(out, PLANE_RAW);
+            append_bytes(out, bytes, count);
+        }
+        return;
+    }
+
+    append_value<uint8_t>(out, PLANE_RANS);
+    append_value<uint16_t>(out, (uint16_t)distinct);
+    for (int s = 0; s < 256; s++) {
+        if (freqs[s] != 0) {
+            append_value<uint8_t>(out, (uint8_t)s);
+            append_value<uint16_t>(out, (uint16_t)freqs[s]);
+        }
+    }
+    append_value<uint32_t>(out, (uint32_t)payload);
+    append_bytes(out, p, payload);
+}
+
+/* Expands one group of PACKED_GROUP values of the given width into out */
+static void unpack_group(const unsigned char* in, unsigned int bits, unsigned char* out) {
+    if (bits == 0) {
+        memset(out, 0, PACKED_GROUP);
+        return;
+    }
+    if (bits == 8) {
+        memcpy(out, in, PACKED_GROUP);
+        return;
+    }
+
+#ifdef MESH_CODEC_SSE2
+    __m128i values;
+    if (bits == 2) {
+        /* Value k of every byte goes to lane 4 * byte + k */
+        int32_t word;
+        memcpy(&word, in, sizeof(word));
+        const __m128i mask = _mm_set1_epi8(3);
+        __m128i packed = _mm_cvtsi32_si128(word);
+        __m128i first = _mm_and_si128(packed, mask);
+        __m128i second = _mm_and_si128(_mm_srli_epi16(packed, 2), mask);
+        __m128i third = _mm_and_si128(_mm_srli_epi16(packed, 4), mask);
+        __m128i fourth = _mm_and_si128(_mm_srli_epi16(packed, 6), mask);
+        values = _mm_unpacklo_epi16(_mm_unpacklo_epi8(first, second), _mm_unpacklo_epi8(third, fourth));
+    } else {
+        const __m128i mask = _mm_set1_epi8(15);
+        __m128i packed = _mm_loadl_epi64((const __m128i*)in);
+        values = _mm_unpacklo_epi8(_mm_and_si128(packed, mask), _mm_and_si128(_mm_srli_epi16(packed, 4), mask));
+    }
+    _mm_storeu_si128((__m128i*)out, values);
+#else
+    unsigned int mask = (1u << bits) - 1;
+    unsigned int per_byte = 8 / bits;
+    for (size_t lane = 0; lane < PACKED_GROUP; lane++) {
+        out[lane] = (unsigned char)((in[lane / per_byte] >> ((lane % per_byte) * bits)) & mask);
+    }
+#endif
+}
+
+static bool decode_packed(const unsigned char*& p, const unsigned char* end, unsigned char* bytes, size_t count) {
+    size_t groups = (count + PACKED_GROUP - 1) / PACKED_GROUP;
+    size_t header = (groups + 3) / 4;
+    if ((size_t)(end - p) < header) {
+        return false;
+    }
+    const unsigned char* codes = p;
+    p += header;
+
+    unsigned char tail[PACKED_GROUP];
+    for (size_t g = 0; g < groups; g++) {
+        unsigned int bits = PACKED_BITS[(codes[g / 4] >> ((g % 4) * 2)) & 3];
+        size_t size = bits * PACKED_GROUP / 8;
+        if ((size_t)(end - p) < size) {
+            return false;
+        }
+
+        /* The last group may be partial and goes through a full size buffer */
+        size_t first = g * PACKED_GROUP;
+        unsigned char* out = first + PACKED_GROUP <= count ? bytes + first : tail;
+        unpack_group(p, bits, out);
+        p += size;
+        if (out == tail) {
+            memcpy(bytes + first, tail, count - first);
+        }
+    }
+    return true;
+}
+
+static bool decode_plane(const unsigned char*& p, const unsigned char* end, unsigned char* bytes, size_t count) {
+    uint8_t mode;
+    if (!read_value(p, end, mode)) {
+        return false;
+    }
+
+    if (mode == PLANE_CONSTANT) {
+        uint8_t value;
+        if (!read_value(p, end, value)) {
+            return false;
+        }
+        memset(bytes, value, count);
+        return true;
+    }
+
+    if (mode == PLANE_RAW) {
+        if ((size_t)(end - p) < count) {
+            return false;
+        }
+        memcpy(bytes, p, count);
+        p += count;
+        return true;
+    }
+
+    if (mode == PLANE_PACKED) {
+        return decode_packed(p, end, bytes, count);
+    }
+
+    uint16_t distinct;
+    if (mode != PLANE_RANS || !read_value(p, end, distinct) || distinct > 256) {
+        return false;
+    }
+
+    /* Each slot of the probability range maps to its symbol, the symbol's frequency - 1 and the slot's offset into it */
+    uint32_t slots[RANS_PROB_SCALE];
+    uint32_t start = 0;
+    for (uint16_t i = 0; i < distinct; i++) {
+        uint8_t symbol;
+        uint16_t freq;
+        if (!read_value(p, end, symbol) || !read_value(p, end, freq) || freq == 0 || start + freq > RANS_PROB_SCALE) {
+            return false;
+        }
+        for (uint32_t slot = 0; slot < freq; slot++) {
+            slots[start + slot] = symbol | ((uint32_t)(freq - 1) << 8) | (slot << 20);
+        }
+        start += freq;
+    }
+
+    uint32_t payload;
+    if (start != RANS_PROB_SCALE || !read_value(p, end, payload) || (size_t)(end - p) < payload || payload < RANS_STATES * 4) {
+        return false;
+    }
+
+    const unsigned char* in = p;
+    const unsigned char* in_end = p + payload;
+    uint32_t states[RANS_STATES];
+    memcpy(states, in, sizeof(states));
+    in += sizeof(states);
+
+    /* The states live in registers for the unrolled loop, going through the array would serialize them on memory */
+    uint32_t x0 = states[0], x1 = states[1], x2 = states[2], x3 = states[3];
+
+    /* Whether a state needs refilling is a coin flip, so the fast path always reads the next word and keeps it or not without branching */
+    auto decode_symbol = [&](uint32_t& x) {
+        uint32_t slot = slots[x & (RANS_PROB_SCALE - 1)];
+        x = (((slot >> 8) & 0xFFF) + 1) * (x >> RANS_PROB_BITS) + (slot >> 20);
+        uint16_t word;
+        memcpy(&word, in, 2);
+        uint32_t refill = x < RANS_LOWER_BOUND ? 1 : 0;
+        uint32_t keep_new = 0u - refill;
+        x = (x & ~keep_new) | (((x << 16) | word) & keep_new);
+        in += refill * 2;
+        return (unsigned char)slot;
+    };
+
+    /* Near the end of the input every refill is checked instead */
+    bool refilled = true;
+    auto decode_symbol_checked = [&](uint32_t& x) {
+        uint32_t slot = slots[x & (RANS_PROB_SCALE - 1)];
+        x = (((slot >> 8) & 0xFFF) + 1) * (x >> RANS_PROB_BITS) + (slot >> 20);
+        if (x < RANS_LOWER_BOUND) {
+            if (in_end - in < 2) {
+                refilled = false;
+                return (unsigned char)slot;
+            }
+            uint16_t word;
+            memcpy(&word, in, 2);
+            in += 2;
+            x = (x << 16) | word;
+        }
+        return (unsigned char)slot;
+    };
+
+    /* A run of FAST_RUN symbols reads at most 2 bytes each, plus the word read ahead by the last one */
+    const size_t FAST_RUN = 64;
+    size_t i = 0;
+    while (i + FAST_RUN <= count && (size_t)(in_end - in) >= FAST_RUN * 2 + 2) {
+        for (size_t run_end = i + FAST_RUN; i < run_end; i += RANS_STATES) {
+            bytes[i] = decode_symbol(x0);
+            bytes[i + 1] = decode_symbol(x1);
+            bytes[i + 2] = decode_symbol(x2);
+            bytes[i + 3] = decode_symbol(x3);
+        }
+    }
+    states[0] = x0;
+    states[1] = x1;
+    states[2] = x2;
+    states[3] = x3;
+    for (; i < count; i++) {
+        bytes[i] = decode_symbol_checked(states[i % RANS_STATES]);
+    }
+
+    if (!refilled) {
+        return false;
+    }
+    p = in_end;
+    return true;
+}
+
+void MeshCodec::encode_vertex_block(const GLfloat* vertices, size_t vertex_count, unsigned int floats_per_vertex,
+    std::vector<unsigned char>& out) {
+    size_t size_at = out.size();
+    append_value<uint32_t>(out, 0);
+
+    /* Range of every channel within this block */
+    std::vector<float> mins(floats_per_vertex);
+    std::vector<float> steps(floats_per_vertex);
+    for (unsigned int c = 0; c < floats_per_vertex; c++) {
+        float lo = vertex_count > 0 ? vertices[c] : 0.0f;
+        float hi = lo;
+        for (size_t v = 1; v < vertex_count; v++) {
+            lo = std::min(lo, vertices[v * floats_per_vertex + c]);
+            hi = std::max(hi, vertices[v * floats_per_vertex + c]);
+        }
+        mins[c] = lo;
+        steps[c] = (hi - lo) / QUANTIZED_MAX;
+        append_value(out, mins[c]);
+        append_value(out, steps[c]);
+    }
+
+    std::vector<unsigned char> low(vertex_count);
+    std::vector<unsigned char> high(vertex_count);
+    for (unsigned int c = 0; c < floats_per_vertex; c++) {
+        uint16_t previous = 0;
+        for (size_t v = 0; v < vertex_count; v++) {
+            float scaled = steps[c] > 0.0f ? (vertices[v * floats_per_vertex + c] - mins[c]) / steps[c] : 0.0f;
+            uint16_t quantized = (uint16_t)std::lround(std::min(std::max(scaled, 0.0f), QUANTIZED_MAX));
+
+            /* Wraps modulo 2^16, the decoder's running sum wraps the same way */
+            int16_t delta = (int16_t)(uint16_t)(quantized - previous);
+            uint16_t zigzag = (uint16_t)(((uint16_t)delta << 1) ^ (uint16_t)(delta >> 15));
+            low[v] = (unsigned char)zigzag;
+            high[v] = (unsigned char)(zigzag >> 8);
+            previous = quantized;
+        }
+        encode_plane(low.data(), vertex_count, out);
+        encode_plane(high.data(), vertex_count, out);
+    }
+
+    uint32_t size = (uint32_t)(out.size() - size_at - sizeof(uint32_t));
+    memcpy(out.data() + size_at, &size, sizeof(size));
+}
+
+void MeshCodec::encode_index_block(const GLuint* indices, size_t index_count, std::vector<unsigned char>& out) {
+    size_t size_at = out.size();
+    append_value<uint32_t>(out, 0);
+
+    std::vector<unsigned char> planes(index_count * 4);
+    GLuint previous = 0;
+    for (size_t i = 0; i < index_count; i++) {
+        int32_t delta = (int32_t)(indices[i] - previous);
+        uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+        for (int b = 0; b < 4; b++) {
+            planes[b * index_count + i] = (unsigned char)(zigzag >> (b * 8));
+        }
+        previous = indices[i];
+    }
+    for (int b = 0; b < 4; b++) {
+        encode_plane(planes.data() + b * index_count, index_count, out);
+    }
+
+    uint32_t size = (uint32_t)(out.size() - size_at - sizeof(uint32_t));
+    memcpy(out.data() + size_at, &size, sizeof(size));
+}
+
+/*
+ * Undoes the zigzag, the delta and the quantization of a run of one channel and writes it into its column of the
+ * vertices. previous carries the last quantized value from one run to the next
+ */
+static void decode_channel(const unsigned char* low, const unsigned char* high, size_t vertex_count,
+    float min, float step, GLfloat* column, unsigned int floats_per_vertex, uint16_t& previous) {
+    size_t v = 0;
+
+#ifdef MESH_CODEC_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128 min_4 = _mm_set1_ps(min);
+    const __m128 step_4 = _mm_set1_ps(step);
+    __m128i running = _mm_set1_epi16((short)previous);
+    alignas(16) float decoded[8];
+
+    for (; v + 8 <= vertex_count; v += 8) {
+        __m128i zigzag = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(low + v)), _mm_loadl_epi64((const __m128i*)(high + v)));
+        __m128i delta = _mm_xor_si128(_mm_srli_epi16(zigzag, 1), _mm_sub_epi16(zero, _mm_and_si128(zigzag, one)));
+
+        /* Prefix sum of the 8 deltas on top of the last value of the previous 8 */
+        delta = _mm_add_epi16(delta, _mm_slli_si128(delta, 2));
+        delta = _mm_add_epi16(delta, _mm_slli_si128(delta, 4));
+        delta = _mm_add_epi16(delta, _mm_slli_si128(delta, 8));
+        __m128i quantized = _mm_add_epi16(delta, running);
+        __m128i last = _mm_shufflehi_epi16(quantized, _MM_SHUFFLE(3, 3, 3, 3));
+        running = _mm_unpackhi_epi64(last, last);
+
+        __m128 first_4 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(quantized, zero));
+        __m128 second_4 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(quantized, zero));
+        _mm_store_ps(decoded, _mm_add_ps(_mm_mul_ps(first_4, step_4), min_4));
+        _mm_store_ps(decoded + 4, _mm_add_ps(_mm_mul_ps(second_4, step_4), min_4));
+        for (int k = 0; k < 8; k++) {
+            column[(v + k) * floats_per_vertex] = decoded[k];
+        }
+    }
+    previous = (uint16_t)_mm_cvtsi128_si32(running);
+#endif
+
+    for (; v < vertex_count; v++) {
+        uint16_t zigzag = (uint16_t)(low[v] | (high[v] << 8));
+        uint16_t delta = (uint16_t)((zigzag >> 1) ^ (uint16_t)(0 - (zigzag & 1)));
+        previous = (uint16_t)(previous + delta);
+        column[v * floats_per_vertex] = (float)previous * step + min;
+    }
+}
+
+static bool decode_vertex_block(const unsigned char* p, const unsigned char* end, size_t vertex_count,
+    unsigned int floats_per_vertex, GLfloat* vertices) {
+    std::vector<float> mins(floats_per_vertex);
+    std::vector<float> steps(floats_per_vertex);
+    for (unsigned int c = 0; c < floats_per_vertex; c++) {
+        if (!read_value(p, end, mins[c]) || !read_value(p, end, steps[c])) {
+            return false;
+        }
+    }
+
+    /* Low and high plane of every channel, one after the other */
+    std::vector<unsigned char> planes(vertex_count * floats_per_vertex * 2);
+    for (size_t plane = 0; plane < floats_per_vertex * 2; plane++) {
+        if (!decode_plane(p, end, planes.data() + plane * vertex_count, vertex_count)) {
+            return false;
+        }
+    }
+    if (p != end) {
+        return false;
+    }
+
+    /* Channels are interleaved a short run of vertices at a time, so the vertices being written stay in cache */
+    const size_t RUN = 256;
+    std::vector<uint16_t> previous(floats_per_vertex, 0);
+    for (size_t first = 0; first < vertex_count; first += RUN) {
+        size_t count = std::min(RUN, vertex_count - first);
+        for (unsigned int c = 0; c < floats_per_vertex; c++) {
+            const unsigned char* low = planes.data() + c * 2 * vertex_count + first;
+            decode_channel(low, low + vertex_count, count, mins[c], steps[c], vertices + first * floats_per_vertex + c,
+                floats_per_vertex, previous[c]);
+        }
+    }
+    return true;
+}
+
+static bool decode_index_block(const unsigned char* p, const unsigned char* end, size_t index_count,
+    GLenum index_type, void* indices) {
+    std::vector<unsigned char> planes(index_count * 4);
+    for (int b = 0; b < 4; b++) {
+        if (!decode_plane(p, end, planes.data() + b * index_count, index_count)) {
+            return false;
+        }
+    }
+    if (p != end) {
+        return false;
+    }
+
+    const unsigned char* b0 = planes.data();
+    const unsigned char* b1 = b0 + index_count;
+    const unsigned char* b2 = b1 + index_count;
+    const unsigned char* b3 = b2 + index_count;
+    GLushort* short_indices = (GLushort*)indices;
+    GLuint* int_indices = (GLuint*)indices;
+    size_t i = 0;
+    uint32_t previous = 0;
+
+#ifdef MESH_CODEC_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i bias_32 = _mm_set1_epi32(32768);
+    const __m128i bias_16 = _mm_set1_epi16((short)0x8000);
+    __m128i running = zero;
+
+    for (; i + 16 <= index_count; i += 16) {
+        __m128i p0 = _mm_loadu_si128((const __m128i*)(b0 + i));
+        __m128i p1 = _mm_loadu_si128((const __m128i*)(b1 + i));
+        __m128i p2 = _mm_loadu_si128((const __m128i*)(b2 + i));
+        __m128i p3 = _mm_loadu_si128((const __m128i*)(b3 + i));
+        __m128i low_01 = _mm_unpacklo_epi8(p0, p1);
+        __m128i high_01 = _mm_unpackhi_epi8(p0, p1);
+        __m128i low_23 = _mm_unpacklo_epi8(p2, p3);
+        __m128i high_23 = _mm_unpackhi_epi8(p2, p3);
+        __m128i values[4] = {
+            _mm_unpacklo_epi16(low_01, low_23), _mm_unpackhi_epi16(low_01, low_23),
+            _mm_unpacklo_epi16(high_01, high_23), _mm_unpackhi_epi16(high_01, high_23)
+        };
+
+        for (int q = 0; q < 4; q++) {
+            __m128i delta = _mm_xor_si128(_mm_srli_epi32(values[q], 1), _mm_sub_epi32(zero, _mm_and_si128(values[q], one)));
+            delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 4));
+            delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 8));
+            values[q] = _mm_add_epi32(delta, running);
+            running = _mm_shuffle_epi32(values[q], _MM_SHUFFLE(3, 3, 3, 3));
+        }
+
+        if (index_type == GL_UNSIGNED_SHORT) {
+            /* No unsigned 32 to 16 bit pack in SSE2, shift into signed range, pack and shift back */
+            for (int q = 0; q < 4; q += 2) {
+                __m128i packed = _mm_packs_epi32(_mm_sub_epi32(values[q], bias_32), _mm_sub_epi32(values[q + 1], bias_32));
+                _mm_storeu_si128((__m128i*)(short_indices + i + q * 4), _mm_xor_si128(packed, bias_16));
+            }
+        } else {
+            for (int q = 0; q < 4; q++) {
+                _mm_storeu_si128((__m128i*)(int_indices + i + q * 4), values[q]);
+            }
+        }
+    }
+    previous = (uint32_t)_mm_cvtsi128_si32(running);
+#endif
+
+    for (; i < index_count; i++) {
+        uint32_t zigzag = b0[i] | (b1[i] << 8) | (b2[i] << 16) | ((uint32_t)b3[i] << 24);
+        previous += (zigzag >> 1) ^ (0u - (zigzag & 1));
+        if (index_type == GL_UNSIGNED_SHORT) {
+            short_indices[i] = (GLushort)previous;
+        } else {
+            int_indices[i] = previous;
+        }
+    }
+    return true;
+}
+
+/* Finds where each block starts from the sizes in front of them */
+static bool find_blocks(const unsigned char* data, size_t size, size_t block_count,
+    std::vector<const unsigned char*>& starts, std::vector<const unsigned char*>& ends, size_t& consumed) {
+    const unsigned char* p = data;
+    const unsigned char* end = data + size;
+    for (size_t b = 0; b < block_count; b++) {
+        uint32_t block_size;
+        if (!read_value(p, end, block_size) || (size_t)(end - p) < block_size) {
+            return false;
+        }
+        starts.push_back(p);
+        ends.push_back(p + block_size);
+        p += block_size;
+    }
+    consumed = (size_t)(p - data);
+    return true;
+}
+
+bool MeshCodec::decode_vertices(const unsigned char* data, size_t size, size_t vertex_count, unsigned int floats_per_vertex,
+    GLfloat* vertices, size_t& consumed, ThreadPool* pool) {
+    size_t block_count = (vertex_count + VERTEX_BLOCK - 1) / VERTEX_BLOCK;
+    std::vector<const unsigned char*> starts, ends;
+    if (!find_blocks(data, size, block_count, starts, ends, consumed)) {
+        return false;
+    }
+
+    std::vector<unsigned char> decoded(block_count, 0);
+    ThreadPool::for_each(pool, block_count, [&](size_t b) {
+        size_t first = b * VERTEX_BLOCK;
+        size_t count = std::min(VERTEX_BLOCK, vertex_count - first);
+        decoded[b] = decode_vertex_block(starts[b], ends[b], count, floats_per_vertex, vertices + first * floats_per_vertex);
+    });
+
+    for (unsigned char ok : decoded) {
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MeshCodec::decode_indices(const unsigned char* data, size_t size, size_t index_count, GLenum index_type,
+    void* indices, size_t& consumed, ThreadPool* pool) {
+    size_t block_count = (index_count + INDEX_BLOCK - 1) / INDEX_BLOCK;
+    std::vector<const unsigned char*> starts, ends;
+    if (!find_blocks(data, size, block_count, starts, ends, consumed)) {
+        return false;
+    }
+
+    size_t index_size = index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    std::vector<unsigned char> decoded(block_count, 0);
+    ThreadPool::for_each(pool, block_count, [&](size_t b) {
+        size_t first = b * INDEX_BLOCK;
+        size_t count = std::min(INDEX_BLOCK, index_count - first);
+        decoded[b] = decode_index_block(starts[b], ends[b], count, index_type, (unsigned char*)indices + first * index_size);
+    });
+
+    for (unsigned char ok : decoded) {
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
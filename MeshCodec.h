@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ThreadPool.h"
+
+/*
+ * Compression for the vertex and index streams of the mesh cache. Vertices are cut into blocks and every float
+ * channel of a block is quantized to 16 bits inside the block's own range of that channel, then delta coded
+ * against the previous vertex. Indices are delta coded against the previous index. The deltas are zigzagged so
+ * small ones in either direction are small numbers and split into byte planes so their high bytes stay small.
+ * Every 16 bytes of a plane are bit packed at 0, 2, 4 or 8 bits, which unpacks with a few SSE2 shifts. rANS is
+ * left for planes it shrinks to a third, since it decodes one symbol at a time. Blocks decode independently,
+ * spread over a pool when given one.
+ */
+class MeshCodec {
+
+public:
+
+    static constexpr size_t VERTEX_BLOCK = 16384;
+
+    static constexpr size_t INDEX_BLOCK = 65536;
+
+    /* Appends one block of at most VERTEX_BLOCK vertices */
+    static void encode_vertex_block(const GLfloat* vertices, size_t vertex_count, unsigned int floats_per_vertex,
+        std::vector<unsigned char>& out);
+
+    /* Appends one block of at most INDEX_BLOCK indices */
+    static void encode_index_block(const GLuint* indices, size_t index_count, std::vector<unsigned char>& out);
+
+    /* Decodes the blocks holding vertex_count vertices, consumed is set to the bytes they took. False if data is damaged */
+    static bool decode_vertices(const unsigned char* data, size_t size, size_t vertex_count, unsigned int floats_per_vertex,
+        GLfloat* vertices, size_t& consumed, ThreadPool* pool);
+
+    /* As decode_vertices, writing 16 or 32 bit indices depending on index_type */
+    static bool decode_indices(const unsigned char* data, size_t size, size_t index_count, GLenum index_type,
+        void* indices, size_t& consumed, ThreadPool* pool);
+
+};
@@ -0,0 +1,329 @@
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "FastObjParser.h"
+#include "MeshLoader.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshStreamLoader.h"
+#include "TangentGenerator.h"
+#include "ThreadPool.h"
+#include "VertexLayouts.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * Welds identical interleaved vertices together while the vertex data is being built.
+ * Every added vertex produces one index, only vertices not seen before are appended.
+ */
+class VertexWelder {
+
+public:
+
+    VertexWelder(unsigned int floats_per_vertex, size_t max_vertices, std::vector<GLfloat>& vertices, std::vector<GLuint>& indices)
+        : floats_per_vertex(floats_per_vertex), vertices(vertices), indices(indices) {
+        /* Open addressing table kept at most half full */
+        size_t table_size = 16;
+        while (table_size < max_vertices * 2) {
+            table_size *= 2;
+        }
+        this->slots.assign(table_size, EMPTY_SLOT);
+        this->vertices.reserve(max_vertices * floats_per_vertex);
+        this->indices.reserve(max_vertices);
+    }
+
+    void add(const GLfloat* vertex) {
+        size_t bytes = this->floats_per_vertex * sizeof(GLfloat);
+        size_t mask = this->slots.size() - 1;
+        size_t slot = (size_t)MeshCache::hash_bytes(vertex, bytes) & mask;
+
+        while (this->slots[slot] != EMPTY_SLOT) {
+            GLuint candidate = this->slots[slot];
+            if (memcmp(&this->vertices[(size_t)candidate * this->floats_per_vertex], vertex, bytes) == 0) {
+                this->indices.push_back(candidate);
+                return;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        GLuint index = (GLuint)(this->vertices.size() / this->floats_per_vertex);
+        this->slots[slot] = index;
+        this->vertices.insert(this->vertices.end(), vertex, vertex + this->floats_per_vertex);
+        this->indices.push_back(index);
+    }
+
+private:
+
+    static constexpr GLuint EMPTY_SLOT = 0xFFFFFFFFu;
+
+    unsigned int floats_per_vertex;
+    std::vector<GLfloat>& vertices;
+    std::vector<GLuint>& indices;
+    std::vector<GLuint> slots;
+
+};
+
+/* Position, normal and uv of every face corner across all shapes, welded into unique vertices */
+static void weld_vertices(const tinyobj::attrib_t& attributes, const std::vector<tinyobj::shape_t>& shapes,
+    std::vector<GLfloat>& vertices, std::vector<GLuint>& indices) {
+    size_t index_count = 0;
+    for (size_t s = 0; s < shapes.size(); s++) {
+        index_count += shapes[s].mesh.indices.size();
+    }
+
+    VertexWelder welder(8, index_count, vertices, indices);
+
+    /* Populate vertex data for main obj, iterating over the multiple shapes of obj */
+    for (size_t s = 0; s < shapes.size(); s++) {
+        for (size_t i = 0; i < shapes[s].mesh.indices.size(); i++) {
+            tinyobj::index_t vData = shapes[s].mesh.indices[i];
+
+            GLfloat vertex[8] = {
+                // X Y Z //
+                attributes.vertices[(vData.vertex_index * 3)],
+                attributes.vertices[(vData.vertex_index * 3) + 1],
+                attributes.vertices[(vData.vertex_index * 3) + 2],
+
+                // Normals //
+                attributes.normals[(vData.normal_index * 3)],
+                attributes.normals[(vData.normal_index * 3) + 1],
+                attributes.normals[(vData.normal_index * 3) + 2],
+
+                // U V //
+                attributes.texcoords[(vData.texcoord_index * 2)],
+                attributes.texcoords[(vData.texcoord_index * 2) + 1]
+            };
+
+            welder.add(vertex);
+        }
+    }
+}
+
+static void init_data_regular(const tinyobj::attrib_t& attributes, const std::vector<tinyobj::shape_t>& shapes, MeshData& data) {
+    weld_vertices(attributes, shapes, data.fullVertexData, data.mesh_indices);
+}
+
+/* Tangents are summed over the welded vertices, so faces sharing a vertex share one smooth tangent frame */
+static void init_data_with_normal_maps(const tinyobj::attrib_t& attributes, const std::vector<tinyobj::shape_t>& shapes, MeshData& data) {
+    std::vector<GLfloat> vertices;
+    weld_vertices(attributes, shapes, vertices, data.mesh_indices);
+
+    size_t triangle_count = data.mesh_indices.size() / 3;
+    ThreadPool* pool = triangle_count >= TangentGenerator::PARALLEL_TRIANGLES ? &ThreadPool::shared() : nullptr;
+    TangentGenerator::generate(vertices.data(), FloatVertex::vertex_count(vertices.size()), data.mesh_indices.data(), data.mesh_indices.size(),
+        pool, data.fullVertexData);
+}
+
+static void record_lods(MeshData& data) {
+    for (const MeshLod& lod : data.lods) {
+        data.stats.lod_triangles.push_back(lod.index_count / 3);
+    }
+}
+
+/* Reorder for the post transform cache, overdraw and vertex fetch, the cost is paid once since the result is cached */
+static void reorder(MeshData& data) {
+    auto start = std::chrono::steady_clock::now();
+    data.stats.acmr_before = MeshOptimizer::acmr(data.mesh_indices.data(), data.mesh_indices.size());
+    MeshOptimizer::optimize(data.fullVertexData, data.floats_per_vertex, data.mesh_indices);
+    data.stats.acmr_after = MeshOptimizer::acmr(data.mesh_indices.data(), data.mesh_indices.size());
+    data.stats.optimize_ms = elapsed_ms(start);
+}
+
+static void record_cache_decode(MeshData& data) {
+    data.stats.cache_file_bytes = data.cached_mesh.file_bytes;
+    data.stats.cache_decoded_bytes = data.cached_mesh.storage.size();
+    data.stats.decode_ms = data.cached_mesh.decode_ms;
+}
+
+MeshData MeshLoader::load(const char* path, bool has_normal_maps, bool optimize) {
+    MeshData data;
+    data.floats_per_vertex = VertexLayouts::floats_per_vertex(has_normal_maps);
+    data.cached_mesh.vertices = nullptr;
+    data.cached_mesh.float_count = 0;
+    data.cached_mesh.indices = nullptr;
+    data.cached_mesh.index_count = 0;
+    data.cached_mesh.index_type = GL_UNSIGNED_INT;
+    data.cached_mesh.file_bytes = 0;
+    data.cached_mesh.decode_ms = 0.0;
+    data.stats.path = path;
+    data.stats.from_cache = false;
+    data.stats.parse_ms = 0.0;
+    data.stats.build_ms = 0.0;
+    data.stats.expanded_vertices = 0;
+    data.stats.unique_vertices = 0;
+    data.stats.optimize_ms = 0.0;
+    data.stats.acmr_before = 0.0;
+    data.stats.acmr_after = 0.0;
+    data.stats.simplify_ms = 0.0;
+    data.stats.cache_file_bytes = 0;
+    data.stats.cache_decoded_bytes = 0;
+    data.stats.decode_ms = 0.0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    /* Use the binary mesh cache if it was built from this exact obj. It holds optimized meshes, except for streamed
+       objs which are cached in the order they were welded whether or not optimizing was asked for */
+    MeshSourceKey source_key;
+    bool has_source_key = MeshCache::read_source_key(path, source_key);
+    bool streams = has_source_key && source_key.size >= MeshStreamLoader::STREAMING_THRESHOLD_BYTES;
+    if ((optimize || streams) && has_source_key && MeshCache::load(path, source_key, data.floats_per_vertex, data.cached_mesh)) {
+        data.stats.from_cache = true;
+        data.stats.parse_ms = elapsed_ms(start);
+        data.stats.expanded_vertices = data.cached_mesh.lods[0].index_count;
+        data.stats.unique_vertices = data.cached_mesh.float_count / data.floats_per_vertex;
+        data.lods = data.cached_mesh.lods;
+        record_lods(data);
+        record_cache_decode(data);
+        return data;
+    }
+
+    /* Very large objs are streamed straight into the cache in bounded memory instead of being held several times over.
+       Reordering and the LOD chain need the whole mesh, so they are skipped for these */
+    if (streams) {
+        if (MeshStreamLoader::load(path, source_key, has_normal_maps, data)) {
+            data.stats.parse_ms = elapsed_ms(start);
+            data.lods = data.cached_mesh.lods;
+            record_lods(data);
+            record_cache_decode(data);
+            return data;
+        }
+    }
+
+    /* Load the object through the mapped parser, everything is local so this is safe to run on several threads */
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warning, error;
+    tinyobj::attrib_t attributes;
+
+    bool success = FastObjParser::load(
+        &attributes,
+        &shapes,
+        &materials,
+        &warning,
+        &error,
+        path);
+
+    data.stats.parse_ms = elapsed_ms(start);
+
+    if (!success || shapes.empty()) {
+        std::cout << "Failed to load " << path << "\n" << error << std::endl;
+        return data;
+    }
+
+    start = std::chrono::steady_clock::now();
+
+    /* Initialize vertex data and indices depending on whether or not it will be normal mapped */
+    if (has_normal_maps == false) {
+        init_data_regular(attributes, shapes, data);
+    } else {
+        init_data_with_normal_maps(attributes, shapes, data);
+    }
+
+    data.stats.build_ms = elapsed_ms(start);
+    data.stats.expanded_vertices = data.mesh_indices.size();
+    data.stats.unique_vertices = data.fullVertexData.size() / data.floats_per_vertex;
+
+    if (optimize) {
+        reorder(data);
+
+        /* Lower levels are appended to the index buffer and share the vertices */
+        start = std::chrono::steady_clock::now();
+        MeshSimplifier::build_lod_chain(data.fullVertexData, data.floats_per_vertex, data.mesh_indices, data.lods);
+        data.stats.simplify_ms = elapsed_ms(start);
+    } else {
+        data.lods.push_back({ 0, (uint32_t)data.mesh_indices.size(), 0.0f });
+    }
+    record_lods(data);
+
+    if (optimize && has_source_key) {
+        MeshCache::store(path, source_key, data.floats_per_vertex, data.fullVertexData.data(), data.fullVertexData.size(),
+            data.mesh_indices.data(), data.mesh_indices.size(), data.lods);
+    }
+
+    return data;
+}
+
+void MeshLoader::print_load_report(const std::vector<MeshLoadStats>& stats, double wall_ms, unsigned int thread_count) {
+    double total_ms = 0.0;
+
+    std::cout << "Mesh load timings (" << thread_count << " worker threads)\n";
+    for (const MeshLoadStats& entry : stats) {
+        char line[256];
+        snprintf(line, sizeof(line), "  %-24s %-6s parse %9.2f ms  build %9.2f ms  vertices %9zu -> %9zu",
+            entry.path.c_str(), entry.from_cache ? "cache" : "obj", entry.parse_ms, entry.build_ms,
+            entry.expanded_vertices, entry.unique_vertices);
+        std::cout << line;
+
+        /* ACMR is only known for meshes built on this run */
+        if (entry.acmr_after > 0.0) {
+            snprintf(line, sizeof(line), "  optimize %8.2f ms  ACMR %.3f -> %.3f\n",
+                entry.optimize_ms, entry.acmr_before, entry.acmr_after);
+        } else {
+            snprintf(line, sizeof(line), "\n");
+        }
+        std::cout << line;
+
+        if (entry.lod_triangles.size() > 1) {
+            std::string levels;
+            for (size_t l = 0; l < entry.lod_triangles.size(); l++) {
+                levels += (l > 0 ? " / " : "") + std::to_string(entry.lod_triangles[l]);
+            }
+            snprintf(line, sizeof(line), "  %-24s LOD triangles %s", "", levels.c_str());
+            std::cout << line;
+            if (entry.simplify_ms > 0.0) {
+                snprintf(line, sizeof(line), "  simplify %.2f ms", entry.simplify_ms);
+                std::cout << line;
+            }
+            std::cout << "\n";
+        }
+        total_ms += entry.parse_ms + entry.build_ms + entry.optimize_ms + entry.simplify_ms;
+    }
+
+    char summary[256];
+    snprintf(summary, sizeof(summary), "  serial sum %.2f ms, wall clock %.2f ms, speedup %.2fx\n",
+        total_ms, wall_ms, wall_ms > 0.0 ? total_ms / wall_ms : 0.0);
+    std::cout << summary;
+
+    /* Compressed cache files against the raw float vertices and indices they decoded to */
+    size_t file_bytes = 0;
+    size_t decoded_bytes = 0;
+    double decode_ms = 0.0;
+    for (const MeshLoadStats& entry : stats) {
+        if (entry.cache_file_bytes == 0) {
+            continue;
+        }
+        if (file_bytes == 0) {
+            std::cout << "Mesh cache decoding\n";
+        }
+        file_bytes += entry.cache_file_bytes;
+        decoded_bytes += entry.cache_decoded_bytes;
+        decode_ms += entry.decode_ms;
+
+        char line[256];
+        snprintf(line, sizeof(line), "  %-24s %9.2f MB raw -> %8.2f MB  ratio %5.2fx  decode %8.2f ms  %6.2f GB/s\n",
+            entry.path.c_str(), entry.cache_decoded_bytes / (1024.0 * 1024.0), entry.cache_file_bytes / (1024.0 * 1024.0),
+            (double)entry.cache_decoded_bytes / entry.cache_file_bytes, entry.decode_ms,
+            entry.decode_ms > 0.0 ? entry.cache_decoded_bytes / (entry.decode_ms * 1.0e6) : 0.0);
+        std::cout << line;
+    }
+    if (file_bytes > 0) {
+        snprintf(summary, sizeof(summary), "  %.2f MB raw read as %.2f MB, ratio %.2fx, decoded at %.2f GB/s\n",
+            decoded_bytes / (1024.0 * 1024.0), file_bytes / (1024.0 * 1024.0), (double)decoded_bytes / file_bytes,
+            decode_ms > 0.0 ? decoded_bytes / (decode_ms * 1.0e6) : 0.0);
+        std::cout << summary;
+    }
+    std::cout << std::flush;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+#include "MeshCache.h"
+
+/* Timing for one mesh, filled in by the worker that loaded it */
+struct MeshLoadStats {
+    std::string path;
+    bool from_cache;
+    double parse_ms; // cache lookup + obj parsing
+    double build_ms; // building the interleaved vertex data
+    size_t expanded_vertices; // one per face corner, what glDrawArrays used to draw
+    size_t unique_vertices; // after welding identical vertices
+    double optimize_ms; // MeshOptimizer passes, 0 when skipped
+    double acmr_before; // average cache misses per triangle in obj order, 0 when not measured
+    double acmr_after;
+    double simplify_ms; // building the lower levels of detail, 0 when skipped
+    std::vector<size_t> lod_triangles; // triangles in every level, the full mesh first
+    size_t cache_file_bytes; // compressed cache file read, 0 when the mesh was not read from the cache
+    size_t cache_decoded_bytes; // vertex and index bytes it decoded to, what the file held before compression
+    double decode_ms;
+};
+
+/* Everything a Model3D needs from its obj, built without touching GL so it can run on any thread */
+struct MeshData {
+    unsigned int floats_per_vertex;
+    std::vector<GLuint> mesh_indices; // triangle list into fullVertexData
+    std::vector<GLfloat> fullVertexData; // unique interleaved vertices
+    std::vector<MeshLod> lods; // index ranges of every level of detail in mesh_indices or cached_mesh
+    MeshCacheEntry cached_mesh;
+    MeshLoadStats stats;
+};
+
+/*
+ * Reentrant obj loader. All tinyobj state is local to each call,
+ * so several meshes can be loaded at once from a ThreadPool.
+ */
+class MeshLoader {
+
+public:
+
+    /*
+     * optimize reorders triangles and vertices with MeshOptimizer and builds the levels of detail
+     * before the mesh is cached, without it the mesh has a single level
+     */
+    static MeshData load(const char* path, bool has_normal_maps, bool optimize = true);
+
+    static void print_load_report(const std::vector<MeshLoadStats>& stats, double wall_ms, unsigned int thread_count);
+
+};
@@ -0,0 +1,304 @@
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "MeshOptimizer.h"
+
+static const GLuint NO_VERTEX = 0xFFFFFFFFu;
+
+/* Triangles using each vertex, stored as offsets into one flat list */
+struct VertexTriangles {
+    std::vector<GLuint> offsets;
+    std::vector<GLuint> triangles;
+
+    VertexTriangles(const std::vector<GLuint>& indices, size_t vertex_count) {
+        this->offsets.assign(vertex_count + 1, 0);
+        for (GLuint index : indices) {
+            this->offsets[index + 1]++;
+        }
+        for (size_t v = 0; v < vertex_count; v++) {
+            this->offsets[v + 1] += this->offsets[v];
+        }
+
+        std::vector<GLuint> fill(this->offsets.begin(), this->offsets.end() - 1);
+        this->triangles.resize(indices.size());
+        for (size_t i = 0; i < indices.size(); i++) {
+            this->triangles[fill[indices[i]]++] = (GLuint)(i / 3);
+        }
+    }
+};
+
+/*
+ * Post transform cache modelled as a FIFO. A vertex is still cached if fewer than cache_size misses
+ * happened since it was loaded, so a flush is just a jump of the clock.
+ */
+class FifoCache {
+
+public:
+
+    FifoCache(size_t vertex_count, unsigned int cache_size)
+        : timestamps(vertex_count, 0), clock(cache_size + 1), cache_size(cache_size) {
+    }
+
+    /* Returns 1 on a miss */
+    unsigned int access(GLuint vertex) {
+        if (this->clock - this->timestamps[vertex] > this->cache_size) {
+            this->timestamps[vertex] = this->clock++;
+            return 1;
+        }
+        return 0;
+    }
+
+    void flush() {
+        this->clock += this->cache_size + 1;
+    }
+
+private:
+
+    std::vector<unsigned int> timestamps;
+    unsigned int clock;
+    unsigned int cache_size;
+
+};
+
+static size_t count_vertices(const GLuint* indices, size_t index_count) {
+    GLuint largest = 0;
+    for (size_t i = 0; i < index_count; i++) {
+        largest = std::max(largest, indices[i]);
+    }
+    return index_count > 0 ? (size_t)largest + 1 : 0;
+}
+
+double MeshOptimizer::acmr(const GLuint* indices, size_t index_count, unsigned int cache_size) {
+    size_t triangle_count = index_count / 3;
+    if (triangle_count == 0) {
+        return 0.0;
+    }
+
+    FifoCache cache(count_vertices(indices, index_count), cache_size);
+    size_t misses = 0;
+    for (size_t i = 0; i < triangle_count * 3; i++) {
+        misses += cache.access(indices[i]);
+    }
+    return (double)misses / (double)triangle_count;
+}
+
+void MeshOptimizer::optimize_vertex_cache(const std::vector<GLuint>& indices, size_t vertex_count,
+    std::vector<GLuint>& result, std::vector<size_t>& clusters) {
+    size_t triangle_count = indices.size() / 3;
+    result.clear();
+    result.reserve(triangle_count * 3);
+    clusters.assign(1, 0);
+    if (triangle_count == 0) {
+        return;
+    }
+
+    const int cache_size = (int)CACHE_SIZE;
+    VertexTriangles adjacency(indices, vertex_count);
+
+    std::vector<int> live_triangles(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        live_triangles[v] = (int)(adjacency.offsets[v + 1] - adjacency.offsets[v]);
+    }
+
+    std::vector<int> cache_time(vertex_count, 0);
+    std::vector<char> emitted(triangle_count, 0);
+    std::vector<GLuint> dead_ends;
+    std::vector<GLuint> candidates;
+    int time = cache_size + 1;
+    size_t cursor = 0;
+    GLuint fan = indices[0];
+
+    while (fan != NO_VERTEX) {
+        /* Emit every triangle around the fanning vertex that is not out yet */
+        candidates.clear();
+        for (GLuint a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1]; a++) {
+            GLuint triangle = adjacency.triangles[a];
+            if (emitted[triangle]) {
+                continue;
+            }
+            emitted[triangle] = 1;
+
+            for (int corner = 0; corner < 3; corner++) {
+                GLuint v = indices[triangle * 3 + corner];
+                result.push_back(v);
+                dead_ends.push_back(v);
+                candidates.push_back(v);
+                live_triangles[v]--;
+                if (time - cache_time[v] > cache_size) {
+                    cache_time[v] = time++;
+                }
+            }
+        }
+
+        /* Next fan: the candidate that stays in the cache the longest while its remaining triangles go out */
+        GLuint next = NO_VERTEX;
+        int best_priority = -1;
+        for (GLuint v : candidates) {
+            if (live_triangles[v] <= 0) {
+                continue;
+            }
+            int priority = 0;
+            if (time - cache_time[v] + 2 * live_triangles[v] <= cache_size) {
+                priority = time - cache_time[v];
+            }
+            if (priority > best_priority) {
+                best_priority = priority;
+                next = v;
+            }
+        }
+
+        if (next == NO_VERTEX) {
+            /* Dead end, fall back to recently used vertices, then to the next vertex in input order */
+            while (!dead_ends.empty() && next == NO_VERTEX) {
+                GLuint v = dead_ends.back();
+                dead_ends.pop_back();
+                if (live_triangles[v] > 0) {
+                    next = v;
+                }
+            }
+            while (next == NO_VERTEX && cursor < vertex_count) {
+                if (live_triangles[cursor] > 0) {
+                    next = (GLuint)cursor;
+                }
+                cursor++;
+            }
+            if (next != NO_VERTEX && result.size() / 3 > clusters.back()) {
+                clusters.push_back(result.size() / 3);
+            }
+        }
+
+        fan = next;
+    }
+}
+
+/* A run of triangles that is drawn as a unit, sorted by how far it faces outwards */
+struct OverdrawCluster {
+    size_t first;
+    size_t last;
+    float sort_key;
+};
+
+static glm::vec3 vertex_position(const std::vector<GLfloat>& vertices, unsigned int floats_per_vertex, GLuint index) {
+    const GLfloat* vertex = &vertices[(size_t)index * floats_per_vertex];
+    return glm::vec3(vertex[0], vertex[1], vertex[2]);
+}
+
+void MeshOptimizer::optimize_overdraw(const std::vector<GLfloat>& vertices, unsigned int floats_per_vertex,
+    const std::vector<GLuint>& indices, const std::vector<size_t>& clusters, std::vector<GLuint>& result) {
+    size_t triangle_count = indices.size() / 3;
+    size_t vertex_count = vertices.size() / floats_per_vertex;
+    result.clear();
+    result.reserve(indices.size());
+
+    /*
+     * Split the dead end clusters further where their cache efficiency is already close to the mesh's.
+     * Each piece is measured from a cold cache since after sorting it may follow any other piece
+     */
+    double threshold = OVERDRAW_THRESHOLD * acmr(indices.data(), indices.size());
+    std::vector<OverdrawCluster> split;
+    FifoCache cache(vertex_count, CACHE_SIZE);
+    for (size_t c = 0; c < clusters.size(); c++) {
+        size_t first = clusters[c];
+        size_t last = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+        cache.flush();
+
+        size_t start = first;
+        size_t misses = 0;
+        for (size_t t = first; t < last; t++) {
+            for (int corner = 0; corner < 3; corner++) {
+                misses += cache.access(indices[t * 3 + corner]);
+            }
+            if (t + 1 < last && (double)misses <= threshold * (double)(t + 1 - start)) {
+                split.push_back({ start, t + 1, 0.0f });
+                start = t + 1;
+                misses = 0;
+                cache.flush();
+            }
+        }
+        if (start < last) {
+            split.push_back({ start, last, 0.0f });
+        }
+    }
+
+    /* Mesh centroid, every cluster is scored by how far it faces away from it */
+    glm::dvec3 weighted_center(0.0);
+    double total_area = 0.0;
+    std::vector<glm::vec3> cluster_centers(split.size());
+    std::vector<glm::vec3> cluster_normals(split.size());
+    for (size_t c = 0; c < split.size(); c++) {
+        glm::dvec3 center(0.0);
+        glm::dvec3 normal(0.0);
+        double area = 0.0;
+        for (size_t t = split[c].first; t < split[c].last; t++) {
+            glm::vec3 p0 = vertex_position(vertices, floats_per_vertex, indices[t * 3]);
+            glm::vec3 p1 = vertex_position(vertices, floats_per_vertex, indices[t * 3 + 1]);
+            glm::vec3 p2 = vertex_position(vertices, floats_per_vertex, indices[t * 3 + 2]);
+            glm::vec3 face_normal = glm::cross(p1 - p0, p2 - p0);
+            double face_area = glm::length(face_normal) * 0.5;
+            center += glm::dvec3((p0 + p1 + p2) / 3.0f) * face_area;
+            normal += glm::dvec3(face_normal);
+            area += face_area;
+        }
+        weighted_center += center;
+        total_area += area;
+        cluster_centers[c] = area > 0.0 ? glm::vec3(center / area) : vertex_position(vertices, floats_per_vertex, indices[split[c].first * 3]);
+        cluster_normals[c] = glm::length(normal) > 0.0 ? glm::vec3(glm::normalize(normal)) : glm::vec3(0.0f);
+    }
+    glm::vec3 mesh_center = total_area > 0.0 ? glm::vec3(weighted_center / total_area) : glm::vec3(0.0f);
+
+    for (size_t c = 0; c < split.size(); c++) {
+        split[c].sort_key = glm::dot(cluster_centers[c] - mesh_center, cluster_normals[c]);
+    }
+
+    /* Outward facing clusters first, they are the ones most likely to hide the rest */
+    std::stable_sort(split.begin(), split.end(), [](const OverdrawCluster& a, const OverdrawCluster& b) {
+        return a.sort_key > b.sort_key;
+    });
+
+    for (const OverdrawCluster& cluster : split) {
+        result.insert(result.end(), indices.begin() + cluster.first * 3, indices.begin() + cluster.last * 3);
+    }
+}
+
+void MeshOptimizer::optimize_vertex_fetch(std::vector<GLfloat>& vertices, unsigned int floats_per_vertex, std::vector<GLuint>& indices) {
+    size_t vertex_count = vertices.size() / floats_per_vertex;
+    std::vector<GLuint> remap(vertex_count, NO_VERTEX);
+    std::vector<GLfloat> reordered(vertices.size());
+    GLuint next = 0;
+
+    for (GLuint& index : indices) {
+        if (remap[index] == NO_VERTEX) {
+            remap[index] = next;
+            memcpy(&reordered[(size_t)next * floats_per_vertex], &vertices[(size_t)index * floats_per_vertex],
+                floats_per_vertex * sizeof(GLfloat));
+            next++;
+        }
+        index = remap[index];
+    }
+
+    /* Vertices no triangle uses keep their relative order at the end */
+    for (size_t v = 0; v < vertex_count; v++) {
+        if (remap[v] == NO_VERTEX) {
+            memcpy(&reordered[(size_t)next * floats_per_vertex], &vertices[v * floats_per_vertex],
+                floats_per_vertex * sizeof(GLfloat));
+            next++;
+        }
+    }
+
+    vertices.swap(reordered);
+}
+
+void MeshOptimizer::optimize(std::vector<GLfloat>& vertices, unsigned int floats_per_vertex, std::vector<GLuint>& indices) {
+    std::vector<GLuint> cache_order;
+    std::vector<size_t> clusters;
+    optimize_vertex_cache(indices, vertices.size() / floats_per_vertex, cache_order, clusters);
+
+    optimize_overdraw(vertices, floats_per_vertex, cache_order, clusters, indices);
+
+    optimize_vertex_fetch(vertices, floats_per_vertex, indices);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+/*
+ * Load time reordering of an indexed triangle list, run once before the mesh is cached:
+ *  1. Tipsify (Sander, Nehab, Barczak 2007) orders triangles so their vertices are still in the post transform cache
+ *  2. the result is cut into clusters where the cache is flushed anyway, and clusters facing away from the mesh
+ *     center are drawn first so early-Z rejects more of what comes after them
+ *  3. vertices are renumbered in the order the triangles first use them, so fetches walk the buffer forwards
+ */
+class MeshOptimizer {
+
+public:
+
+    /* Size of the FIFO cache Tipsify targets and ACMR is measured against */
+    static const unsigned int CACHE_SIZE = 16;
+
+    /* A cluster is split once its own ACMR is this close to the whole mesh's, smaller clusters sort better */
+    static constexpr float OVERDRAW_THRESHOLD = 1.05f;
+
+    /* All three passes, vertices holds floats_per_vertex floats per vertex with the position first */
+    static void optimize(std::vector<GLfloat>& vertices, unsigned int floats_per_vertex, std::vector<GLuint>& indices);
+
+    /* Tipsify, clusters receives the first triangle of every run that started from a dead end */
+    static void optimize_vertex_cache(const std::vector<GLuint>& indices, size_t vertex_count,
+        std::vector<GLuint>& result, std::vector<size_t>& clusters);
+
+    static void optimize_overdraw(const std::vector<GLfloat>& vertices, unsigned int floats_per_vertex,
+        const std::vector<GLuint>& indices, const std::vector<size_t>& clusters, std::vector<GLuint>& result);
+
+    static void optimize_vertex_fetch(std::vector<GLfloat>& vertices, unsigned int floats_per_vertex, std::vector<GLuint>& indices);
+
+    /* Average cache misses per triangle with a FIFO cache, 0.5 is the best a large mesh can do and 3 the worst */
+    static double acmr(const GLuint* indices, size_t index_count, unsigned int cache_size = CACHE_SIZE);
+
+};
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "MeshRegistry.h"
+
+MeshRegistry::MeshRegistry(AssetStreamer& streamer, VertexFormat vertex_format, bool optimize) : streamer(streamer) {
+    this->vertex_format = vertex_format;
+    this->optimize = optimize;
+}
+
+std::shared_ptr<SharedMesh> MeshRegistry::acquire(const std::string& path, bool has_normal_maps, bool keep_cpu_data) {
+    /* The tangent layout is a different vertex buffer, so it is a different mesh */
+    std::string key = has_normal_maps ? path + "#tangents" : path;
+
+    auto found = this->entries.find(key);
+    if (found != this->entries.end()) {
+        std::shared_ptr<SharedMesh> existing = found->second.mesh.lock();
+        if (existing) {
+            if (keep_cpu_data && existing->ready && !existing->keep_cpu_data) {
+                std::cout << "CPU data of " << path << " was already released after upload" << std::endl;
+            }
+            existing->keep_cpu_data = existing->keep_cpu_data || keep_cpu_data;
+            return existing;
+        }
+    } else {
+        found = this->entries.emplace(key, Entry{ std::weak_ptr<SharedMesh>(), this->entries.size(), 0 }).first;
+    }
+
+    std::shared_ptr<SharedMesh> mesh = std::make_shared<SharedMesh>(path, has_normal_maps);
+    mesh->vertex_format = this->vertex_format;
+    mesh->keep_cpu_data = keep_cpu_data;
+    found->second.mesh = mesh;
+    found->second.load_count++;
+
+    bool optimize = this->optimize;
+    this->streamer.submit(path,
+        [path, has_normal_maps, optimize] { return MeshLoader::load(path.c_str(), has_normal_maps, optimize); },
+        [mesh](MeshData& data) {
+            mesh->set_mesh(std::move(data));
+            mesh->upload();
+        });
+
+    return mesh;
+}
+
+std::vector<std::shared_ptr<SharedMesh>> MeshRegistry::live_meshes() {
+    std::vector<const Entry*> ordered;
+    for (const auto& entry : this->entries) {
+        ordered.push_back(&entry.second);
+    }
+    std::sort(ordered.begin(), ordered.end(), [](const Entry* a, const Entry* b) { return a->order < b->order; });
+
+    std::vector<std::shared_ptr<SharedMesh>> meshes;
+    for (const Entry* entry : ordered) {
+        std::shared_ptr<SharedMesh> mesh = entry->mesh.lock();
+        if (mesh) {
+            meshes.push_back(mesh);
+        }
+    }
+    return meshes;
+}
+
+std::vector<MeshLoadStats> MeshRegistry::load_stats() {
+    std::vector<MeshLoadStats> stats;
+    for (const std::shared_ptr<SharedMesh>& mesh : live_meshes()) {
+        stats.push_back(mesh->load_stats);
+    }
+    return stats;
+}
+
+std::vector<VertexPackStats> MeshRegistry::vertex_stats() {
+    std::vector<VertexPackStats> stats;
+    for (const std::shared_ptr<SharedMesh>& mesh : live_meshes()) {
+        stats.push_back(mesh->vertex_stats);
+    }
+    return stats;
+}
+
+void MeshRegistry::print_report() {
+    size_t total_users = 0;
+    size_t shared_bytes = 0;
+    size_t unshared_bytes = 0;
+    size_t cpu_before = 0;
+    size_t cpu_after = 0;
+
+    std::cout << "Mesh registry\n";
+    for (const auto& entry : this->entries) {
+        std::shared_ptr<SharedMesh> mesh = entry.second.mesh.lock();
+        if (!mesh) {
+            continue;
+        }
+
+        /* Not counting the reference held here */
+        size_t users = (size_t)mesh.use_count() - 1;
+        total_users += users;
+        shared_bytes += mesh->gpu_bytes;
+        unshared_bytes += mesh->gpu_bytes * users;
+        cpu_before += mesh->cpu_bytes_at_upload;
+        cpu_after += mesh->cpu_bytes();
+
+        char line[256];
+        snprintf(line, sizeof(line), "  %-28s users %5zu  loads %2zu  GPU %8.2f MB  CPU %8.2f MB at upload, %8.2f MB now%s\n",
+            entry.first.c_str(), users, entry.second.load_count, mesh->gpu_bytes / (1024.0 * 1024.0),
+            mesh->cpu_bytes_at_upload / (1024.0 * 1024.0), mesh->cpu_bytes() / (1024.0 * 1024.0), mesh->keep_cpu_data ? " (kept)" : "");
+        std::cout << line;
+    }
+
+    char summary[256];
+    snprintf(summary, sizeof(summary), "  %zu users share %.2f MB of mesh buffers, %.2f MB with a copy per user\n",
+        total_users, shared_bytes / (1024.0 * 1024.0), unshared_bytes / (1024.0 * 1024.0));
+    std::cout << summary;
+
+    snprintf(summary, sizeof(summary), "  CPU copies %.2f MB at upload, %.2f MB after releasing them\n",
+        cpu_before / (1024.0 * 1024.0), cpu_after / (1024.0 * 1024.0));
+    std::cout << summary << std::flush;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AssetStreamer.h"
+#include "MeshLoader.h"
+#include "SharedMesh.h"
+#include "VertexPacker.h"
+
+/*
+ * Hands out one SharedMesh per obj, so placing the same model many times parses and uploads it once.
+ * The registry only keeps weak references, the GPU buffers live as long as some Model3D still uses them
+ * and are loaded again if the obj is asked for after that.
+ */
+class MeshRegistry {
+
+public:
+
+    MeshRegistry(AssetStreamer& streamer, VertexFormat vertex_format, bool optimize);
+
+    /*
+     * Returns the mesh for path, starting to stream it in if nothing holds it yet. keep_cpu_data keeps the
+     * vertices and indices after upload, it has to be asked for before the mesh has finished loading
+     */
+    std::shared_ptr<SharedMesh> acquire(const std::string& path, bool has_normal_maps, bool keep_cpu_data = false);
+
+    /* Stats of every mesh still alive, in the order they were first acquired */
+    std::vector<MeshLoadStats> load_stats();
+
+    std::vector<VertexPackStats> vertex_stats();
+
+    void print_report();
+
+private:
+
+    struct Entry {
+        std::weak_ptr<SharedMesh> mesh;
+        size_t order;
+        size_t load_count; // times the obj was loaded, more than one if every user let it go in between
+    };
+
+    AssetStreamer& streamer;
+    VertexFormat vertex_format;
+    bool optimize;
+    std::map<std::string, Entry> entries;
+
+    std::vector<std::shared_ptr<SharedMesh>> live_meshes();
+
+};
@@ -0,0 +1,442 @@
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
+static const GLuint NO_INDEX = 0xFFFFFFFFu;
+
+/* Border edges get a plane perpendicular to their face, weighted this much more so open edges keep their outline */
+static const double BORDER_WEIGHT = 10.0;
+
+/* Position kinds for one pass, recomputed from the edges still alive */
+static const unsigned char POSITION_MANIFOLD = 0;
+static const unsigned char POSITION_BORDER = 1;
+static const unsigned char POSITION_LOCKED = 2; // on an edge shared by more than two triangles
+
+/* Candidate edge collapse, from is merged into to */
+struct EdgeCollapse {
+    GLuint from;
+    GLuint to;
+    double cost;
+    bool border;
+};
+
+static uint64_t edge_key(GLuint a, GLuint b) {
+    return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+void MeshSimplifier::bounding_sphere(const GLfloat* vertices, size_t vertex_count, unsigned int floats_per_vertex,
+    glm::vec3& center, float& radius) {
+    if (vertex_count == 0) {
+        center = glm::vec3(0.0f);
+        radius = 0.0f;
+        return;
+    }
+
+    glm::vec3 low(vertices[0], vertices[1], vertices[2]);
+    glm::vec3 high = low;
+    for (size_t i = 1; i < vertex_count; i++) {
+        const GLfloat* vertex = vertices + i * floats_per_vertex;
+        glm::vec3 position(vertex[0], vertex[1], vertex[2]);
+        low = glm::min(low, position);
+        high = glm::max(high, position);
+    }
+
+    center = (low + high) * 0.5f;
+    radius = glm::length(high - low) * 0.5f;
+}
+
+MeshSimplifier::MeshSimplifier(const std::vector<GLfloat>& vertices, unsigned int floats_per_vertex, const std::vector<GLuint>& indices)
+    : vertices(vertices), floats_per_vertex(floats_per_vertex), triangles(indices), error(0.0f) {
+    size_t vertex_count = vertices.size() / floats_per_vertex;
+    this->triangles.resize(indices.size() / 3 * 3);
+
+    glm::vec3 center;
+    bounding_sphere(vertices.data(), vertex_count, floats_per_vertex, center, this->radius);
+
+    /* Vertices with bit identical positions become one position */
+    std::vector<GLuint> order(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        order[v] = (GLuint)v;
+    }
+    std::sort(order.begin(), order.end(), [&vertices, floats_per_vertex](GLuint a, GLuint b) {
+        int compare = memcmp(&vertices[(size_t)a * floats_per_vertex], &vertices[(size_t)b * floats_per_vertex], 3 * sizeof(GLfloat));
+        return compare != 0 ? compare < 0 : a < b;
+    });
+
+    this->vertex_position.resize(vertex_count);
+    this->position_vertex_offsets.push_back(0);
+    for (size_t i = 0; i < vertex_count; i++) {
+        const GLfloat* vertex = &vertices[(size_t)order[i] * floats_per_vertex];
+        if (i == 0 || memcmp(vertex, &vertices[(size_t)order[i - 1] * floats_per_vertex], 3 * sizeof(GLfloat)) != 0) {
+            if (i > 0) {
+                this->position_vertex_offsets.push_back((GLuint)i);
+            }
+            this->positions.push_back(glm::vec3(vertex[0], vertex[1], vertex[2]));
+        }
+        this->vertex_position[order[i]] = (GLuint)(this->positions.size() - 1);
+    }
+    this->position_vertex_offsets.push_back((GLuint)vertex_count);
+    this->position_vertices = order;
+
+    /* Triangles with two corners on one position have no area and no edges worth collapsing */
+    size_t kept = 0;
+    for (size_t t = 0; t < this->triangles.size() / 3; t++) {
+        GLuint p0 = this->vertex_position[this->triangles[t * 3]];
+        GLuint p1 = this->vertex_position[this->triangles[t * 3 + 1]];
+        GLuint p2 = this->vertex_position[this->triangles[t * 3 + 2]];
+        if (p0 != p1 && p1 != p2 && p0 != p2) {
+            memmove(&this->triangles[kept * 3], &this->triangles[t * 3], 3 * sizeof(GLuint));
+            kept++;
+        }
+    }
+    this->triangles.resize(kept * 3);
+
+    size_t position_count = this->positions.size();
+    this->collapsed_into.resize(position_count);
+    for (size_t p = 0; p < position_count; p++) {
+        this->collapsed_into[p] = (GLuint)p;
+    }
+
+    /* Area weighted face planes, plus a perpendicular plane along every border edge */
+    Quadric empty = {};
+    this->quadrics.assign(position_count, empty);
+    std::vector<uint64_t> edges;
+    for (size_t t = 0; t < this->triangles.size() / 3; t++) {
+        GLuint p[3];
+        for (int corner = 0; corner < 3; corner++) {
+            p[corner] = this->vertex_position[this->triangles[t * 3 + corner]];
+        }
+        glm::dvec3 p0 = this->positions[p[0]], p1 = this->positions[p[1]], p2 = this->positions[p[2]];
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length <= 0.0) {
+            continue;
+        }
+        normal /= length;
+
+        for (int corner = 0; corner < 3; corner++) {
+            add_plane(this->quadrics[p[corner]], normal, -glm::dot(normal, p0), length * 0.5, true);
+            edges.push_back(edge_key(p[corner], p[(corner + 1) % 3]));
+        }
+    }
+
+    std::vector<uint64_t> sorted_edges = edges;
+    std::sort(sorted_edges.begin(), sorted_edges.end());
+    size_t edge = 0;
+    for (size_t t = 0; t < this->triangles.size() / 3; t++) {
+        GLuint p[3];
+        for (int corner = 0; corner < 3; corner++) {
+            p[corner] = this->vertex_position[this->triangles[t * 3 + corner]];
+        }
+        glm::dvec3 p0 = this->positions[p[0]], p1 = this->positions[p[1]], p2 = this->positions[p[2]];
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        if (glm::length(normal) <= 0.0) {
+            continue;
+        }
+        normal = glm::normalize(normal);
+
+        for (int corner = 0; corner < 3; corner++, edge++) {
+            auto range = std::equal_range(sorted_edges.begin(), sorted_edges.end(), edges[edge]);
+            if (range.second - range.first != 1) {
+                continue;
+            }
+            glm::dvec3 a = this->positions[p[corner]];
+            glm::dvec3 b = this->positions[p[(corner + 1) % 3]];
+            glm::dvec3 side = glm::cross(b - a, normal);
+            double side_length = glm::length(side);
+            if (side_length <= 0.0) {
+                continue;
+            }
+            side /= side_length;
+            double weight = glm::dot(b - a, b - a) * BORDER_WEIGHT;
+            add_plane(this->quadrics[p[corner]], side, -glm::dot(side, a), weight, false);
+            add_plane(this->quadrics[p[(corner + 1) % 3]], side, -glm::dot(side, a), weight, false);
+        }
+    }
+}
+
+/* Only face planes count towards the area, border planes then act as a penalty on top of the mean */
+void MeshSimplifier::add_plane(Quadric& quadric, glm::dvec3 n, double d, double weight, bool is_area) {
+    quadric.a2 += weight * n.x * n.x;
+    quadric.ab += weight * n.x * n.y;
+    quadric.ac += weight * n.x * n.z;
+    quadric.ad += weight * n.x * d;
+    quadric.b2 += weight * n.y * n.y;
+    quadric.bc += weight * n.y * n.z;
+    quadric.bd += weight * n.y * d;
+    quadric.c2 += weight * n.z * n.z;
+    quadric.cd += weight * n.z * d;
+    quadric.d2 += weight * d * d;
+    if (is_area) {
+        quadric.weight += weight;
+    }
+}
+
+void MeshSimplifier::add_quadric(Quadric& quadric, const Quadric& other) {
+    quadric.a2 += other.a2;
+    quadric.ab += other.ab;
+    quadric.ac += other.ac;
+    quadric.ad += other.ad;
+    quadric.b2 += other.b2;
+    quadric.bc += other.bc;
+    quadric.bd += other.bd;
+    quadric.c2 += other.c2;
+    quadric.cd += other.cd;
+    quadric.d2 += other.d2;
+    quadric.weight += other.weight;
+}
+
+/* Mean squared distance from the point to the planes in the quadric */
+double MeshSimplifier::evaluate(const Quadric& q, glm::vec3 point) {
+    double x = point.x, y = point.y, z = point.z;
+    double sum = q.a2 * x * x + 2.0 * q.ab * x * y + 2.0 * q.ac * x * z + 2.0 * q.ad * x
+        + q.b2 * y * y + 2.0 * q.bc * y * z + 2.0 * q.bd * y
+        + q.c2 * z * z + 2.0 * q.cd * z
+        + q.d2;
+    return q.weight > 0.0 ? std::max(0.0, sum / q.weight) : 0.0;
+}
+
+GLuint MeshSimplifier::find(GLuint position) const {
+    while (this->collapsed_into[position] != position) {
+        position = this->collapsed_into[position];
+    }
+    return position;
+}
+
+/* The vertex at the corner's current position with the closest normal, uv and tangents */
+GLuint MeshSimplifier::resolve_corner(GLuint vertex) const {
+    GLuint position = find(this->vertex_position[vertex]);
+    if (position == this->vertex_position[vertex]) {
+        return vertex;
+    }
+
+    const GLfloat* original = &this->vertices[(size_t)vertex * this->floats_per_vertex];
+    GLuint best = NO_INDEX;
+    float best_distance = 0.0f;
+    for (GLuint i = this->position_vertex_offsets[position]; i < this->position_vertex_offsets[position + 1]; i++) {
+        GLuint candidate = this->position_vertices[i];
+        const GLfloat* attributes = &this->vertices[(size_t)candidate * this->floats_per_vertex];
+        float distance = 0.0f;
+        for (unsigned int f = 3; f < this->floats_per_vertex; f++) {
+            distance += (attributes[f] - original[f]) * (attributes[f] - original[f]);
+        }
+        if (best == NO_INDEX || distance < best_distance) {
+            best = candidate;
+            best_distance = distance;
+        }
+    }
+    return best;
+}
+
+/* Moving from onto to must not turn any of the triangles around from over */
+bool MeshSimplifier::collapse_flips(GLuint from, GLuint to, const std::vector<GLuint>& offsets, const std::vector<GLuint>& adjacent) const {
+    glm::vec3 target = this->positions[to];
+
+    for (GLuint a = offsets[from]; a < offsets[from + 1]; a++) {
+        GLuint t = adjacent[a];
+        GLuint p[3];
+        for (int corner = 0; corner < 3; corner++) {
+            p[corner] = find(this->vertex_position[this->triangles[t * 3 + corner]]);
+        }
+        if (p[0] == p[1] || p[1] == p[2] || p[0] == p[2] || p[0] == to || p[1] == to || p[2] == to) {
+            continue; // already gone, or removed by this collapse
+        }
+
+        glm::vec3 before[3], after[3];
+        for (int corner = 0; corner < 3; corner++) {
+            before[corner] = this->positions[p[corner]];
+            after[corner] = p[corner] == from ? target : before[corner];
+        }
+        glm::vec3 normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+        if (glm::dot(normal_before, normal_after) <= 0.0f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+float MeshSimplifier::simplify(size_t target_triangles, float max_error) {
+    double max_cost = (double)max_error * this->radius * (double)max_error * this->radius;
+    size_t position_count = this->positions.size();
+
+    while (triangle_count() > target_triangles) {
+        size_t live_triangles = triangle_count();
+
+        /* Edges still alive and how many triangles use each */
+        std::vector<uint64_t> edges;
+        edges.reserve(live_triangles * 3);
+        for (size_t t = 0; t < live_triangles; t++) {
+            GLuint p[3];
+            for (int corner = 0; corner < 3; corner++) {
+                p[corner] = find(this->vertex_position[this->triangles[t * 3 + corner]]);
+            }
+            for (int corner = 0; corner < 3; corner++) {
+                edges.push_back(edge_key(p[corner], p[(corner + 1) % 3]));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        std::vector<unsigned char> kind(position_count, POSITION_MANIFOLD);
+        std::vector<uint64_t> unique_edges;
+        std::vector<unsigned int> edge_uses;
+        for (size_t e = 0; e < edges.size();) {
+            size_t next = e;
+            while (next < edges.size() && edges[next] == edges[e]) {
+                next++;
+            }
+            GLuint a = (GLuint)(edges[e] >> 32), b = (GLuint)edges[e];
+            unsigned char edge_kind = next - e == 1 ? POSITION_BORDER : next - e > 2 ? POSITION_LOCKED : POSITION_MANIFOLD;
+            kind[a] = std::max(kind[a], edge_kind);
+            kind[b] = std::max(kind[b], edge_kind);
+            unique_edges.push_back(edges[e]);
+            edge_uses.push_back((unsigned int)(next - e));
+            e = next;
+        }
+
+        /* Cheapest allowed direction for every edge. Border positions may only slide along the border */
+        std::vector<EdgeCollapse> collapses;
+        for (size_t e = 0; e < unique_edges.size(); e++) {
+            GLuint a = (GLuint)(unique_edges[e] >> 32), b = (GLuint)unique_edges[e];
+            bool border_edge = edge_uses[e] == 1;
+            EdgeCollapse best = { 0, 0, -1.0, border_edge };
+
+            GLuint ends[2][2] = { { a, b }, { b, a } };
+            for (int direction = 0; direction < 2; direction++) {
+                GLuint from = ends[direction][0], to = ends[direction][1];
+                if (kind[from] == POSITION_LOCKED || (kind[from] == POSITION_BORDER && !border_edge)) {
+                    continue;
+                }
+                Quadric merged = this->quadrics[from];
+                add_quadric(merged, this->quadrics[to]);
+                double cost = evaluate(merged, this->positions[to]);
+                if (best.cost < 0.0 || cost < best.cost) {
+                    best.from = from;
+                    best.to = to;
+                    best.cost = cost;
+                }
+            }
+            if (best.cost >= 0.0) {
+                collapses.push_back(best);
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const EdgeCollapse& x, const EdgeCollapse& y) {
+            return x.cost < y.cost;
+        });
+
+        /* Triangles around each position for the flip test */
+        std::vector<GLuint> offsets(position_count + 1, 0);
+        for (size_t t = 0; t < live_triangles; t++) {
+            for (int corner = 0; corner < 3; corner++) {
+                offsets[find(this->vertex_position[this->triangles[t * 3 + corner]]) + 1]++;
+            }
+        }
+        for (size_t p = 0; p < position_count; p++) {
+            offsets[p + 1] += offsets[p];
+        }
+        std::vector<GLuint> adjacent(offsets.back());
+        std::vector<GLuint> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < live_triangles; t++) {
+            for (int corner = 0; corner < 3; corner++) {
+                adjacent[fill[find(this->vertex_position[this->triangles[t * 3 + corner]])]++] = (GLuint)t;
+            }
+        }
+
+        /* Apply the cheapest collapses, each position takes part in at most one per pass */
+        std::vector<char> touched(position_count, 0);
+        size_t to_remove = live_triangles - target_triangles;
+        size_t removed = 0;
+        for (const EdgeCollapse& collapse : collapses) {
+            if (removed >= to_remove || collapse.cost > max_cost) {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+            if (collapse_flips(collapse.from, collapse.to, offsets, adjacent)) {
+                continue;
+            }
+
+            this->collapsed_into[collapse.from] = collapse.to;
+            add_quadric(this->quadrics[collapse.to], this->quadrics[collapse.from]);
+            touched[collapse.from] = 1;
+            touched[collapse.to] = 1;
+            removed += collapse.border ? 1 : 2;
+            this->error = std::max(this->error, (float)(std::sqrt(collapse.cost) / std::max(this->radius, 1e-20f)));
+        }
+
+        if (removed == 0) {
+            break;
+        }
+
+        /* Drop the triangles that collapsed to a line */
+        size_t kept = 0;
+        for (size_t t = 0; t < live_triangles; t++) {
+            GLuint p[3];
+            for (int corner = 0; corner < 3; corner++) {
+                p[corner] = find(this->vertex_position[this->triangles[t * 3 + corner]]);
+            }
+            if (p[0] == p[1] || p[1] == p[2] || p[0] == p[2]) {
+                continue;
+            }
+            memmove(&this->triangles[kept * 3], &this->triangles[t * 3], 3 * sizeof(GLuint));
+            kept++;
+        }
+        this->triangles.resize(kept * 3);
+
+        for (size_t p = 0; p < position_count; p++) {
+            this->collapsed_into[p] = find((GLuint)p);
+        }
+    }
+
+    return this->error;
+}
+
+size_t MeshSimplifier::triangle_count() const {
+    return this->triangles.size() / 3;
+}
+
+void MeshSimplifier::get_indices(std::vector<GLuint>& indices) const {
+    indices.resize(this->triangles.size());
+    for (size_t i = 0; i < this->triangles.size(); i++) {
+        indices[i] = resolve_corner(this->triangles[i]);
+    }
+}
+
+void MeshSimplifier::build_lod_chain(const std::vector<GLfloat>& vertices, unsigned int floats_per_vertex,
+    std::vector<GLuint>& indices, std::vector<MeshLod>& lods) {
+    lods.clear();
+    lods.push_back({ 0, (uint32_t)indices.size(), 0.0f });
+
+    MeshSimplifier simplifier(vertices, floats_per_vertex, indices);
+    size_t full_triangles = indices.size() / 3;
+    size_t previous_triangles = full_triangles;
+    std::vector<GLuint> level, ordered;
+    std::vector<size_t> clusters;
+    float target = 1.0f;
+
+    for (unsigned int l = 1; l < LOD_COUNT; l++) {
+        target *= LOD_RATIO;
+        float level_error = simplifier.simplify((size_t)(full_triangles * target), MAX_LOD_ERROR);
+
+        /* Not worth a level of its own if the error limit stopped it early */
+        if (simplifier.triangle_count() == 0 || simplifier.triangle_count() * 4 > previous_triangles * 3) {
+            break;
+        }
+        previous_triangles = simplifier.triangle_count();
+
+        simplifier.get_indices(level);
+        MeshOptimizer::optimize_vertex_cache(level, vertices.size() / floats_per_vertex, ordered, clusters);
+
+        lods.push_back({ (uint32_t)indices.size(), (uint32_t)ordered.size(), level_error });
+        indices.insert(indices.end(), ordered.begin(), ordered.end());
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MeshCache.h"
+
+/*
+ * Quadric error metric simplifier (Garland and Heckbert 1997). Edges are collapsed onto one of their
+ * endpoints, so every level of detail indexes the same vertex buffer and only needs its own index range.
+ * Vertices that only differ in normal or uv are simplified as one position, a collapsed corner then picks
+ * the vertex at its new position whose attributes are closest to the ones it had.
+ */
+class MeshSimplifier {
+
+public:
+
+    /* Levels in a chain including the full mesh, each one aims for LOD_RATIO of the triangles of the one before */
+    static const unsigned int LOD_COUNT = 4;
+    static constexpr float LOD_RATIO = 0.35f;
+
+    /* Levels stop once the error would pass this fraction of the mesh radius */
+    static constexpr float MAX_LOD_ERROR = 0.15f;
+
+    MeshSimplifier(const std::vector<GLfloat>& vertices, unsigned int floats_per_vertex, const std::vector<GLuint>& indices);
+
+    /*
+     * Collapses edges until at most target_triangles are left or the cheapest collapse would go over max_error.
+     * Can be called again with a lower target to continue. Returns the error so far, relative to the mesh radius
+     */
+    float simplify(size_t target_triangles, float max_error);
+
+    size_t triangle_count() const;
+
+    /* The current triangles in their original order, indexing the original vertices */
+    void get_indices(std::vector<GLuint>& indices) const;
+
+    /*
+     * Appends the lower levels to indices, each reordered for the vertex cache, and describes every level in lods.
+     * The first level is the indices as they were
+     */
+    static void build_lod_chain(const std::vector<GLfloat>& vertices, unsigned int floats_per_vertex,
+        std::vector<GLuint>& indices, std::vector<MeshLod>& lods);
+
+    /* Center of the bounding box and half its diagonal, the radius LOD errors are relative to */
+    static void bounding_sphere(const GLfloat* vertices, size_t vertex_count, unsigned int floats_per_vertex,
+        glm::vec3& center, float& radius);
+
+private:
+
+    /* Symmetric 4x4 plane quadric and the area it was accumulated over */
+    struct Quadric {
+        double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+        double weight; // area of the face planes
+    };
+
+    const std::vector<GLfloat>& vertices;
+    unsigned int floats_per_vertex;
+    float radius;
+
+    std::vector<glm::vec3> positions; // one per distinct position
+    std::vector<GLuint> vertex_position; // position of every vertex
+    std::vector<GLuint> position_vertex_offsets; // vertices sharing each position, as offsets into position_vertices
+    std::vector<GLuint> position_vertices;
+    std::vector<GLuint> collapsed_into; // position a position was merged into, itself while alive
+    std::vector<Quadric> quadrics;
+
+    std::vector<GLuint> triangles; // original vertices of the triangles still alive
+    float error;
+
+    GLuint find(GLuint position) const;
+
+    GLuint resolve_corner(GLuint vertex) const;
+
+    static void add_plane(Quadric& quadric, glm::dvec3 normal, double distance, double weight, bool is_area);
+
+    static void add_quadric(Quadric& quadric, const Quadric& other);
+
+    static double evaluate(const Quadric& quadric, glm::vec3 point);
+
+    bool collapse_flips(GLuint from, GLuint to, const std::vector<GLuint>& offsets, const std::vector<GLuint>& adjacent) const;
+
+};
@@ -0,0 +1,419 @@
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "AssetArchive.h"
+#include "MeshStreamLoader.h"
+#include "ObjTriangulator.h"
+#include "TangentGenerator.h"
+#include "VertexLayouts.h"
+#include "tiny_obj_loader.h"
+
+/* Weld key, the obj index triple. Tangents are summed over the welded vertices afterwards, like every other mesh */
+struct StreamVertexKey {
+    int vertex_index;
+    int normal_index;
+    int texcoord_index;
+};
+
+struct StreamSlot {
+    StreamVertexKey key;
+    GLuint index;
+};
+
+/* Scratch file next to the cache file, written once, read back as often as needed and removed when it goes */
+class SpoolFile {
+
+public:
+
+    explicit SpoolFile(const std::string& path) : path(path) {
+        this->out.open(path, std::ios::binary | std::ios::trunc);
+    }
+
+    ~SpoolFile() {
+        this->out.close();
+        this->in.close();
+        std::error_code ec;
+        std::filesystem::remove(this->path, ec);
+    }
+
+    bool write(const void* data, size_t bytes) {
+        this->out.write((const char*)data, bytes);
+        return (bool)this->out;
+    }
+
+    /* Ends writing, reads start over from the beginning */
+    bool rewind() {
+        if (this->out.is_open()) {
+            this->out.close();
+            if (!this->out) {
+                return false;
+            }
+        }
+        this->in.close();
+        this->in.clear();
+        this->in.open(this->path, std::ios::binary);
+        return (bool)this->in;
+    }
+
+    bool read(void* data, size_t bytes) {
+        this->in.read((char*)data, bytes);
+        return (size_t)this->in.gcount() == bytes;
+    }
+
+    bool is_open() const {
+        return this->out.is_open();
+    }
+
+private:
+
+    std::string path;
+    std::ofstream out;
+    std::ifstream in;
+
+};
+
+/* State shared by the tinyobj callbacks while one obj is being streamed */
+struct StreamState {
+    /* Raw attribute pools, faces can reference any earlier entry so these have to stay resident */
+    std::vector<tinyobj::real_t> positions;
+    std::vector<tinyobj::real_t> normals;
+    std::vector<tinyobj::real_t> texcoords;
+
+    std::vector<tinyobj::index_t> face;
+    std::vector<tinyobj::index_t> triangles;
+
+    /* Open addressing weld table, grown by doubling */
+    std::vector<StreamSlot> slots;
+    size_t slot_count;
+
+    /* Fixed size staging chunks of welded position, normal and uv vertices and of the triangle list */
+    std::vector<GLfloat> vertex_chunk;
+    std::vector<GLuint> index_chunk;
+    size_t total_indices;
+
+    /* Vertices go straight into the cache file unless they still need tangents, then they are spooled like the indices */
+    MeshCacheWriter* writer;
+    SpoolFile* vertex_spool;
+    SpoolFile* index_spool;
+    bool failed;
+};
+
+static const GLuint EMPTY_SLOT = 0xFFFFFFFFu;
+
+static void flush_vertices(StreamState& state) {
+    if (state.vertex_chunk.empty()) {
+        return;
+    }
+    bool written = state.vertex_spool
+        ? state.vertex_spool->write(state.vertex_chunk.data(), state.vertex_chunk.size() * sizeof(GLfloat))
+        : state.writer->write_vertices(state.vertex_chunk.data(), state.vertex_chunk.size());
+    if (!written) {
+        state.failed = true;
+    }
+    state.vertex_chunk.clear();
+}
+
+static void flush_indices(StreamState& state) {
+    if (!state.index_chunk.empty() && !state.index_spool->write(state.index_chunk.data(), state.index_chunk.size() * sizeof(GLuint))) {
+        state.failed = true;
+    }
+    state.index_chunk.clear();
+}
+
+static size_t slot_for(const StreamState& state, const StreamVertexKey& key) {
+    size_t mask = state.slots.size() - 1;
+    size_t slot = (size_t)MeshCache::hash_bytes(&key, sizeof(key)) & mask;
+
+    while (state.slots[slot].index != EMPTY_SLOT && memcmp(&state.slots[slot].key, &key, sizeof(key)) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void grow_slots(StreamState& state) {
+    std::vector<StreamSlot> old_slots;
+    old_slots.swap(state.slots);
+
+    StreamSlot empty;
+    memset(&empty, 0, sizeof(empty));
+    empty.index = EMPTY_SLOT;
+    state.slots.assign(old_slots.size() * 2, empty);
+
+    for (const StreamSlot& entry : old_slots) {
+        if (entry.index != EMPTY_SLOT) {
+            state.slots[slot_for(state, entry.key)] = entry;
+        }
+    }
+}
+
+static void emit_corner(StreamState& state, const tinyobj::index_t& corner) {
+    StreamVertexKey key;
+    key.vertex_index = corner.vertex_index;
+    key.normal_index = corner.normal_index;
+    key.texcoord_index = corner.texcoord_index;
+
+    size_t slot = slot_for(state, key);
+    if (state.slots[slot].index == EMPTY_SLOT) {
+        /* New vertex, keep the table at most half full */
+        if ((state.slot_count + 1) * 2 > state.slots.size()) {
+            grow_slots(state);
+            slot = slot_for(state, key);
+        }
+
+        state.slots[slot].key = key;
+        state.slots[slot].index = (GLuint)state.slot_count++;
+
+        size_t v = (size_t)corner.vertex_index * 3;
+        GLfloat vertex[FloatVertex::FLOATS] = {
+            state.positions[v], state.positions[v + 1], state.positions[v + 2],
+            0.0f, 0.0f, 0.0f,
+            0.0f, 0.0f
+        };
+
+        if (corner.normal_index >= 0 && (size_t)corner.normal_index * 3 + 2 < state.normals.size()) {
+            vertex[3] = state.normals[(size_t)corner.normal_index * 3];
+            vertex[4] = state.normals[(size_t)corner.normal_index * 3 + 1];
+            vertex[5] = state.normals[(size_t)corner.normal_index * 3 + 2];
+        }
+        if (corner.texcoord_index >= 0 && (size_t)corner.texcoord_index * 2 + 1 < state.texcoords.size()) {
+            vertex[6] = state.texcoords[(size_t)corner.texcoord_index * 2];
+            vertex[7] = state.texcoords[(size_t)corner.texcoord_index * 2 + 1];
+        }
+
+        state.vertex_chunk.insert(state.vertex_chunk.end(), vertex, vertex + FloatVertex::FLOATS);
+        if (state.vertex_chunk.size() >= MeshStreamLoader::CHUNK_VERTICES * FloatVertex::FLOATS) {
+            flush_vertices(state);
+        }
+    }
+
+    state.index_chunk.push_back(state.slots[slot].index);
+    state.total_indices++;
+    if (state.index_chunk.size() >= MeshStreamLoader::CHUNK_VERTICES) {
+        flush_indices(state);
+    }
+}
+
+static void vertex_cb(void* user_data, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z, tinyobj::real_t /*w*/) {
+    StreamState& state = *(StreamState*)user_data;
+    state.positions.push_back(x);
+    state.positions.push_back(y);
+    state.positions.push_back(z);
+}
+
+static void normal_cb(void* user_data, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z) {
+    StreamState& state = *(StreamState*)user_data;
+    state.normals.push_back(x);
+    state.normals.push_back(y);
+    state.normals.push_back(z);
+}
+
+static void texcoord_cb(void* user_data, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t /*z*/) {
+    StreamState& state = *(StreamState*)user_data;
+    state.texcoords.push_back(x);
+    state.texcoords.push_back(y);
+}
+
+/* obj indices are 1 based or negative relative to the current end of the pool, 0 means absent */
+static bool fix_index(int raw, size_t pool_count, int& index) {
+    if (raw > 0) {
+        index = raw - 1;
+        return true;
+    }
+    if (raw < 0) {
+        index = (int)pool_count + raw;
+        return index >= 0;
+    }
+    index = -1;
+    return false;
+}
+
+static void index_cb(void* user_data, tinyobj::index_t* indices, int num_indices) {
+    StreamState& state = *(StreamState*)user_data;
+    if (state.failed) {
+        return;
+    }
+
+    state.face.clear();
+    for (int i = 0; i < num_indices; i++) {
+        tinyobj::index_t corner;
+        if (!fix_index(indices[i].vertex_index, state.positions.size() / 3, corner.vertex_index) ||
+            (size_t)corner.vertex_index * 3 + 2 >= state.positions.size()) {
+            std::cout << "Face with invalid vertex index found" << std::endl;
+            state.failed = true;
+            return;
+        }
+        fix_index(indices[i].normal_index, state.normals.size() / 3, corner.normal_index);
+        fix_index(indices[i].texcoord_index, state.texcoords.size() / 2, corner.texcoord_index);
+        state.face.push_back(corner);
+    }
+
+    state.triangles.clear();
+    ObjTriangulator::triangulate(state.face.data(), state.face.size(), state.positions.data(), state.positions.size(), state.triangles);
+
+    for (const tinyobj::index_t& corner : state.triangles) {
+        emit_corner(state, corner);
+    }
+}
+
+/*
+ * Second pass of normal mapped meshes over the spooled chunks. Every triangle has to be summed in before the
+ * first vertex can be finished, so the vertices are read twice, around one read of the triangle list
+ */
+static bool write_with_tangents(SpoolFile& vertices, SpoolFile& indices, size_t vertex_count, size_t index_count,
+    MeshCacheWriter& writer, size_t& working_set) {
+    const size_t CHUNK = MeshStreamLoader::CHUNK_VERTICES;
+    TangentAccumulator tangents(vertex_count);
+    std::vector<GLfloat> chunk(CHUNK * FloatVertex::FLOATS);
+
+    if (!vertices.rewind()) {
+        return false;
+    }
+    for (size_t first = 0; first < vertex_count; first += CHUNK) {
+        size_t count = std::min(CHUNK, vertex_count - first);
+        if (!vertices.read(chunk.data(), count * FloatVertex::FLOATS * sizeof(GLfloat))) {
+            return false;
+        }
+        tangents.add_vertices(first, chunk.data(), count);
+    }
+
+    /* Whole triangles at a time */
+    std::vector<GLuint> index_chunk(CHUNK / 3 * 3);
+    if (!indices.rewind()) {
+        return false;
+    }
+    for (size_t first = 0; first < index_count; first += index_chunk.size()) {
+        size_t count = std::min(index_chunk.size(), index_count - first);
+        if (!indices.read(index_chunk.data(), count * sizeof(GLuint))) {
+            return false;
+        }
+        tangents.add_triangles(index_chunk.data(), count);
+    }
+
+    std::vector<GLfloat> output(CHUNK * FloatTangentVertex::FLOATS);
+    if (!vertices.rewind()) {
+        return false;
+    }
+    for (size_t first = 0; first < vertex_count; first += CHUNK) {
+        size_t count = std::min(CHUNK, vertex_count - first);
+        if (!vertices.read(chunk.data(), count * FloatVertex::FLOATS * sizeof(GLfloat))) {
+            return false;
+        }
+        tangents.finish_vertices(first, chunk.data(), count, output.data());
+        if (!writer.write_vertices(output.data(), count * FloatTangentVertex::FLOATS)) {
+            return false;
+        }
+    }
+
+    working_set = std::max(working_set, tangents.memory_bytes() +
+        (chunk.size() + output.size()) * sizeof(GLfloat) + index_chunk.size() * sizeof(GLuint));
+    return true;
+}
+
+static bool copy_indices(SpoolFile& indices, size_t index_count, MeshCacheWriter& writer) {
+    std::vector<GLuint> chunk(MeshStreamLoader::CHUNK_VERTICES);
+    if (!indices.rewind()) {
+        return false;
+    }
+    for (size_t first = 0; first < index_count; first += chunk.size()) {
+        size_t count = std::min(chunk.size(), index_count - first);
+        if (!indices.read(chunk.data(), count * sizeof(GLuint)) || !writer.write_indices(chunk.data(), count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MeshStreamLoader::load(const char* path, const MeshSourceKey& key, bool has_normal_maps, MeshData& data) {
+    /* Reads the packed copy in place when there is one */
+    std::unique_ptr<std::istream> source = AssetArchive::open_stream(path);
+    if (!*source) {
+        return false;
+    }
+
+    MeshCacheWriter writer;
+    if (!writer.begin(path, key, data.floats_per_vertex)) {
+        return false;
+    }
+
+    std::string spool_path = MeshCache::cache_path(path, data.floats_per_vertex);
+    SpoolFile index_spool(spool_path + ".idx.tmp");
+    std::unique_ptr<SpoolFile> vertex_spool;
+    if (has_normal_maps) {
+        vertex_spool = std::make_unique<SpoolFile>(spool_path + ".vtx.tmp");
+    }
+    if (!index_spool.is_open() || (vertex_spool && !vertex_spool->is_open())) {
+        std::cout << "Could not write mesh spool " << spool_path << std::endl;
+        return false;
+    }
+
+    StreamState state;
+    state.slot_count = 0;
+    state.total_indices = 0;
+    state.writer = &writer;
+    state.vertex_spool = vertex_spool.get();
+    state.index_spool = &index_spool;
+    state.failed = false;
+
+    StreamSlot empty;
+    memset(&empty, 0, sizeof(empty));
+    empty.index = EMPTY_SLOT;
+    state.slots.assign(1024, empty);
+
+    state.vertex_chunk.reserve(CHUNK_VERTICES * FloatVertex::FLOATS);
+    state.index_chunk.reserve(CHUNK_VERTICES);
+
+    tinyobj::callback_t callbacks;
+    callbacks.vertex_cb = vertex_cb;
+    callbacks.normal_cb = normal_cb;
+    callbacks.texcoord_cb = texcoord_cb;
+    callbacks.index_cb = index_cb;
+
+    std::string warning, error;
+    bool success = tinyobj::LoadObjWithCallback(*source, callbacks, &state, NULL, &warning, &error);
+
+    flush_vertices(state);
+    flush_indices(state);
+
+    if (!success || state.failed || state.total_indices == 0) {
+        std::cout << "Failed to stream " << path << "\n" << error << std::endl;
+        return false;
+    }
+
+    size_t working_set = (state.positions.capacity() + state.normals.capacity() + state.texcoords.capacity()) * sizeof(tinyobj::real_t) +
+        state.slots.capacity() * sizeof(StreamSlot) +
+        state.vertex_chunk.capacity() * sizeof(GLfloat) + state.index_chunk.capacity() * sizeof(GLuint);
+    size_t vertex_count = state.slot_count;
+    size_t index_count = state.total_indices;
+
+    /* Release the pools and the weld table before the second pass */
+    state = StreamState();
+
+    bool written = (!has_normal_maps || write_with_tangents(*vertex_spool, index_spool, vertex_count, index_count, writer, working_set)) &&
+        copy_indices(index_spool, index_count, writer) &&
+        writer.finish();
+    if (!written) {
+        std::cout << "Could not write mesh cache for " << path << std::endl;
+        return false;
+    }
+
+    vertex_spool.reset();
+    if (!MeshCache::load(path, key, data.floats_per_vertex, data.cached_mesh)) {
+        return false;
+    }
+
+    data.stats.expanded_vertices = data.cached_mesh.index_count;
+    data.stats.unique_vertices = data.cached_mesh.float_count / data.floats_per_vertex;
+
+    std::cout << "Streamed " << path << " with a working set of " << working_set / (1024 * 1024) << " MB" << std::endl;
+
+    return true;
+}
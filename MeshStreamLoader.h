@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+#include "MeshCache.h"
+#include "MeshLoader.h"
+
+/*
+ * Loader for very large objs. Instead of building a full tinyobj attrib_t and shape_t index arrays,
+ * faces are streamed through tinyobj::LoadObjWithCallback and every triangle corner is welded on its
+ * obj index triple as it arrives. Welded vertices and indices leave in fixed size chunks, only the raw
+ * v/vn/vt pools and the weld table stay in memory. Normal mapped meshes spool both to disk and sum their
+ * tangents in a second pass over the chunks with a TangentAccumulator. Everything ends up in a mesh cache
+ * file that is then decoded like any other cache hit. Reordering and the LOD chain need the whole mesh at
+ * once, so streamed meshes are cached in the order they were welded, with a single level.
+ */
+class MeshStreamLoader {
+
+public:
+
+    /* Sources at least this large skip tinyobj::LoadObj */
+    static const uint64_t STREAMING_THRESHOLD_BYTES = 64ull * 1024 * 1024;
+
+    /* Vertices and indices are staged in chunks of this many entries before going to disk */
+    static const size_t CHUNK_VERTICES = 64 * 1024;
+
+    /* Writes the cache file of path and decodes it into data.cached_mesh */
+    static bool load(const char* path, const MeshSourceKey& key, bool has_normal_maps, MeshData& data);
+
+};
@@ -5,6 +5,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <vector>
 
 #include <string>
@@ -13,18 +14,11 @@
 #include <sstream>
 
 #include "Model3D.h"
+#include "MeshLoader.h"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
-
-std::vector<tinyobj::shape_t> shapes;
-std::vector<tinyobj::material_t> materials;
-std::string warning, error;
-tinyobj::attrib_t attributes;
-
-Model3D::Model3D(const char* path, float _x, float _y, float _z,
+Model3D::Model3D(std::shared_ptr<SharedMesh> mesh, float _x, float _y, float _z,
     float _rot_x, float _rot_y, float _rot_z,
-    float _scale_x, float _scale_y, float _scale_z, float _theta, bool has_normal_maps, float box_offset) {
+    float _scale_x, float _scale_y, float _scale_z, float _theta, float box_offset) {
     this->x = _x;
     this->y = _y;
     this->z = _z;
@@ -35,152 +29,13 @@ Model3D::Model3D(const char* path, float _x, float _y, float _z,
     this->scale_y = _scale_y;
     this->scale_z = _scale_z;
     this->theta = _theta;
-    this->has_normal_maps = has_normal_maps;
+    this->has_normal_maps = mesh->has_normal_maps;
     this->box_offset = box_offset;
+    this->mesh = std::move(mesh);
+    this->texture = 0;
+    this->texture_layer = 0;
 
     init_transformation_matrix();
-
-    /* Load the object using tinyobj */
-    bool success = tinyobj::LoadObj(
-        &attributes,
-        &shapes,
-        &materials,
-        &warning,
-        &error,
-        path);
- 
-    /* Initialize vertex data and indices depending on whether or not it will be normal mapped */
-    if (has_normal_maps == false) {
-        init_data_regular();
-    } else {
-        init_data_with_normal_maps();
-    }
-
-}
-
-void Model3D::init_data_regular() {
-    /* Iterate over the multiple shapes of obj */
-    for (int s = 0; s < shapes.size(); s++) {
-        for (int i = 0; i < shapes[s].mesh.indices.size(); i++) {
-            this->mesh_indices.push_back(shapes[s].mesh.indices[i].vertex_index);
-        }
-    }
-
-    /* Populate vertex data for main obj */
-    for (int s = 0; s < shapes.size(); s++) {
-        for (int i = 0; i < shapes[s].mesh.indices.size(); i++) {
-            tinyobj::index_t vData = shapes[s].mesh.indices[i];
-
-            // X Y Z //
-            this->fullVertexData.push_back(attributes.vertices[(vData.vertex_index * 3)]);
-            this->fullVertexData.push_back(attributes.vertices[(vData.vertex_index * 3) + 1]);
-            this->fullVertexData.push_back(attributes.vertices[(vData.vertex_index * 3) + 2]);
-
-            // Normals //
-            this->fullVertexData.push_back(attributes.normals[(vData.normal_index * 3)]);
-            this->fullVertexData.push_back(attributes.normals[(vData.normal_index * 3) + 1]);
-            this->fullVertexData.push_back(attributes.normals[(vData.normal_index * 3) + 2]);
-
-            // U V //
-            this->fullVertexData.push_back(attributes.texcoords[(vData.texcoord_index * 2)]);
-            this->fullVertexData.push_back(attributes.texcoords[(vData.texcoord_index * 2) + 1]);
-        }
-    }
-}
-
-void Model3D::init_data_with_normal_maps() {
-    for (int i = 0; i < shapes[0].mesh.indices.size(); i++) {
-        mesh_indices.push_back(shapes[0].mesh.indices[i].vertex_index);
-    }
-
-    std::vector<glm::vec3> tangents;
-    std::vector<glm::vec3> bitangents;
-
-    for (int i = 0; i < shapes[0].mesh.indices.size(); i += 3) {
-
-        tinyobj::index_t vData1 = shapes[0].mesh.indices[i];
-        tinyobj::index_t vData2 = shapes[0].mesh.indices[i + 1];
-        tinyobj::index_t vData3 = shapes[0].mesh.indices[i + 2];
-
-        glm::vec3 v1 = glm::vec3(
-            attributes.vertices[vData1.vertex_index * 3],
-            attributes.vertices[(vData1.vertex_index * 3) + 1],
-            attributes.vertices[(vData1.vertex_index * 3) + 2]);
-
-        glm::vec3 v2 = glm::vec3(
-            attributes.vertices[vData2.vertex_index * 3],
-            attributes.vertices[(vData2.vertex_index * 3) + 1],
-            attributes.vertices[(vData2.vertex_index * 3) + 2]);
-
-        glm::vec3 v3 = glm::vec3(
-            attributes.vertices[vData3.vertex_index * 3],
-            attributes.vertices[(vData3.vertex_index * 3) + 1],
-            attributes.vertices[(vData3.vertex_index * 3) + 2]);
-
-        glm::vec2 uv1 = glm::vec2(
-            attributes.texcoords[vData1.texcoord_index * 2],
-            attributes.texcoords[(vData1.texcoord_index * 2) + 1]
-        );
-
-        glm::vec2 uv2 = glm::vec2(
-            attributes.texcoords[vData2.texcoord_index * 2],
-            attributes.texcoords[(vData2.texcoord_index * 2) + 1]
-        );
-
-        glm::vec2 uv3 = glm::vec2(
-            attributes.texcoords[vData3.texcoord_index * 2],
-            attributes.texcoords[(vData3.texcoord_index * 2) + 1]
-        );
-
-        glm::vec3 deltaPos1 = v2 - v1;
-        glm::vec3 deltaPos2 = v3 - v1;
-
-        glm::vec2 deltaUV1 = uv2 - uv1;
-        glm::vec2 deltaUV2 = uv3 - uv1;
-
-float r = 1.0f / ((deltaUV1.x * deltaUV2.y) - (deltaUV1.y * deltaUV2.x));
-
-glm::vec3 tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
-glm::vec3 bitangent = (deltaPos2 * deltaUV1.x - deltaPos1 * deltaUV2.x) * r;
-
-tangents.push_back(tangent);
-tangents.push_back(tangent);
-tangents.push_back(tangent);
-
-bitangents.push_back(bitangent);
-bitangents.push_back(bitangent);
-bitangents.push_back(bitangent);
-
-    }
-
-    /* Populate vertex data */
-    std::vector<GLfloat> fullVertexData;
-    for (int i = 0; i < shapes[0].mesh.indices.size(); i++) {
-        tinyobj::index_t vData = shapes[0].mesh.indices[i];
-
-        /* X Y Z */
-        this->fullVertexData.push_back(attributes.vertices[(vData.vertex_index * 3)]);
-        this->fullVertexData.push_back(attributes.vertices[(vData.vertex_index * 3) + 1]);
-        this->fullVertexData.push_back(attributes.vertices[(vData.vertex_index * 3) + 2]);
-
-        /* Normals */
-        this->fullVertexData.push_back(attributes.normals[(vData.normal_index * 3)]);
-        this->fullVertexData.push_back(attributes.normals[(vData.normal_index * 3) + 1]);
-        this->fullVertexData.push_back(attributes.normals[(vData.normal_index * 3) + 2]);
-
-        /* U V */
-        this->fullVertexData.push_back(attributes.texcoords[(vData.texcoord_index * 2)]);
-        this->fullVertexData.push_back(attributes.texcoords[(vData.texcoord_index * 2) + 1]);
-
-        this->fullVertexData.push_back(tangents[i].x);
-        this->fullVertexData.push_back(tangents[i].y);
-        this->fullVertexData.push_back(tangents[i].z);
-
-        this->fullVertexData.push_back(bitangents[i].x);
-        this->fullVertexData.push_back(bitangents[i].y);
-        this->fullVertexData.push_back(bitangents[i].z);
-
-    }
 }
 
 void Model3D::init_transformation_matrix() {
@@ -197,6 +52,63 @@ void Model3D::init_transformation_matrix() {
         glm::normalize(glm::vec3(this->rot_x, this->rot_y, this->rot_z)));
 }
 
+bool Model3D::is_ready() {
+    return this->mesh->ready;
+}
+
+unsigned int Model3D::get_index_count() {
+    return this->mesh->get_index_count();
+}
+
+/*
+ * Picks the coarsest level whose error still covers less than a pixel on screen, lod_bias scales that pixel.
+ * The error is projected at the depth of the bounding sphere center, orthographic projections ignore the depth
+ */
+unsigned int Model3D::select_lod(const glm::mat4& view, const glm::mat4& projection, float screen_height, float lod_bias) {
+    const std::vector<MeshLod>& lods = this->mesh->lods;
+    glm::vec4 center = view * this->transformation_matrix * glm::vec4(this->mesh->bounds_center, 1.0f);
+    float world_scale = std::max(glm::length(glm::vec3(this->transformation_matrix[0])),
+        std::max(glm::length(glm::vec3(this->transformation_matrix[1])), glm::length(glm::vec3(this->transformation_matrix[2]))));
+    float world_radius = this->mesh->bounds_radius * world_scale;
+
+    float pixels_per_unit = projection[1][1] * screen_height * 0.5f;
+    bool perspective = projection[2][3] != 0.0f;
+    if (perspective) {
+        float depth = -center.z;
+        if (depth <= world_radius) {
+            return 0;
+        }
+        pixels_per_unit /= depth;
+    }
+
+    unsigned int lod = 0;
+    for (unsigned int l = 1; l < lods.size(); l++) {
+        if (lods[l].error * world_radius * pixels_per_unit > lod_bias) {
+            break;
+        }
+        lod = l;
+    }
+    return lod;
+}
+
+float Model3D::screen_size(const glm::vec3& camera_position, const glm::mat4& projection, float screen_height) {
+    glm::vec3 center = glm::vec3(this->transformation_matrix * glm::vec4(this->mesh->bounds_center, 1.0f));
+    float world_scale = std::max(glm::length(glm::vec3(this->transformation_matrix[0])),
+        std::max(glm::length(glm::vec3(this->transformation_matrix[1])), glm::length(glm::vec3(this->transformation_matrix[2]))));
+    float world_radius = this->mesh->bounds_radius * world_scale;
+
+    float pixels = 2.0f * world_radius * projection[1][1] * screen_height * 0.5f;
+    bool perspective = projection[2][3] != 0.0f;
+    if (perspective) {
+        float distance = glm::length(center - camera_position);
+        if (distance <= world_radius) {
+            return screen_height;
+        }
+        pixels /= distance;
+    }
+    return pixels;
+}
+
 void Model3D::rotate_on_axis(float rotateAngle, glm::vec3 rotateAxis) {
     this->transformation_matrix = glm::rotate(this->transformation_matrix,
         rotateAngle,
@@ -228,7 +140,7 @@ void Model3D::move(glm::vec3 movePos) {
 }
 
 /* Function for moving with collision checking */
-void Model3D::move(glm::vec3 movePos, std::vector<Model3D> modelList) {
+void Model3D::move(glm::vec3 movePos, const std::vector<Model3D>& modelList) {
 
     glm::mat4 matrix_after_move = glm::translate(this->transformation_matrix, movePos);
 
@@ -276,62 +188,17 @@ bool Model3D::checkCollision(glm::mat4 myPosition, glm::mat4 possibleCollisionPo
     return has_collided;
 }
 
-/* Initialize buffers for obj with position, normals, and texture */
-void Model3D::init_buffers(unsigned int VAO, unsigned int VBO) {
-    /* Bind VBO */
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER,
-        sizeof(GL_FLOAT) * this->fullVertexData.size(),
-        this->fullVertexData.data(),
-        GL_STATIC_DRAW);
-
-    /* Position */
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GL_FLOAT), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    /* Normals */
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GL_FLOAT), (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-
-    /* Texture */
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GL_FLOAT), (void*)(6 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(2);
-}
-
-/* Initialize buffers for obj with position, normals, and texture, tangents, bitangents */
-void Model3D::init_buffers_with_normals(unsigned int VAO, unsigned int VBO) {
-    /* Bind VBO */
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER,
-        sizeof(GL_FLOAT) * this->fullVertexData.size(),
-        this->fullVertexData.data(),
-        GL_STATIC_DRAW);
-
-    /* Position */
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(GL_FLOAT), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    /* Normals */
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(GL_FLOAT), (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-
-    /* Texture */
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 14 * sizeof(GL_FLOAT), (void*)(6 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(2);
-
-    /* Tangents */
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(GL_FLOAT), (void*)(8 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(3);
-
-    /* Bitangents */
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(GL_FLOAT), (void*)(11 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(4);
+/* Per mesh uniforms the vertex shaders need to decode the packed layout, call before draw with the shader in use */
+void Model3D::apply_vertex_layout(unsigned int shaderID) {
+    this->mesh->apply_vertex_layout(shaderID);
 }
 
-/* Pass in the uniform location for transformation as a parameter */
-void Model3D::draw(unsigned int transformationLoc, unsigned int startIndex, unsigned int size, unsigned int VAO) {
+/* Pass in the uniform location for transformation as a parameter, lod picks the index range drawn */
+void Model3D::draw(unsigned int transformationLoc, unsigned int lod) {
+    const MeshLod& range = this->mesh->lods[lod];
     glUniformMatrix4fv(transformationLoc, 1, GL_FALSE, glm::value_ptr(this->transformation_matrix));
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, startIndex, size);
+    glBindVertexArray(this->mesh->VAO);
+    GLenum index_type = this->mesh->index_type;
+    glDrawElements(GL_TRIANGLES, range.index_count, index_type, (void*)(range.first_index * MeshCache::index_type_size(index_type)));
     glBindVertexArray(0);
 }
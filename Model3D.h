@@ -7,6 +7,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <memory>
 #include <vector>
 
 #include <string>
@@ -14,6 +15,9 @@
 #include <fstream>
 #include <sstream>
 
+#include "MeshLoader.h"
+#include "SharedMesh.h"
+
 class Model3D {
 
 public:
@@ -26,19 +30,36 @@ public:
     float box_offset;
 
     glm::mat4 transformation_matrix;
-    std::vector<GLuint> mesh_indices;
-    std::vector<GLfloat> fullVertexData;
+    std::shared_ptr<SharedMesh> mesh; // shared with every other model drawing the same obj
+    GLuint texture; // material, a GL_TEXTURE_2D_ARRAY bound to unit 0 before draw
+    int texture_layer; // layer of texture holding this model's material
 
-    Model3D(const char* path, float x, float y, float z,
+    /* Another instance of a mesh from MeshRegistry, it may still be loading */
+    Model3D(std::shared_ptr<SharedMesh> mesh, float x, float y, float z,
         float rot_x, float rot_y, float rot_z,
-        float scale_x, float scale_y, float scale_z, float theta, bool has_normal_maps, float box_offset);
+        float scale_x, float scale_y, float scale_z, float theta, float box_offset);
+
+    /* Models are only moved around, copies would all hold on to the mesh */
+    Model3D(const Model3D&) = delete;
 
-    void init_data_regular();
+    Model3D& operator=(const Model3D&) = delete;
 
-    void init_data_with_normal_maps();
+    Model3D(Model3D&&) = default;
+
+    Model3D& operator=(Model3D&&) = default;
 
     void init_transformation_matrix();
 
+    /* True once the mesh has been uploaded */
+    bool is_ready();
+
+    unsigned int get_index_count();
+
+    unsigned int select_lod(const glm::mat4& view, const glm::mat4& projection, float screen_height, float lod_bias);
+
+    /* Pixels the model's bounding sphere spans across the screen, seen from camera_position */
+    float screen_size(const glm::vec3& camera_position, const glm::mat4& projection, float screen_height);
+
     void rotate_on_axis(float rotateAngle, glm::vec3 rotateAxis);
 
     void transMatrix();
@@ -47,7 +68,7 @@ public:
 
     void move(glm::vec3 movePos);
 
-    void move(glm::vec3 movePos, std::vector<Model3D> modelList);
+    void move(glm::vec3 movePos, const std::vector<Model3D>& modelList);
 
     void scale(glm::vec3 scaleModel);
 
@@ -55,10 +76,8 @@ public:
 
     bool checkCollision(glm::mat4 myPosition, glm::mat4 possibleCollisionPosition, float offset);
 
-    void init_buffers(unsigned int VAO, unsigned int VBO);
-
-    void init_buffers_with_normals(unsigned int VAO, unsigned int VBO);
+    void apply_vertex_layout(unsigned int shaderID);
 
-    void draw(unsigned int transformationLoc, unsigned int startIndex, unsigned int size, unsigned int VAO);
+    void draw(unsigned int transformationLoc, unsigned int lod);
 
 };
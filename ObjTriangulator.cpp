@@ -0,0 +1,187 @@
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "ObjTriangulator.h"
+
+/* Point in polygon test, same as the one inside tinyobj */
+static bool pnpoly(int nvert, const tinyobj::real_t* vertx, const tinyobj::real_t* verty, tinyobj::real_t testx, tinyobj::real_t testy) {
+    bool inside = false;
+    for (int i = 0, j = nvert - 1; i < nvert; j = i++) {
+        if (((verty[i] > testy) != (verty[j] > testy)) &&
+            (testx < (vertx[j] - vertx[i]) * (testy - verty[i]) / (verty[j] - verty[i]) + vertx[i])) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+bool ObjTriangulator::triangulate(const tinyobj::index_t* face, size_t corner_count,
+    const tinyobj::real_t* positions, size_t position_count, std::vector<tinyobj::index_t>& triangles) {
+    const tinyobj::real_t* v = positions;
+    const size_t v_size = position_count;
+
+    /* Face must have 3+ vertices */
+    if (corner_count < 3) {
+        return false;
+    }
+
+    if (corner_count == 3) {
+        triangles.insert(triangles.end(), face, face + 3);
+        return true;
+    }
+
+    if (corner_count == 4) {
+        size_t vi0 = size_t(face[0].vertex_index);
+        size_t vi1 = size_t(face[1].vertex_index);
+        size_t vi2 = size_t(face[2].vertex_index);
+        size_t vi3 = size_t(face[3].vertex_index);
+
+        if (((3 * vi0 + 2) >= v_size) || ((3 * vi1 + 2) >= v_size) ||
+            ((3 * vi2 + 2) >= v_size) || ((3 * vi3 + 2) >= v_size)) {
+            return false;
+        }
+
+        /* Cut along the shorter diagonal */
+        tinyobj::real_t e02x = v[vi2 * 3 + 0] - v[vi0 * 3 + 0];
+        tinyobj::real_t e02y = v[vi2 * 3 + 1] - v[vi0 * 3 + 1];
+        tinyobj::real_t e02z = v[vi2 * 3 + 2] - v[vi0 * 3 + 2];
+        tinyobj::real_t e13x = v[vi3 * 3 + 0] - v[vi1 * 3 + 0];
+        tinyobj::real_t e13y = v[vi3 * 3 + 1] - v[vi1 * 3 + 1];
+        tinyobj::real_t e13z = v[vi3 * 3 + 2] - v[vi1 * 3 + 2];
+
+        tinyobj::real_t sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+        tinyobj::real_t sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+
+        if (sqr02 < sqr13) {
+            // [0, 1, 2], [0, 2, 3]
+            tinyobj::index_t quad[6] = { face[0], face[1], face[2], face[0], face[2], face[3] };
+            triangles.insert(triangles.end(), quad, quad + 6);
+        } else {
+            // [0, 1, 3], [1, 2, 3]
+            tinyobj::index_t quad[6] = { face[0], face[1], face[3], face[1], face[2], face[3] };
+            triangles.insert(triangles.end(), quad, quad + 6);
+        }
+        return true;
+    }
+
+    /* Find the two axes to project the polygon onto */
+    size_t npolys = corner_count;
+    size_t axes[2] = { 1, 2 };
+    for (size_t k = 0; k < npolys; ++k) {
+        size_t vi0 = size_t(face[(k + 0) % npolys].vertex_index);
+        size_t vi1 = size_t(face[(k + 1) % npolys].vertex_index);
+        size_t vi2 = size_t(face[(k + 2) % npolys].vertex_index);
+
+        if (((3 * vi0 + 2) >= v_size) || ((3 * vi1 + 2) >= v_size) ||
+            ((3 * vi2 + 2) >= v_size)) {
+            continue;
+        }
+
+        tinyobj::real_t e0x = v[vi1 * 3 + 0] - v[vi0 * 3 + 0];
+        tinyobj::real_t e0y = v[vi1 * 3 + 1] - v[vi0 * 3 + 1];
+        tinyobj::real_t e0z = v[vi1 * 3 + 2] - v[vi0 * 3 + 2];
+        tinyobj::real_t e1x = v[vi2 * 3 + 0] - v[vi1 * 3 + 0];
+        tinyobj::real_t e1y = v[vi2 * 3 + 1] - v[vi1 * 3 + 1];
+        tinyobj::real_t e1z = v[vi2 * 3 + 2] - v[vi1 * 3 + 2];
+        tinyobj::real_t cx = std::fabs(e0y * e1z - e0z * e1y);
+        tinyobj::real_t cy = std::fabs(e0z * e1x - e0x * e1z);
+        tinyobj::real_t cz = std::fabs(e0x * e1y - e0y * e1x);
+        const tinyobj::real_t epsilon = std::numeric_limits<tinyobj::real_t>::epsilon();
+
+        if (cx > epsilon || cy > epsilon || cz > epsilon) {
+            /* Found a corner */
+            if (!(cx > cy && cx > cz)) {
+                axes[0] = 0;
+                if (cz > cx && cz > cy) {
+                    axes[1] = 1;
+                }
+            }
+            break;
+        }
+    }
+
+    /* Ear clipping */
+    std::vector<tinyobj::index_t> remaining(face, face + corner_count);
+    size_t guess_vert = 0;
+    tinyobj::index_t ind[3];
+    tinyobj::real_t vx[3];
+    tinyobj::real_t vy[3];
+
+    size_t remaining_iterations = remaining.size();
+    size_t previous_remaining_vertices = remaining.size();
+
+    while (remaining.size() > 3 && remaining_iterations > 0) {
+        npolys = remaining.size();
+        if (guess_vert >= npolys) {
+            guess_vert -= npolys;
+        }
+
+        if (previous_remaining_vertices != npolys) {
+            /* The number of remaining vertices decreased, reset counters */
+            previous_remaining_vertices = npolys;
+            remaining_iterations = npolys;
+        } else {
+            /* We did not consume a vertex on the previous iteration */
+            remaining_iterations--;
+        }
+
+        for (size_t k = 0; k < 3; k++) {
+            ind[k] = remaining[(guess_vert + k) % npolys];
+            size_t vi = size_t(ind[k].vertex_index);
+            if (((vi * 3 + axes[0]) >= v_size) || ((vi * 3 + axes[1]) >= v_size)) {
+                vx[k] = static_cast<tinyobj::real_t>(0.0);
+                vy[k] = static_cast<tinyobj::real_t>(0.0);
+            } else {
+                vx[k] = v[vi * 3 + axes[0]];
+                vy[k] = v[vi * 3 + axes[1]];
+            }
+        }
+
+        tinyobj::real_t e0x = vx[1] - vx[0];
+        tinyobj::real_t e0y = vy[1] - vy[0];
+        tinyobj::real_t e1x = vx[2] - vx[1];
+        tinyobj::real_t e1y = vy[2] - vy[1];
+        tinyobj::real_t cross = e0x * e1y - e0y * e1x;
+        tinyobj::real_t area = (vx[0] * vy[1] - vy[0] * vx[1]) * static_cast<tinyobj::real_t>(0.5);
+
+        /* Internal angle, try the next corner */
+        if (cross * area < static_cast<tinyobj::real_t>(0.0)) {
+            guess_vert += 1;
+            continue;
+        }
+
+        /* Check all other verts in case they are inside this triangle */
+        bool overlap = false;
+        for (size_t other_vert = 3; other_vert < npolys; ++other_vert) {
+            size_t idx = (guess_vert + other_vert) % npolys;
+            size_t ovi = size_t(remaining[idx].vertex_index);
+
+            if (((ovi * 3 + axes[0]) >= v_size) || ((ovi * 3 + axes[1]) >= v_size)) {
+                continue;
+            }
+
+            if (pnpoly(3, vx, vy, v[ovi * 3 + axes[0]], v[ovi * 3 + axes[1]])) {
+                overlap = true;
+                break;
+            }
+        }
+
+        if (overlap) {
+            guess_vert += 1;
+            continue;
+        }
+
+        /* This triangle is an ear */
+        triangles.insert(triangles.end(), ind, ind + 3);
+
+        /* Remove v1 from the list */
+        remaining.erase(remaining.begin() + (guess_vert + 1) % npolys);
+    }
+
+    if (remaining.size() == 3) {
+        triangles.insert(triangles.end(), remaining.begin(), remaining.end());
+    }
+
+    return true;
+}
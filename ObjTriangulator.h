@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+#include "tiny_obj_loader.h"
+
+/*
+ * Splits obj polygons into triangles with the same rules as tinyobj::LoadObj(triangulate = true):
+ * quads are cut along their shorter diagonal and larger polygons are ear clipped.
+ * Used by the loaders that do not go through LoadObj so their output matches it.
+ */
+class ObjTriangulator {
+
+public:
+
+    /*
+     * Face indices must already be 0 based. Only the first position_count floats of positions are visible,
+     * like the vertices tinyobj had read when it exported the face.
+     * Appends 3 indices per triangle, returns false if the face was dropped
+     */
+    static bool triangulate(const tinyobj::index_t* face, size_t corner_count,
+        const tinyobj::real_t* positions, size_t position_count, std::vector<tinyobj::index_t>& triangles);
+
+};
@@ -13,8 +13,8 @@ class Player : public Model3D {
 
 public:
 
-    Player(const char* path, float x, float y, float z,
+    Player(std::shared_ptr<SharedMesh> mesh, float x, float y, float z,
         float rot_x, float rot_y, float rot_z,
-        float scale_x, float scale_y, float scale_z, float theta, bool has_normal_maps, float box_offset);
+        float scale_x, float scale_y, float scale_z, float theta, float box_offset);
 
 };
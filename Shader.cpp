@@ -10,25 +10,22 @@
 #include <fstream>
 #include <sstream>
 
+#include "AssetArchive.h"
 #include "Shader.h"
 
 Shader::Shader(const char* vertexShaderPath, const char* fragmentShaderPath) {
 
-    std::fstream vertSrc(vertexShaderPath);
-    std::stringstream vertBuff;
-    vertBuff << vertSrc.rdbuf();
-    std::string vertString = vertBuff.str();
-    const char* v = vertString.c_str();
-
-    std::fstream fragSrc(fragmentShaderPath);
-    std::stringstream fragBuff;
-    fragBuff << fragSrc.rdbuf();
-    std::string fragString = fragBuff.str();
-    const char* f = fragString.c_str();
+    /* Packed shaders are handed to GL straight from the archive, loose ones are read from disk */
+    std::string vertString, fragString;
+    const char* v;
+    const char* f;
+    GLint vLength, fLength;
+    readSource(vertexShaderPath, vertString, v, vLength);
+    readSource(fragmentShaderPath, fragString, f, fLength);
 
     /* Compile Vertex Shader */
     GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &v, NULL);
+    glShaderSource(vertexShader, 1, &v, &vLength);
     glCompileShader(vertexShader);
 
     /* Check if vertex shader compiled successfully */
@@ -36,7 +33,7 @@ Shader::Shader(const char* vertexShaderPath, const char* fragmentShaderPath) {
 
     /* Compile Fragment Shader */
     GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &f, NULL);
+    glShaderSource(fragmentShader, 1, &f, &fLength);
     glCompileShader(fragmentShader);
 
     /* Check if fragment shader compiled successfully */
@@ -50,6 +47,22 @@ Shader::Shader(const char* vertexShaderPath, const char* fragmentShaderPath) {
 
 }
 
+void Shader::readSource(const char* path, std::string& storage, const char*& source, GLint& length) {
+    AssetBlob blob;
+    if (AssetArchive::find(path, blob)) {
+        source = (const char*)blob.data;
+        length = (GLint)blob.size;
+        return;
+    }
+
+    std::fstream src(path);
+    std::stringstream buff;
+    buff << src.rdbuf();
+    storage = buff.str();
+    source = storage.c_str();
+    length = (GLint)storage.size();
+}
+
 void Shader::useShaderProgram() {
     glUseProgram(this->shaderProgramID);
 }
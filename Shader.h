@@ -7,12 +7,17 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <string>
+
 class Shader {
 
 private:
 
     GLuint shaderProgramID;
 
+    /* Points source at the shader text, storage holds it when it had to be read from disk */
+    static void readSource(const char* path, std::string& storage, const char*& source, GLint& length);
+
 public:
 
     Shader(const char* vertexShaderPath, const char* fragmentShaderPath);
@@ -32,9 +32,12 @@ uniform float dirspecPhong;
 
 uniform vec3 ourColor;
 
-uniform sampler2D tex0;
+uniform sampler2DArray tex0;
+uniform int layer; // of tex0 holding this model's material
+uniform float minLod; // finest level of layer that has streamed in, from tex0's base level
 
 vec3 CalcDirLight(vec3 normal, vec3 viewDir);
+vec4 SampleMaterial();
 vec3 CalcPointLight(vec3 normal, vec3 fragPos, vec3 viewDir);
 
 void main()
@@ -45,7 +48,7 @@ void main()
     vec3 result = CalcDirLight(normal, viewDir);
     result += CalcPointLight(normal, fragPos, viewDir);
 	
-	FragColor = vec4(result, 1.0f) * texture(tex0, texCoord);
+	FragColor = vec4(result, 1.0f) * SampleMaterial();
 
     if (firstPerson){
         FragColor.r = 0.0f;
@@ -99,4 +102,15 @@ vec3 CalcPointLight(vec3 normal, vec3 fragPos, vec3 viewDir)
     specCol *= attenuation;
 
     return (specCol + diffuse + ambientCol) * ourColor;
+}
+
+// the level texture() would pick, never finer than the one streamed in for this layer
+vec4 SampleMaterial()
+{
+    vec2 texel = texCoord * vec2(textureSize(tex0, 0).xy);
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5f * log2(max(dot(dx, dx), dot(dy, dy)));
+
+    return textureLod(tex0, vec3(texCoord, layer), max(lod, minLod));
 }
\ No newline at end of file
@@ -12,9 +12,14 @@ uniform mat4 transform;
 uniform mat4 projection;
 uniform mat4 view;
 
+// mesh bounds for 16 bit positions, zero and one when positions are floats
+uniform vec3 positionMin;
+uniform vec3 positionExtent;
+
 void main() {
-	gl_Position = projection * view * transform * vec4(aPos, 1.0); 
+	vec3 position = positionMin + aPos * positionExtent;
+	gl_Position = projection * view * transform * vec4(position, 1.0); 
 	texCoord = aTex;
 	normCoord = mat3(transpose(inverse(transform))) * vertexNormal;
-	fragPos = vec3(transform * vec4(aPos, 1.0)); 
+	fragPos = vec3(transform * vec4(position, 1.0)); 
 }
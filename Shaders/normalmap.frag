@@ -31,18 +31,22 @@ uniform float dirspecPhong;
 
 uniform vec3 ourColor;
 
-uniform sampler2D tex0;
+uniform sampler2DArray tex0;
+uniform int layer; // of tex0 holding this model's material
+uniform float minLod; // finest level of layer that has streamed in, from tex0's base level
 uniform sampler2D norm_tex;
 
 uniform bool firstPerson;
 
 vec3 CalcDirLight(vec3 normal, vec3 viewDir);
+vec4 SampleMaterial();
 vec3 CalcPointLight(vec3 normal, vec3 fragPos, vec3 viewDir);
 
 void main()
 {
-	vec3 normal = texture(norm_tex, texCoord).rgb;
-	normal = normalize(normal * 2.0 - 1.0);
+	// only red and green are stored (BC5 or RG8), z is rebuilt from the unit length
+	vec2 normalXY = texture(norm_tex, texCoord).rg * 2.0 - 1.0;
+	vec3 normal = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
 	normal = normalize(TBN * normal);
 	//vec3 normal = normalize(normCoord);
     vec3 viewDir = normalize(cameraPos - fragPos);
@@ -50,7 +54,7 @@ void main()
     vec3 result = CalcDirLight(normal, viewDir);
     result += CalcPointLight(normal, fragPos, viewDir);
 	
-    FragColor = vec4(result, 1.0f) * (texture(tex0, texCoord));
+    FragColor = vec4(result, 1.0f) * SampleMaterial();
 
     if (firstPerson){
         FragColor.r = 0.0f;
@@ -105,4 +109,15 @@ vec3 CalcPointLight(vec3 normal, vec3 fragPos, vec3 viewDir)
 
     return (specCol + diffuse + ambientCol) * ourColor;
 }
- 
\ No newline at end of file
+ 
+
+// the level texture() would pick, never finer than the one streamed in for this layer
+vec4 SampleMaterial()
+{
+    vec2 texel = texCoord * vec2(textureSize(tex0, 0).xy);
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5f * log2(max(dot(dx, dx), dot(dy, dy)));
+
+    return textureLod(tex0, vec3(texCoord, layer), max(lod, minLod));
+}
\ No newline at end of file
@@ -3,7 +3,7 @@
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 vertexNormal;
 layout(location = 2) in vec2 aTex;
-layout(location = 3) in vec3 m_tan;
+layout(location = 3) in vec4 m_tan; // w holds the bitangent sign when packed
 layout(location = 4) in vec3 m_btan;
 
 out vec2 texCoord;
@@ -16,17 +16,27 @@ uniform mat4 transform;
 uniform mat4 projection;
 uniform mat4 view;
 
+// mesh bounds for 16 bit positions, zero and one when positions are floats
+uniform vec3 positionMin;
+uniform vec3 positionExtent;
+
+// bitangents are not stored in the packed layouts and are rebuilt from the tangent sign
+uniform bool packedTangents;
+
 void main() {
-	gl_Position = projection * view * transform * vec4(aPos, 1.0); 
+	vec3 position = positionMin + aPos * positionExtent;
+	gl_Position = projection * view * transform * vec4(position, 1.0); 
 	texCoord = aTex;
 
 	mat3 modelMat = mat3(transpose(inverse(transform)));
 	normCoord = modelMat * vertexNormal;
 
-	vec3 T = normalize(modelMat * m_tan);
-	vec3 B = normalize(modelMat * m_btan);
+	vec3 bitangent = packedTangents ? cross(vertexNormal, m_tan.xyz) * sign(m_tan.w) : m_btan;
+
+	vec3 T = normalize(modelMat * m_tan.xyz);
+	vec3 B = normalize(modelMat * bitangent);
 	vec3 N = normalize(normCoord);
 	TBN = mat3(T, B, N);
 
-	fragPos = vec3(transform * vec4(aPos, 1.0)); 
+	fragPos = vec3(transform * vec4(position, 1.0)); 
 }
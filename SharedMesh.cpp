@@ -0,0 +1,205 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "SharedMesh.h"
+#include "MeshSimplifier.h"
+
+SharedMesh::SharedMesh(const std::string& path, bool has_normal_maps) {
+    this->path = path;
+    this->has_normal_maps = has_normal_maps;
+    this->ready = false;
+    this->keep_cpu_data = false;
+
+    this->cached_mesh.vertices = nullptr;
+    this->cached_mesh.float_count = 0;
+    this->cached_mesh.indices = nullptr;
+    this->cached_mesh.index_count = 0;
+    this->cached_mesh.index_type = GL_UNSIGNED_INT;
+    this->cached_mesh.file_bytes = 0;
+    this->cached_mesh.decode_ms = 0.0;
+    this->lods.push_back({ 0, 0, 0.0f });
+    this->bounds_center = glm::vec3(0.0f);
+    this->bounds_radius = 0.0f;
+
+    this->vertex_format = VERTEX_FORMAT_COMPACT_POSITIONS;
+    this->vertex_layout = VertexPacker::float_layout(has_normal_maps);
+    this->vertex_stats = VertexPackStats();
+    this->vertex_stats.name = path;
+    this->load_stats = MeshLoadStats();
+    this->load_stats.path = path;
+
+    this->VAO = 0;
+    this->VBO = 0;
+    this->EBO = 0;
+    this->index_type = GL_UNSIGNED_INT;
+    this->gpu_bytes = 0;
+    this->cpu_bytes_at_upload = 0;
+}
+
+/* Meshes still referenced when the window is gone go down with the context instead */
+SharedMesh::~SharedMesh() {
+    if (this->VAO != 0 && glfwGetCurrentContext() != nullptr) {
+        glDeleteVertexArrays(1, &this->VAO);
+        glDeleteBuffers(1, &this->VBO);
+        glDeleteBuffers(1, &this->EBO);
+    }
+}
+
+void SharedMesh::set_mesh(MeshData&& mesh) {
+    this->mesh_indices = std::move(mesh.mesh_indices);
+    this->fullVertexData = std::move(mesh.fullVertexData);
+    this->cached_mesh = std::move(mesh.cached_mesh);
+    this->load_stats = mesh.stats;
+    this->lods = std::move(mesh.lods);
+    if (this->lods.empty()) {
+        this->lods.push_back({ 0, (uint32_t)this->mesh_indices.size(), 0.0f });
+    }
+
+    MeshSimplifier::bounding_sphere(get_vertex_data(), get_vertex_count(), get_floats_per_vertex(),
+        this->bounds_center, this->bounds_radius);
+}
+
+/* Position, normal, uv, plus tangents and bitangents when normal mapped */
+unsigned int SharedMesh::get_floats_per_vertex() {
+    return VertexLayouts::floats_per_vertex(this->has_normal_maps);
+}
+
+const GLfloat* SharedMesh::get_vertex_data() {
+    if (this->cached_mesh.vertices != nullptr) {
+        return this->cached_mesh.vertices;
+    }
+    return this->fullVertexData.data();
+}
+
+size_t SharedMesh::get_vertex_float_count() {
+    if (this->cached_mesh.vertices != nullptr) {
+        return this->cached_mesh.float_count;
+    }
+    return this->fullVertexData.size();
+}
+
+unsigned int SharedMesh::get_vertex_count() {
+    return (unsigned int)(get_vertex_float_count() / get_floats_per_vertex());
+}
+
+/* Indices of the full detail mesh, the lower levels follow them in the same buffer */
+unsigned int SharedMesh::get_index_count() {
+    return this->lods[0].index_count;
+}
+
+GLenum SharedMesh::get_index_type() {
+    return MeshCache::pick_index_type(get_vertex_count());
+}
+
+void SharedMesh::upload() {
+    if (this->VAO == 0) {
+        glGenVertexArrays(1, &this->VAO);
+        glGenBuffers(1, &this->VBO);
+        glGenBuffers(1, &this->EBO);
+    }
+
+    glBindVertexArray(this->VAO);
+    this->index_type = get_index_type();
+    this->gpu_bytes = 0;
+
+    /* Bind VBO */
+    init_vertex_buffer();
+
+    /* Bind EBO, the binding is recorded in the VAO */
+    init_index_buffer();
+
+    /* Position, normals, texture, and tangents and bitangents or their sign when normal mapped */
+    VertexPacker::bind_attributes(this->vertex_layout);
+
+    glBindVertexArray(0);
+    this->ready = true;
+
+    this->cpu_bytes_at_upload = cpu_bytes();
+    if (!this->keep_cpu_data) {
+        release_cpu_data();
+    }
+}
+
+void SharedMesh::release_cpu_data() {
+    std::vector<GLuint>().swap(this->mesh_indices);
+    std::vector<GLfloat>().swap(this->fullVertexData);
+
+    std::vector<unsigned char>().swap(this->cached_mesh.storage);
+    this->cached_mesh.vertices = nullptr;
+    this->cached_mesh.float_count = 0;
+    this->cached_mesh.indices = nullptr;
+    this->cached_mesh.index_count = 0;
+}
+
+size_t SharedMesh::cpu_bytes() {
+    size_t bytes = this->mesh_indices.capacity() * sizeof(GLuint) + this->fullVertexData.capacity() * sizeof(GLfloat);
+    return bytes + this->cached_mesh.storage.capacity();
+}
+
+/* Upload the triangle list, packed to 16 bits when the vertex count allows it */
+void SharedMesh::init_index_buffer() {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+
+    if (this->cached_mesh.vertices != nullptr) {
+        size_t size = MeshCache::index_type_size(this->cached_mesh.index_type) * this->cached_mesh.index_count;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+            size,
+            this->cached_mesh.indices,
+            GL_STATIC_DRAW);
+        this->gpu_bytes += size;
+    } else if (this->index_type == GL_UNSIGNED_SHORT) {
+        std::vector<GLushort> short_indices(this->mesh_indices.begin(), this->mesh_indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+            sizeof(GLushort) * short_indices.size(),
+            short_indices.data(),
+            GL_STATIC_DRAW);
+        this->gpu_bytes += sizeof(GLushort) * short_indices.size();
+    } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+            sizeof(GLuint) * this->mesh_indices.size(),
+            this->mesh_indices.data(),
+            GL_STATIC_DRAW);
+        this->gpu_bytes += sizeof(GLuint) * this->mesh_indices.size();
+    }
+}
+
+/* Pack and upload the vertices in vertex_format, keeping the float layout if packing changes them visibly */
+void SharedMesh::init_vertex_buffer() {
+    std::vector<unsigned char> packed;
+    VertexLayout layout = VertexPacker::pack(get_vertex_data(), get_vertex_count(), this->has_normal_maps, this->vertex_format, packed);
+
+    this->vertex_stats.vertex_count = get_vertex_count();
+    this->vertex_stats.error = VertexPacker::measure_error(get_vertex_data(), get_vertex_count(), layout, packed.data());
+    this->vertex_stats.fell_back = !VertexPacker::within_tolerance(this->vertex_stats.error);
+    if (this->vertex_stats.fell_back) {
+        layout = VertexPacker::float_layout(this->has_normal_maps);
+        packed.clear();
+    }
+    this->vertex_layout = layout;
+    this->vertex_stats.layout = layout;
+
+    glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+    if (layout.format == VERTEX_FORMAT_FLOAT) {
+        glBufferData(GL_ARRAY_BUFFER,
+            sizeof(GL_FLOAT) * get_vertex_float_count(),
+            get_vertex_data(),
+            GL_STATIC_DRAW);
+        this->gpu_bytes += sizeof(GL_FLOAT) * get_vertex_float_count();
+    } else {
+        glBufferData(GL_ARRAY_BUFFER,
+            packed.size(),
+            packed.data(),
+            GL_STATIC_DRAW);
+        this->gpu_bytes += packed.size();
+    }
+}
+
+/* Per mesh uniforms the vertex shaders need to decode the packed layout, call before drawing with the shader in use */
+void SharedMesh::apply_vertex_layout(unsigned int shaderID) {
+    VertexPacker::apply_uniforms(this->vertex_layout, shaderID);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "MeshCache.h"
+#include "MeshLoader.h"
+#include "VertexPacker.h"
+
+/*
+ * One loaded obj and the GPU buffers it was uploaded into. Every Model3D drawing the same obj points at
+ * the same SharedMesh through a shared_ptr, the buffers are deleted with the last of them.
+ */
+class SharedMesh {
+
+public:
+
+    std::string path;
+    bool has_normal_maps;
+    bool ready; // uploaded, models can draw it
+    bool keep_cpu_data; // keep the vertices and indices after upload, only for collision or picking against the triangles
+
+    std::vector<GLuint> mesh_indices; // triangle list into fullVertexData
+    std::vector<GLfloat> fullVertexData; // unique interleaved vertices
+    MeshCacheEntry cached_mesh; // vertex and index data decoded from Cache/, used instead of the vectors when valid
+    std::vector<MeshLod> lods; // index ranges of every level of detail, the full mesh first
+    glm::vec3 bounds_center; // object space bounding sphere the LOD errors are relative to
+    float bounds_radius;
+
+    VertexFormat vertex_format; // requested GPU layout, set before upload
+    VertexLayout vertex_layout; // layout actually uploaded
+    VertexPackStats vertex_stats;
+    MeshLoadStats load_stats;
+
+    GLuint VAO, VBO, EBO;
+    GLenum index_type; // picked at upload, the data it was picked from may be released after
+    size_t gpu_bytes; // vertex and index buffer sizes
+    size_t cpu_bytes_at_upload;
+
+    SharedMesh(const std::string& path, bool has_normal_maps);
+
+    ~SharedMesh();
+
+    SharedMesh(const SharedMesh&) = delete;
+
+    SharedMesh& operator=(const SharedMesh&) = delete;
+
+    void set_mesh(MeshData&& mesh);
+
+    unsigned int get_floats_per_vertex();
+
+    const GLfloat* get_vertex_data();
+
+    size_t get_vertex_float_count();
+
+    unsigned int get_vertex_count();
+
+    unsigned int get_index_count();
+
+    GLenum get_index_type();
+
+    /* Creates the VAO and buffers and uploads into them, then releases the CPU copy unless keep_cpu_data. GL thread only */
+    void upload();
+
+    /* Frees the vertex and index vectors and the decoded cache data, only the GPU copy is left */
+    void release_cpu_data();
+
+    /* Vertex and index data held on the CPU, including the decoded cache data */
+    size_t cpu_bytes();
+
+    void init_index_buffer();
+
+    void init_vertex_buffer();
+
+    void apply_vertex_layout(unsigned int shaderID);
+
+};
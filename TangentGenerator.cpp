@@ -0,0 +1,373 @@
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TANGENT_SSE2
+#endif
+
+#include "TangentGenerator.h"
+#include "ThreadPool.h"
+#include "VertexLayouts.h"
+
+/* Input layout built by MeshLoader: position, normal, uv */
+static const unsigned int INPUT_FLOATS = FloatVertex::FLOATS;
+static const unsigned int OUTPUT_FLOATS = FloatTangentVertex::FLOATS;
+
+/* Face uv determinants below this are treated as degenerate and add nothing to their vertices */
+static const float MIN_UV_DETERMINANT = 1e-20f;
+
+/* Tangents shorter than this after removing the normal component get an arbitrary frame around the normal */
+static const float MIN_TANGENT_LENGTH_SQUARED = 1e-20f;
+
+/* Three component vectors stored as one array per component */
+struct Vec3Arrays {
+    std::vector<float> x, y, z;
+
+    void resize(size_t count) {
+        this->x.assign(count, 0.0f);
+        this->y.assign(count, 0.0f);
+        this->z.assign(count, 0.0f);
+    }
+};
+
+/* Everything the passes share, split into structure of arrays form */
+struct TangentWork {
+    const GLfloat* vertices; // starting at vertex first_vertex
+    size_t first_vertex;
+    size_t vertex_count;
+    const GLuint* indices;
+    size_t triangle_count;
+
+    Vec3Arrays positions;
+    std::vector<float> u, v;
+    Vec3Arrays face_tangents;
+    Vec3Arrays face_bitangents;
+    Vec3Arrays tangents; // per vertex sums
+    Vec3Arrays bitangents;
+
+    GLfloat* output; // starting at vertex first_vertex
+};
+
+static size_t piece_count(size_t count) {
+    return (count + TangentGenerator::PIECE_SIZE - 1) / TangentGenerator::PIECE_SIZE;
+}
+
+static void deinterleave_range(TangentWork& work, size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+        const GLfloat* vertex = work.vertices + (i - work.first_vertex) * INPUT_FLOATS;
+        work.positions.x[i] = vertex[0];
+        work.positions.y[i] = vertex[1];
+        work.positions.z[i] = vertex[2];
+        work.u[i] = vertex[6];
+        work.v[i] = vertex[7];
+    }
+}
+
+/* Same math as the SSE2 path below, one triangle at a time */
+static void face_tangent(TangentWork& work, size_t t) {
+    GLuint i1 = work.indices[t * 3];
+    GLuint i2 = work.indices[t * 3 + 1];
+    GLuint i3 = work.indices[t * 3 + 2];
+
+    float dp1x = work.positions.x[i2] - work.positions.x[i1];
+    float dp1y = work.positions.y[i2] - work.positions.y[i1];
+    float dp1z = work.positions.z[i2] - work.positions.z[i1];
+    float dp2x = work.positions.x[i3] - work.positions.x[i1];
+    float dp2y = work.positions.y[i3] - work.positions.y[i1];
+    float dp2z = work.positions.z[i3] - work.positions.z[i1];
+
+    float du1 = work.u[i2] - work.u[i1];
+    float dv1 = work.v[i2] - work.v[i1];
+    float du2 = work.u[i3] - work.u[i1];
+    float dv2 = work.v[i3] - work.v[i1];
+
+    float det = du1 * dv2 - dv1 * du2;
+    float r = std::fabs(det) > MIN_UV_DETERMINANT ? 1.0f / det : 0.0f;
+
+    work.face_tangents.x[t] = (dp1x * dv2 - dp2x * dv1) * r;
+    work.face_tangents.y[t] = (dp1y * dv2 - dp2y * dv1) * r;
+    work.face_tangents.z[t] = (dp1z * dv2 - dp2z * dv1) * r;
+    work.face_bitangents.x[t] = (dp2x * du1 - dp1x * du2) * r;
+    work.face_bitangents.y[t] = (dp2y * du1 - dp1y * du2) * r;
+    work.face_bitangents.z[t] = (dp2z * du1 - dp1z * du2) * r;
+}
+
+#ifdef TANGENT_SSE2
+/* One component of one corner for four consecutive triangles */
+static inline __m128 gather(const std::vector<float>& values, const GLuint* indices, size_t t, int corner) {
+    return _mm_setr_ps(values[indices[t * 3 + corner]], values[indices[t * 3 + 3 + corner]],
+        values[indices[t * 3 + 6 + corner]], values[indices[t * 3 + 9 + corner]]);
+}
+
+static inline __m128 abs_ps(__m128 x) {
+    return _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)));
+}
+#endif
+
+static void face_tangents_piece(TangentWork& work, size_t piece) {
+    size_t first = piece * TangentGenerator::PIECE_SIZE;
+    size_t last = std::min(first + TangentGenerator::PIECE_SIZE, work.triangle_count);
+    size_t t = first;
+
+#ifdef TANGENT_SSE2
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 min_det = _mm_set1_ps(MIN_UV_DETERMINANT);
+
+    for (; t + 4 <= last; t += 4) {
+        __m128 p1x = gather(work.positions.x, work.indices, t, 0);
+        __m128 p1y = gather(work.positions.y, work.indices, t, 0);
+        __m128 p1z = gather(work.positions.z, work.indices, t, 0);
+        __m128 dp1x = _mm_sub_ps(gather(work.positions.x, work.indices, t, 1), p1x);
+        __m128 dp1y = _mm_sub_ps(gather(work.positions.y, work.indices, t, 1), p1y);
+        __m128 dp1z = _mm_sub_ps(gather(work.positions.z, work.indices, t, 1), p1z);
+        __m128 dp2x = _mm_sub_ps(gather(work.positions.x, work.indices, t, 2), p1x);
+        __m128 dp2y = _mm_sub_ps(gather(work.positions.y, work.indices, t, 2), p1y);
+        __m128 dp2z = _mm_sub_ps(gather(work.positions.z, work.indices, t, 2), p1z);
+
+        __m128 u1 = gather(work.u, work.indices, t, 0);
+        __m128 v1 = gather(work.v, work.indices, t, 0);
+        __m128 du1 = _mm_sub_ps(gather(work.u, work.indices, t, 1), u1);
+        __m128 dv1 = _mm_sub_ps(gather(work.v, work.indices, t, 1), v1);
+        __m128 du2 = _mm_sub_ps(gather(work.u, work.indices, t, 2), u1);
+        __m128 dv2 = _mm_sub_ps(gather(work.v, work.indices, t, 2), v1);
+
+        /* Degenerate uv triangles get r = 0 instead of an infinity */
+        __m128 det = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(dv1, du2));
+        __m128 valid = _mm_cmpgt_ps(abs_ps(det), min_det);
+        __m128 r = _mm_and_ps(valid, _mm_div_ps(one, det));
+
+        _mm_storeu_ps(&work.face_tangents.x[t], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(dp1x, dv2), _mm_mul_ps(dp2x, dv1)), r));
+        _mm_storeu_ps(&work.face_tangents.y[t], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(dp1y, dv2), _mm_mul_ps(dp2y, dv1)), r));
+        _mm_storeu_ps(&work.face_tangents.z[t], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(dp1z, dv2), _mm_mul_ps(dp2z, dv1)), r));
+        _mm_storeu_ps(&work.face_bitangents.x[t], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(dp2x, du1), _mm_mul_ps(dp1x, du2)), r));
+        _mm_storeu_ps(&work.face_bitangents.y[t], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(dp2y, du1), _mm_mul_ps(dp1y, du2)), r));
+        _mm_storeu_ps(&work.face_bitangents.z[t], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(dp2z, du1), _mm_mul_ps(dp1z, du2)), r));
+    }
+#endif
+
+    for (; t < last; t++) {
+        face_tangent(work, t);
+    }
+}
+
+/* Adds every face frame to its three corners, in triangle order so the sums never depend on the thread count */
+static void accumulate(TangentWork& work) {
+    for (size_t t = 0; t < work.triangle_count; t++) {
+        for (int corner = 0; corner < 3; corner++) {
+            GLuint i = work.indices[t * 3 + corner];
+            work.tangents.x[i] += work.face_tangents.x[t];
+            work.tangents.y[i] += work.face_tangents.y[t];
+            work.tangents.z[i] += work.face_tangents.z[t];
+            work.bitangents.x[i] += work.face_bitangents.x[t];
+            work.bitangents.y[i] += work.face_bitangents.y[t];
+            work.bitangents.z[i] += work.face_bitangents.z[t];
+        }
+    }
+}
+
+/* Copies the source vertex and appends its tangent frame */
+static void write_vertex(TangentWork& work, size_t i, const float tangent[3], const float bitangent[3]) {
+    GLfloat* out = work.output + (i - work.first_vertex) * OUTPUT_FLOATS;
+    memcpy(out, work.vertices + (i - work.first_vertex) * INPUT_FLOATS, INPUT_FLOATS * sizeof(GLfloat));
+    memcpy(out + Tangent::SOURCE_FIRST, tangent, 3 * sizeof(GLfloat));
+    memcpy(out + Bitangent::SOURCE_FIRST, bitangent, 3 * sizeof(GLfloat));
+}
+
+/* Gram-Schmidt against the normal, with a fallback frame when nothing usable is left */
+static void orthonormalize_vertex(TangentWork& work, size_t i) {
+    const GLfloat* vertex = work.vertices + (i - work.first_vertex) * INPUT_FLOATS;
+    float n[3] = { vertex[3], vertex[4], vertex[5] };
+    float n_length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (n_length > 0.0f) {
+        n[0] /= n_length;
+        n[1] /= n_length;
+        n[2] /= n_length;
+    } else {
+        n[2] = 1.0f;
+    }
+
+    float t[3] = { work.tangents.x[i], work.tangents.y[i], work.tangents.z[i] };
+    float n_dot_t = n[0] * t[0] + n[1] * t[1] + n[2] * t[2];
+    t[0] -= n[0] * n_dot_t;
+    t[1] -= n[1] * n_dot_t;
+    t[2] -= n[2] * n_dot_t;
+
+    float t_length_squared = t[0] * t[0] + t[1] * t[1] + t[2] * t[2];
+    if (!(t_length_squared > MIN_TANGENT_LENGTH_SQUARED)) {
+        /* Any direction perpendicular to the normal, built from the axis it is least aligned with */
+        float axis[3] = { 0.0f, 0.0f, 0.0f };
+        axis[std::fabs(n[0]) < 0.9f ? 0 : 1] = 1.0f;
+        float n_dot_axis = n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2];
+        t[0] = axis[0] - n[0] * n_dot_axis;
+        t[1] = axis[1] - n[1] * n_dot_axis;
+        t[2] = axis[2] - n[2] * n_dot_axis;
+        t_length_squared = t[0] * t[0] + t[1] * t[1] + t[2] * t[2];
+    }
+
+    float t_length = std::sqrt(t_length_squared);
+    t[0] /= t_length;
+    t[1] /= t_length;
+    t[2] /= t_length;
+
+    float c[3] = { n[1] * t[2] - n[2] * t[1], n[2] * t[0] - n[0] * t[2], n[0] * t[1] - n[1] * t[0] };
+    float handedness = c[0] * work.bitangents.x[i] + c[1] * work.bitangents.y[i] + c[2] * work.bitangents.z[i] < 0.0f ? -1.0f : 1.0f;
+    float b[3] = { c[0] * handedness, c[1] * handedness, c[2] * handedness };
+
+    write_vertex(work, i, t, b);
+}
+
+static void orthonormalize_range(TangentWork& work, size_t first, size_t last) {
+    size_t i = first;
+
+#ifdef TANGENT_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minus_one = _mm_set1_ps(-1.0f);
+    const __m128 min_length = _mm_set1_ps(MIN_TANGENT_LENGTH_SQUARED);
+
+    for (; i + 4 <= last; i += 4) {
+        const GLfloat* vertex = work.vertices + (i - work.first_vertex) * INPUT_FLOATS;
+        __m128 nx = _mm_setr_ps(vertex[3], vertex[11], vertex[19], vertex[27]);
+        __m128 ny = _mm_setr_ps(vertex[4], vertex[12], vertex[20], vertex[28]);
+        __m128 nz = _mm_setr_ps(vertex[5], vertex[13], vertex[21], vertex[29]);
+
+        __m128 n_length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+        nx = _mm_div_ps(nx, n_length);
+        ny = _mm_div_ps(ny, n_length);
+        nz = _mm_div_ps(nz, n_length);
+
+        __m128 tx = _mm_loadu_ps(&work.tangents.x[i]);
+        __m128 ty = _mm_loadu_ps(&work.tangents.y[i]);
+        __m128 tz = _mm_loadu_ps(&work.tangents.z[i]);
+        __m128 n_dot_t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, tx), _mm_mul_ps(ny, ty)), _mm_mul_ps(nz, tz));
+        tx = _mm_sub_ps(tx, _mm_mul_ps(nx, n_dot_t));
+        ty = _mm_sub_ps(ty, _mm_mul_ps(ny, n_dot_t));
+        tz = _mm_sub_ps(tz, _mm_mul_ps(nz, n_dot_t));
+
+        __m128 t_length_squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz));
+        __m128 t_length = _mm_sqrt_ps(t_length_squared);
+        tx = _mm_div_ps(tx, t_length);
+        ty = _mm_div_ps(ty, t_length);
+        tz = _mm_div_ps(tz, t_length);
+
+        __m128 cx = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(nz, ty));
+        __m128 cy = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(nx, tz));
+        __m128 cz = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(ny, tx));
+        __m128 c_dot_b = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(cx, _mm_loadu_ps(&work.bitangents.x[i])),
+            _mm_mul_ps(cy, _mm_loadu_ps(&work.bitangents.y[i]))),
+            _mm_mul_ps(cz, _mm_loadu_ps(&work.bitangents.z[i])));
+        __m128 flip = _mm_cmplt_ps(c_dot_b, zero);
+        __m128 handedness = _mm_or_ps(_mm_and_ps(flip, minus_one), _mm_andnot_ps(flip, one));
+
+        alignas(16) float lanes[6][4];
+        _mm_store_ps(lanes[0], tx);
+        _mm_store_ps(lanes[1], ty);
+        _mm_store_ps(lanes[2], tz);
+        _mm_store_ps(lanes[3], _mm_mul_ps(cx, handedness));
+        _mm_store_ps(lanes[4], _mm_mul_ps(cy, handedness));
+        _mm_store_ps(lanes[5], _mm_mul_ps(cz, handedness));
+
+        /* Zero normals and tangents that vanish after the projection take the scalar fallback */
+        int usable = _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(n_length, zero), _mm_cmpgt_ps(t_length_squared, min_length)));
+        for (int lane = 0; lane < 4; lane++) {
+            if (usable & (1 << lane)) {
+                float tangent[3] = { lanes[0][lane], lanes[1][lane], lanes[2][lane] };
+                float bitangent[3] = { lanes[3][lane], lanes[4][lane], lanes[5][lane] };
+                write_vertex(work, i + lane, tangent, bitangent);
+            } else {
+                orthonormalize_vertex(work, i + lane);
+            }
+        }
+    }
+#endif
+
+    for (; i < last; i++) {
+        orthonormalize_vertex(work, i);
+    }
+}
+
+void TangentGenerator::generate(const GLfloat* vertices, size_t vertex_count, const GLuint* indices, size_t index_count,
+    ThreadPool* pool, std::vector<GLfloat>& output) {
+    TangentWork work;
+    work.vertices = vertices;
+    work.first_vertex = 0;
+    work.vertex_count = vertex_count;
+    work.indices = indices;
+    work.triangle_count = index_count / 3;
+
+    work.positions.resize(vertex_count);
+    work.u.assign(vertex_count, 0.0f);
+    work.v.assign(vertex_count, 0.0f);
+    work.face_tangents.resize(work.triangle_count);
+    work.face_bitangents.resize(work.triangle_count);
+    work.tangents.resize(vertex_count);
+    work.bitangents.resize(vertex_count);
+
+    output.resize(vertex_count * OUTPUT_FLOATS);
+    work.output = output.data();
+
+    ThreadPool::for_each(pool, piece_count(vertex_count), [&work](size_t piece) {
+        deinterleave_range(work, piece * PIECE_SIZE, std::min((piece + 1) * PIECE_SIZE, work.vertex_count));
+    });
+    ThreadPool::for_each(pool, piece_count(work.triangle_count), [&work](size_t piece) { face_tangents_piece(work, piece); });
+    accumulate(work);
+    ThreadPool::for_each(pool, piece_count(vertex_count), [&work](size_t piece) {
+        orthonormalize_range(work, piece * PIECE_SIZE, std::min((piece + 1) * PIECE_SIZE, work.vertex_count));
+    });
+}
+
+TangentAccumulator::TangentAccumulator(size_t vertex_count) : work(std::make_unique<TangentWork>()) {
+    this->work->vertices = nullptr;
+    this->work->first_vertex = 0;
+    this->work->vertex_count = vertex_count;
+    this->work->indices = nullptr;
+    this->work->triangle_count = 0;
+    this->work->output = nullptr;
+
+    this->work->positions.resize(vertex_count);
+    this->work->u.assign(vertex_count, 0.0f);
+    this->work->v.assign(vertex_count, 0.0f);
+    this->work->tangents.resize(vertex_count);
+    this->work->bitangents.resize(vertex_count);
+}
+
+TangentAccumulator::~TangentAccumulator() {
+}
+
+void TangentAccumulator::add_vertices(size_t first, const GLfloat* vertices, size_t count) {
+    this->work->vertices = vertices;
+    this->work->first_vertex = first;
+    deinterleave_range(*this->work, first, std::min(first + count, this->work->vertex_count));
+}
+
+void TangentAccumulator::add_triangles(const GLuint* indices, size_t index_count) {
+    TangentWork& work = *this->work;
+    work.indices = indices;
+    work.triangle_count = index_count / 3;
+    if (work.face_tangents.x.size() < work.triangle_count) {
+        work.face_tangents.resize(work.triangle_count);
+        work.face_bitangents.resize(work.triangle_count);
+    }
+
+    for (size_t piece = 0; piece < piece_count(work.triangle_count); piece++) {
+        face_tangents_piece(work, piece);
+    }
+    accumulate(work);
+}
+
+void TangentAccumulator::finish_vertices(size_t first, const GLfloat* vertices, size_t count, GLfloat* output) {
+    this->work->vertices = vertices;
+    this->work->first_vertex = first;
+    this->work->output = output;
+    orthonormalize_range(*this->work, first, std::min(first + count, this->work->vertex_count));
+}
+
+size_t TangentAccumulator::memory_bytes() const {
+    return this->work->vertex_count * 11 * sizeof(float) + this->work->face_tangents.x.capacity() * 6 * sizeof(float);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+struct TangentWork;
+
+/*
+ * Per vertex tangent frames for normal mapping. Positions, normals and uvs are split into separate arrays,
+ * face tangents are computed four triangles at a time with SSE2 and summed into every vertex that shares the
+ * face, then each vertex is Gram-Schmidt orthonormalized against its normal in the same four wide fashion.
+ * The bitangent is cross(N, T) with the handedness of the summed uv bitangent.
+ */
+class TangentGenerator {
+
+public:
+
+    /* Meshes with fewer triangles than this are not worth spreading over a pool */
+    static const size_t PARALLEL_TRIANGLES = 64 * 1024;
+
+    /* Work is split into pieces of this many vertices or triangles */
+    static const size_t PIECE_SIZE = 16 * 1024;
+
+    /*
+     * vertices holds vertex_count * 8 floats (position, normal, uv) indexed by the triangle list.
+     * output receives vertex_count * 14 floats, the same vertices with tangent and bitangent appended
+     */
+    static void generate(const GLfloat* vertices, size_t vertex_count, const GLuint* indices, size_t index_count,
+        ThreadPool* pool, std::vector<GLfloat>& output);
+
+};
+
+/*
+ * TangentGenerator::generate for meshes that are never in memory as a whole. Only the positions, uvs and tangent
+ * sums of every vertex are kept, 44 bytes each. The vertices are fed in first, then the triangle list in order,
+ * then the vertices once more to come out with their tangent frames, all in pieces of any size. Sums are added
+ * in the same order as generate's, so the result is the same.
+ */
+class TangentAccumulator {
+
+public:
+
+    explicit TangentAccumulator(size_t vertex_count);
+
+    ~TangentAccumulator();
+
+    TangentAccumulator(const TangentAccumulator&) = delete;
+
+    TangentAccumulator& operator=(const TangentAccumulator&) = delete;
+
+    /* vertices holds count * 8 floats, for vertices first to first + count - 1 */
+    void add_vertices(size_t first, const GLfloat* vertices, size_t count);
+
+    /* The next whole triangles of the list */
+    void add_triangles(const GLuint* indices, size_t index_count);
+
+    /* Once every triangle is in. output receives count * 14 floats, the vertices with tangent and bitangent appended */
+    void finish_vertices(size_t first, const GLfloat* vertices, size_t count, GLfloat* output);
+
+    size_t memory_bytes() const;
+
+private:
+
+    std::unique_ptr<TangentWork> work;
+
+};
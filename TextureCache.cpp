@@ -0,0 +1,180 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+#include "TextureCache.h"
+#include "TextureCompressor.h"
+
+static const char TEXTURE_CACHE_DIR[] = "Cache";
+static const char TEXTURE_CACHE_MAGIC[4] = { 'T', 'E', 'X', 'C' };
+
+static const uint32_t TEXTURE_FLAG_FLIP = 1;
+static const uint32_t TEXTURE_FLAG_MIPS = 2;
+static const uint32_t TEXTURE_FLAG_NORMAL_MAP = 4;
+static const uint32_t TEXTURE_FLAG_COMPRESS = 8;
+
+/* The header's flags hold the options in the low byte and the format they resolved to above it */
+static const int TEXTURE_FORMAT_SHIFT = 8;
+
+/* Fixed 64 byte header, level 0 starts right after it and every smaller level follows */
+struct TextureCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t level_count;
+    uint32_t flags;
+    float cold_ms;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t source_hash;
+    uint64_t path_hash;
+};
+
+static_assert(sizeof(TextureCacheHeader) == 64, "texture cache header must stay 64 bytes");
+
+static uint32_t texture_flags(const TextureOptions& options) {
+    return (options.flip ? TEXTURE_FLAG_FLIP : 0) | (options.mips ? TEXTURE_FLAG_MIPS : 0) |
+        (options.normal_map ? TEXTURE_FLAG_NORMAL_MAP : 0) | (options.compress ? TEXTURE_FLAG_COMPRESS : 0);
+}
+
+std::string TextureCache::cache_path(const char* source_path, const TextureOptions& options) {
+    /* Flatten the relative asset path into a single file name, eg. 3D/shark_texture.jpg -> 3D_shark_texture_jpg.11.tex */
+    std::string name = source_path;
+    for (char& c : name) {
+        if (c == '/' || c == '\\' || c == ':' || c == '.') {
+            c = '_';
+        }
+    }
+
+    return std::string(TEXTURE_CACHE_DIR) + "/" + name + "." + std::to_string(texture_flags(options)) + ".tex";
+}
+
+size_t TextureCache::level_size(int width, int height, TextureFormat format) {
+    switch (format) {
+    case TEXTURE_FORMAT_RGB8:
+        return (size_t)width * height * 3;
+    case TEXTURE_FORMAT_RGBA8:
+        return (size_t)width * height * 4;
+    case TEXTURE_FORMAT_RG8:
+        return (size_t)width * height * 2;
+    default:
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * TextureCompressor::block_bytes(format);
+    }
+}
+
+size_t TextureCache::layout_levels(int width, int height, TextureFormat format, bool mips, std::vector<TextureLevel>& levels) {
+    levels.clear();
+    size_t offset = 0;
+    while (true) {
+        TextureLevel level;
+        level.width = width;
+        level.height = height;
+        level.offset = offset;
+        level.size = level_size(width, height, format);
+        levels.push_back(level);
+        offset += level.size;
+
+        if (!mips || (width == 1 && height == 1)) {
+            break;
+        }
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return offset;
+}
+
+bool TextureCache::load(const char* source_path, const MeshSourceKey& key, const TextureOptions& options, DecodedImage& image) {
+    std::string path = cache_path(source_path, options);
+
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(path.c_str())) {
+        return false;
+    }
+    if (file->size() < sizeof(TextureCacheHeader)) {
+        return false;
+    }
+
+    TextureCacheHeader header;
+    memcpy(&header, file->data(), sizeof(header));
+
+    /* Any mismatch means the image or the format changed since the cache was written */
+    std::vector<TextureLevel> levels;
+    bool valid = memcmp(header.magic, TEXTURE_CACHE_MAGIC, 4) == 0 &&
+        header.version == VERSION &&
+        (header.flags & ((1u << TEXTURE_FORMAT_SHIFT) - 1)) == texture_flags(options) &&
+        (header.flags >> TEXTURE_FORMAT_SHIFT) <= TEXTURE_FORMAT_RG8 &&
+        header.source_size == key.size &&
+        header.source_mtime == key.mtime &&
+        header.source_hash == key.hash &&
+        header.path_hash == MeshCache::hash_bytes(source_path, strlen(source_path)) &&
+        header.width > 0 && header.width <= 65536 && header.height > 0 && header.height <= 65536 &&
+        (header.channels == 3 || header.channels == 4);
+    TextureFormat format = (TextureFormat)(header.flags >> TEXTURE_FORMAT_SHIFT);
+    if (valid) {
+        size_t bytes = layout_levels((int)header.width, (int)header.height, format, options.mips, levels);
+        valid = header.level_count == levels.size() && file->size() == sizeof(TextureCacheHeader) + bytes;
+    }
+    if (!valid) {
+        std::cout << "Texture cache for " << source_path << " is stale, rebuilding" << std::endl;
+        return false;
+    }
+
+    image.width = (int)header.width;
+    image.height = (int)header.height;
+    image.channels = (int)header.channels;
+    image.format = format;
+    image.levels = std::move(levels);
+    image.data = file->data() + sizeof(TextureCacheHeader);
+    image.file_bytes = file->size();
+    image.cold_ms = header.cold_ms;
+    image.from_cache = true;
+    image.file = std::move(file);
+    return true;
+}
+
+bool TextureCache::store(const char* source_path, const MeshSourceKey& key, const TextureOptions& options, const DecodedImage& image) {
+    std::error_code ec;
+    std::filesystem::create_directories(TEXTURE_CACHE_DIR, ec);
+
+    std::string path = cache_path(source_path, options);
+    std::string temp_path = path + ".tmp";
+
+    TextureCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TEXTURE_CACHE_MAGIC, 4);
+    header.version = VERSION;
+    header.width = (uint32_t)image.width;
+    header.height = (uint32_t)image.height;
+    header.channels = (uint32_t)image.channels;
+    header.level_count = (uint32_t)image.levels.size();
+    header.flags = texture_flags(options) | ((uint32_t)image.format << TEXTURE_FORMAT_SHIFT);
+    header.cold_ms = (float)image.cold_ms;
+    header.source_size = key.size;
+    header.source_mtime = key.mtime;
+    header.source_hash = key.hash;
+    header.path_hash = MeshCache::hash_bytes(source_path, strlen(source_path));
+
+    const TextureLevel& last = image.levels.back();
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)image.data, last.offset + last.size);
+    out.close();
+
+    /* Written beside the real file and renamed over it, so a reader never maps half a file */
+    if (!out) {
+        std::cout << "Could not write texture cache " << temp_path << std::endl;
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "MeshCache.h"
+
+/* How the levels of a DecodedImage are stored, the BC formats in 4x4 blocks */
+enum TextureFormat {
+    TEXTURE_FORMAT_RGB8,
+    TEXTURE_FORMAT_RGBA8,
+    TEXTURE_FORMAT_BC1, // RGB, 8 bytes a block
+    TEXTURE_FORMAT_BC3, // RGBA, 16 bytes a block
+    TEXTURE_FORMAT_BC5, // two channel normal maps, 16 bytes a block
+    TEXTURE_FORMAT_RG8 // two channel normal maps where BC5 is not available
+};
+
+/* What a texture is decoded into, each combination is a separate cache file */
+struct TextureOptions {
+    bool flip; // rows bottom up for GL
+    bool mips; // the full chain instead of level 0 alone
+    bool normal_map; // tangent space normals, only red and green are kept, as BC5 or RG8
+    bool compress; // block compressed instead of 8 bit rows
+};
+
+/* One mip level inside DecodedImage::data, rows or block rows tightly packed */
+struct TextureLevel {
+    int width, height;
+    size_t offset;
+    size_t size;
+};
+
+/* Image with its mip chain, decoded on a loader thread or mapped from the texture cache, freed once uploaded */
+struct DecodedImage {
+    int width, height, channels; // channels of the decoded source, 3 or 4, whatever format it ended up in
+    TextureFormat format;
+    std::vector<TextureLevel> levels; // level 0 first
+    const unsigned char* data; // into storage when decoded, into file when read from the cache, null when loading failed
+    std::vector<unsigned char> storage;
+    std::shared_ptr<MappedFile> file;
+    int upload_slot; // TextureUploadRing buffer data was staged into, -1 while it is in client memory
+    std::shared_ptr<void> upload_lease; // hands the buffer back to the ring if the last copy goes before the upload
+
+    bool from_cache;
+    size_t file_bytes; // size of the cache file when read from it
+    double decode_ms; // time this load took on its worker
+    double cold_ms; // decoding, building the mips and compressing, measured when the cache file was written
+    std::chrono::steady_clock::time_point decoded_time;
+};
+
+/*
+ * On-disk cache of decoded textures. Files live in Cache/ and hold a fixed 64 byte header followed by every
+ * mip level as 8 bit rows or compressed blocks, ready for glTexImage2D or glCompressedTexImage2D straight out
+ * of the mapping. A file is only valid for the exact source file it was decoded from and the same TextureOptions.
+ */
+class TextureCache {
+
+public:
+
+    /* Bump whenever the header or the pixel layout changes */
+    static const uint32_t VERSION = 3;
+
+    /* Maps the cache file of source_path and points image's levels into it */
+    static bool load(const char* source_path, const MeshSourceKey& key, const TextureOptions& options, DecodedImage& image);
+
+    static bool store(const char* source_path, const MeshSourceKey& key, const TextureOptions& options, const DecodedImage& image);
+
+    static std::string cache_path(const char* source_path, const TextureOptions& options);
+
+    /* Bytes of one width x height level in format, whole blocks for the BC formats */
+    static size_t level_size(int width, int height, TextureFormat format);
+
+    /* Fills levels with the tightly packed layout of a chain down to 1x1, or of level 0 alone. Returns the total size */
+    static size_t layout_levels(int width, int height, TextureFormat format, bool mips, std::vector<TextureLevel>& levels);
+
+};
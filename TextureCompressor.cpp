@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "TextureCompressor.h"
+#include "ThreadPool.h"
+
+/* Power iterations towards the principal axis of a block's colors */
+static const int AXIS_ITERATIONS = 4;
+
+static uint16_t pack_565(const float color[3]) {
+    int r = (int)std::lround(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f);
+    int g = (int)std::lround(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f);
+    int b = (int)std::lround(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+/* The 8 bit color a decoder expands 565 to */
+static void unpack_565(uint16_t packed, int color[3]) {
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+/* Picks the nearest of the four colors for every texel, returns the squared error */
+static int pick_indices(const unsigned char* rgba, uint16_t c0, uint16_t c1, uint32_t& indices) {
+    int palette[4][3];
+    unpack_565(c0, palette[0]);
+    unpack_565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+    }
+
+    int total = 0;
+    indices = 0;
+    for (int i = 0; i < 16; i++) {
+        const unsigned char* texel = rgba + i * 4;
+        int best = 0, best_error = 1 << 30;
+        for (int p = 0; p < 4; p++) {
+            int dr = texel[0] - palette[p][0], dg = texel[1] - palette[p][1], db = texel[2] - palette[p][2];
+            int error = dr * dr + dg * dg + db * db;
+            if (error < best_error) {
+                best_error = error;
+                best = p;
+            }
+        }
+        indices |= (uint32_t)best << (i * 2);
+        total += best_error;
+    }
+    return total;
+}
+
+/* Least squares endpoints for the texels' current positions along the line, the refinement step */
+static bool fit_endpoints(const unsigned char* rgba, uint32_t indices, float start[3], float end[3]) {
+    static const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+    float ax[3] = { 0.0f, 0.0f, 0.0f }, bx[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++) {
+        float b = weights[(indices >> (i * 2)) & 3];
+        float a = 1.0f - b;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        for (int c = 0; c < 3; c++) {
+            ax[c] += a * rgba[i * 4 + c];
+            bx[c] += b * rgba[i * 4 + c];
+        }
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f) {
+        return false;
+    }
+    for (int c = 0; c < 3; c++) {
+        start[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+        end[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+    }
+    return true;
+}
+
+/* Four color mode needs the first endpoint to be the larger one, swapping them swaps index 0 with 1 and 2 with 3 */
+static void write_bc1(uint16_t c0, uint16_t c1, uint32_t indices, unsigned char* out) {
+    if (c0 < c1) {
+        std::swap(c0, c1);
+        indices ^= 0x55555555u;
+    } else if (c0 == c1) {
+        indices = 0;
+    }
+    memcpy(out, &c0, 2);
+    memcpy(out + 2, &c1, 2);
+    memcpy(out + 4, &indices, 4);
+}
+
+void TextureCompressor::encode_bc1_block(const unsigned char* rgba, unsigned char* out) {
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            mean[c] += rgba[i * 4 + c];
+            lo[c] = std::min(lo[c], (int)rgba[i * 4 + c]);
+            hi[c] = std::max(hi[c], (int)rgba[i * 4 + c]);
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        mean[c] /= 16.0f;
+    }
+
+    if (lo[0] == hi[0] && lo[1] == hi[1] && lo[2] == hi[2]) {
+        uint16_t color = pack_565(mean);
+        uint32_t indices;
+        pick_indices(rgba, color, color, indices);
+        write_bc1(color, color, indices, out);
+        return;
+    }
+
+    /* Covariance of the block, its largest eigenvector is the line the colors spread along */
+    float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++) {
+        float r = rgba[i * 4] - mean[0], g = rgba[i * 4 + 1] - mean[1], b = rgba[i * 4 + 2] - mean[2];
+        covariance[0] += r * r;
+        covariance[1] += r * g;
+        covariance[2] += r * b;
+        covariance[3] += g * g;
+        covariance[4] += g * b;
+        covariance[5] += b * b;
+    }
+
+    float axis[3] = { (float)(hi[0] - lo[0]), (float)(hi[1] - lo[1]), (float)(hi[2] - lo[2]) };
+    for (int iteration = 0; iteration < AXIS_ITERATIONS; iteration++) {
+        float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+        float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+        float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+        float length = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+        if (length <= 0.0f) {
+            break;
+        }
+        axis[0] = x / length;
+        axis[1] = y / length;
+        axis[2] = z / length;
+    }
+
+    /* The texels furthest along the axis in either direction are the first endpoints */
+    float min_dot = 1e30f, max_dot = -1e30f;
+    int min_texel = 0, max_texel = 0;
+    for (int i = 0; i < 16; i++) {
+        float dot = rgba[i * 4] * axis[0] + rgba[i * 4 + 1] * axis[1] + rgba[i * 4 + 2] * axis[2];
+        if (dot < min_dot) {
+            min_dot = dot;
+            min_texel = i;
+        }
+        if (dot > max_dot) {
+            max_dot = dot;
+            max_texel = i;
+        }
+    }
+
+    float start[3], end[3];
+    for (int c = 0; c < 3; c++) {
+        start[c] = rgba[max_texel * 4 + c];
+        end[c] = rgba[min_texel * 4 + c];
+    }
+
+    uint16_t c0 = pack_565(start), c1 = pack_565(end);
+    uint32_t indices;
+    int error = pick_indices(rgba, c0, c1, indices);
+
+    /* Refit the endpoints to the texels they were assigned, keep it only if it helped */
+    if (fit_endpoints(rgba, indices, start, end)) {
+        uint16_t r0 = pack_565(start), r1 = pack_565(end);
+        uint32_t refined_indices;
+        int refined_error = pick_indices(rgba, r0, r1, refined_indices);
+        if (refined_error < error) {
+            c0 = r0;
+            c1 = r1;
+            indices = refined_indices;
+        }
+    }
+
+    write_bc1(c0, c1, indices, out);
+}
+
+void TextureCompressor::encode_bc4_block(const unsigned char* values, unsigned char* out) {
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++) {
+        lo = std::min(lo, (int)values[i]);
+        hi = std::max(hi, (int)values[i]);
+    }
+
+    out[0] = (unsigned char)hi;
+    out[1] = (unsigned char)lo;
+    uint64_t indices = 0;
+
+    /* With a0 > a1 the palette is a0, a1 and six steps between them, a flat block leaves every index 0 */
+    if (hi > lo) {
+        int palette[8];
+        palette[0] = hi;
+        palette[1] = lo;
+        for (int step = 1; step < 7; step++) {
+            palette[step + 1] = ((7 - step) * hi + step * lo + 3) / 7;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            int best = 0, best_error = 1 << 30;
+            for (int p = 0; p < 8; p++) {
+                int error = std::abs(values[i] - palette[p]);
+                if (error < best_error) {
+                    best_error = error;
+                    best = p;
+                }
+            }
+            indices |= (uint64_t)best << (i * 3);
+        }
+    }
+
+    for (int b = 0; b < 6; b++) {
+        out[2 + b] = (unsigned char)(indices >> (b * 8));
+    }
+}
+
+size_t TextureCompressor::block_bytes(TextureFormat format) {
+    switch (format) {
+    case TEXTURE_FORMAT_BC1:
+        return 8;
+    case TEXTURE_FORMAT_BC3:
+    case TEXTURE_FORMAT_BC5:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+void TextureCompressor::encode_level(const unsigned char* pixels, int width, int height, int channels, TextureFormat format,
+    unsigned char* out, ThreadPool* pool) {
+    const int blocks_wide = (width + 3) / 4;
+    const int blocks_high = (height + 3) / 4;
+    const size_t bytes = block_bytes(format);
+    const size_t pieces = (size_t)(blocks_high + ROWS_PER_PIECE - 1) / ROWS_PER_PIECE;
+
+    ThreadPool::for_each(pool, pieces, [&](size_t piece) {
+        int first_row = (int)piece * ROWS_PER_PIECE;
+        int last_row = std::min(first_row + ROWS_PER_PIECE, blocks_high);
+        unsigned char rgba[64];
+        unsigned char channel[16];
+
+        for (int by = first_row; by < last_row; by++) {
+            for (int bx = 0; bx < blocks_wide; bx++) {
+                /* Gather the tile as RGBA, texels past the edge repeat the last row or column */
+                for (int i = 0; i < 16; i++) {
+                    int x = std::min(bx * 4 + (i & 3), width - 1);
+                    int y = std::min(by * 4 + (i >> 2), height - 1);
+                    const unsigned char* texel = pixels + ((size_t)y * width + x) * channels;
+                    rgba[i * 4] = texel[0];
+                    rgba[i * 4 + 1] = channels > 1 ? texel[1] : texel[0];
+                    rgba[i * 4 + 2] = channels > 2 ? texel[2] : texel[0];
+                    rgba[i * 4 + 3] = channels > 3 ? texel[3] : 255;
+                }
+
+                unsigned char* block = out + ((size_t)by * blocks_wide + bx) * bytes;
+                if (format == TEXTURE_FORMAT_BC1) {
+                    encode_bc1_block(rgba, block);
+                } else if (format == TEXTURE_FORMAT_BC3) {
+                    for (int i = 0; i < 16; i++) {
+                        channel[i] = rgba[i * 4 + 3];
+                    }
+                    encode_bc4_block(channel, block);
+                    encode_bc1_block(rgba, block + 8);
+                } else {
+                    for (int c = 0; c < 2; c++) {
+                        for (int i = 0; i < 16; i++) {
+                            channel[i] = rgba[i * 4 + c];
+                        }
+                        encode_bc4_block(channel, block + c * 8);
+                    }
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+#include "TextureCache.h"
+
+class ThreadPool;
+
+/*
+ * CPU encoder for the block compressed formats every desktop GPU samples natively. Each 4x4 block is
+ * encoded on its own: BC1 fits the colors to a line through RGB space along their principal axis and
+ * refines the two endpoints by least squares, BC4 spans the block's min and max with eight steps.
+ * BC3 is a BC4 alpha block followed by a BC1 color block, BC5 is a BC4 block each for red and green.
+ */
+class TextureCompressor {
+
+public:
+
+    /* Block rows handed to one worker at a time */
+    static const int ROWS_PER_PIECE = 16;
+
+    /* Bytes of one 4x4 block, 0 for the uncompressed formats */
+    static size_t block_bytes(TextureFormat format);
+
+    /* pixels holds width * height texels of channels bytes, out receives one block per 4x4 tile, edges repeat */
+    static void encode_level(const unsigned char* pixels, int width, int height, int channels, TextureFormat format,
+        unsigned char* out, ThreadPool* pool);
+
+    /* rgba holds 16 texels of 4 bytes in row order */
+    static void encode_bc1_block(const unsigned char* rgba, unsigned char* out);
+
+    /* values holds one channel of 16 texels */
+    static void encode_bc4_block(const unsigned char* values, unsigned char* out);
+
+};
@@ -0,0 +1,192 @@
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "AssetArchive.h"
+#include "TextureCompressor.h"
+#include "TextureDecoder.h"
+#include "ThreadPool.h"
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void TextureDecoder::flip_rows(unsigned char* pixels, int width, int height, int channels) {
+    size_t row_bytes = (size_t)width * channels;
+    std::vector<unsigned char> row(row_bytes);
+    for (int y = 0; y < height / 2; y++) {
+        unsigned char* top = pixels + (size_t)y * row_bytes;
+        unsigned char* bottom = pixels + (size_t)(height - 1 - y) * row_bytes;
+        memcpy(row.data(), top, row_bytes);
+        memcpy(top, bottom, row_bytes);
+        memcpy(bottom, row.data(), row_bytes);
+    }
+}
+
+/* Odd sizes repeat their last row or column, the same texels glGenerateMipmap would weigh in */
+void TextureDecoder::build_mips(DecodedImage& image) {
+    const int channels = image.channels;
+    for (size_t l = 1; l < image.levels.size(); l++) {
+        const TextureLevel& source = image.levels[l - 1];
+        const TextureLevel& target = image.levels[l];
+        const unsigned char* in = image.storage.data() + source.offset;
+        unsigned char* out = image.storage.data() + target.offset;
+        size_t source_row = (size_t)source.width * channels;
+
+        for (int y = 0; y < target.height; y++) {
+            const unsigned char* row0 = in + (size_t)std::min(2 * y, source.height - 1) * source_row;
+            const unsigned char* row1 = in + (size_t)std::min(2 * y + 1, source.height - 1) * source_row;
+            unsigned char* dst = out + (size_t)y * target.width * channels;
+            for (int x = 0; x < target.width; x++) {
+                size_t x0 = (size_t)std::min(2 * x, source.width - 1) * channels;
+                size_t x1 = (size_t)std::min(2 * x + 1, source.width - 1) * channels;
+                for (int c = 0; c < channels; c++) {
+                    dst[c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+                }
+                dst += channels;
+            }
+        }
+    }
+}
+
+TextureFormat TextureDecoder::choose_format(const TextureOptions& options, int channels) {
+    if (options.normal_map) {
+        return options.compress ? TEXTURE_FORMAT_BC5 : TEXTURE_FORMAT_RG8;
+    }
+    if (!options.compress) {
+        return channels == 4 ? TEXTURE_FORMAT_RGBA8 : TEXTURE_FORMAT_RGB8;
+    }
+    return channels == 4 ? TEXTURE_FORMAT_BC3 : TEXTURE_FORMAT_BC1;
+}
+
+void TextureDecoder::keep_levels(DecodedImage& image, size_t first_level, size_t end_level) {
+    if (!image.data || first_level >= end_level || end_level > image.levels.size()) {
+        return;
+    }
+    size_t base = image.levels[first_level].offset;
+    image.data += base;
+    for (size_t l = 0; l < image.levels.size(); l++) {
+        TextureLevel& level = image.levels[l];
+        if (l >= first_level && l < end_level) {
+            level.offset -= base;
+        } else {
+            level.offset = 0;
+            level.size = 0;
+        }
+    }
+}
+
+void TextureDecoder::convert(DecodedImage& image, TextureFormat format) {
+    std::vector<TextureLevel> levels;
+    std::vector<unsigned char> blocks(TextureCache::layout_levels(image.width, image.height, format, image.levels.size() > 1, levels));
+
+    /* Normal maps are unit length, the shader rebuilds blue from red and green */
+    if (format == TEXTURE_FORMAT_RG8) {
+        const unsigned char* in = image.storage.data();
+        size_t texels = blocks.size() / 2;
+        for (size_t t = 0; t < texels; t++) {
+            blocks[t * 2] = in[t * image.channels];
+            blocks[t * 2 + 1] = in[t * image.channels + 1];
+        }
+        image.format = format;
+        image.levels = std::move(levels);
+        image.storage = std::move(blocks);
+        return;
+    }
+
+    /* Each level splits into block rows on the shared pool, the loader pool this runs on stays free for other files */
+    for (size_t l = 0; l < levels.size(); l++) {
+        const TextureLevel& source = image.levels[l];
+        TextureCompressor::encode_level(image.storage.data() + source.offset, source.width, source.height, image.channels,
+            format, blocks.data() + levels[l].offset, &ThreadPool::shared());
+    }
+
+    image.format = format;
+    image.levels = std::move(levels);
+    image.storage = std::move(blocks);
+}
+
+bool TextureDecoder::read_info(const char* path, int& width, int& height, int& channels) {
+    AssetBlob blob;
+    int file_channels = 0;
+    bool known = AssetArchive::find(path, blob)
+        ? stbi_info_from_memory(blob.data, (int)blob.size, &width, &height, &file_channels) != 0
+        : stbi_info(path, &width, &height, &file_channels) != 0;
+    channels = file_channels == 4 || file_channels == 2 ? 4 : 3;
+    return known;
+}
+
+DecodedImage TextureDecoder::decode(const char* path, const TextureOptions& options, bool use_cache) {
+    auto start = std::chrono::steady_clock::now();
+    DecodedImage image;
+    image.width = 0;
+    image.height = 0;
+    image.channels = 0;
+    image.format = TEXTURE_FORMAT_RGB8;
+    image.data = nullptr;
+    image.upload_slot = -1;
+    image.from_cache = false;
+    image.file_bytes = 0;
+    image.cold_ms = 0.0;
+
+    MeshSourceKey key;
+    bool has_key = use_cache && MeshCache::read_source_key(path, key);
+    if (has_key && TextureCache::load(path, key, options, image)) {
+        image.decoded_time = std::chrono::steady_clock::now();
+        image.decode_ms = elapsed_ms(start);
+        return image;
+    }
+
+    /* Only the header is read to pick the channel count, stbi converts while decoding */
+    AssetBlob blob;
+    bool packed = AssetArchive::find(path, blob);
+    int file_channels = 0;
+    int wanted = 0;
+
+    unsigned char* pixels = nullptr;
+    if (read_info(path, image.width, image.height, wanted)) {
+        pixels = packed
+            ? stbi_load_from_memory(blob.data, (int)blob.size, &image.width, &image.height, &file_channels, wanted)
+            : stbi_load(path, &image.width, &image.height, &file_channels, wanted);
+    }
+    if (!pixels) {
+        std::cout << "Failed to load " << path << std::endl;
+        image.decoded_time = std::chrono::steady_clock::now();
+        image.decode_ms = elapsed_ms(start);
+        return image;
+    }
+
+    /* Level 0 goes first in the same buffer as the rest of the chain */
+    image.channels = wanted;
+    image.format = wanted == 4 ? TEXTURE_FORMAT_RGBA8 : TEXTURE_FORMAT_RGB8;
+    image.storage.resize(TextureCache::layout_levels(image.width, image.height, image.format, options.mips, image.levels));
+    memcpy(image.storage.data(), pixels, image.levels[0].size);
+    stbi_image_free(pixels);
+
+    /* Flipped on this thread's own copy, nothing is shared with other decodes */
+    if (options.flip) {
+        flip_rows(image.storage.data(), image.width, image.height, image.channels);
+    }
+    build_mips(image);
+
+    /* Mips are filtered from the 8 bit levels, compressing or dropping blue from each of them is the last step */
+    TextureFormat format = choose_format(options, image.channels);
+    if (format != image.format) {
+        convert(image, format);
+    }
+    image.data = image.storage.data();
+    image.cold_ms = elapsed_ms(start);
+
+    if (has_key) {
+        TextureCache::store(path, key, options, image);
+    }
+
+    image.decoded_time = std::chrono::steady_clock::now();
+    image.decode_ms = elapsed_ms(start);
+    return image;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "TextureCache.h"
+
+/*
+ * Turns an image file into the levels TextureLoader uploads. Reads the texture cache when it matches the
+ * source, otherwise decodes with stb_image, flips, builds the mip chain on the CPU, block compresses it when
+ * asked to and writes the cache. No GL calls, safe on any thread, the cooker uses it too.
+ */
+class TextureDecoder {
+
+public:
+
+    /* Gray images are expanded to RGB and gray with alpha to RGBA, so only 3 or 4 channels come out */
+    static DecodedImage decode(const char* path, const TextureOptions& options, bool use_cache);
+
+    /* Reads only the header for the size and the channel count decode will turn it into */
+    static bool read_info(const char* path, int& width, int& height, int& channels);
+
+    /* BC5 or RG8 for normal maps, otherwise BC3 with alpha and BC1 without, or 8 bit RGB(A) rows when not compressing */
+    static TextureFormat choose_format(const TextureOptions& options, int channels);
+
+    /*
+     * Narrows image to levels first_level to end_level - 1 without copying, data moves to the first one and their
+     * offsets follow it. The other levels stay in the chain empty, so a ring stages only what is left
+     */
+    static void keep_levels(DecodedImage& image, size_t first_level, size_t end_level);
+
+    /* Replaces the 8 bit RGB(A) chain in image with its levels in format, block compressed or red and green alone */
+    static void convert(DecodedImage& image, TextureFormat format);
+
+    static void flip_rows(unsigned char* pixels, int width, int height, int channels);
+
+    /* Fills every level after the first with a 2x2 box filter of the one above it */
+    static void build_mips(DecodedImage& image);
+
+};
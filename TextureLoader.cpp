@@ -0,0 +1,531 @@
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "TextureLoader.h"
+
+static const char* format_name(TextureFormat format) {
+    switch (format) {
+    case TEXTURE_FORMAT_RGB8:
+        return "RGB8";
+    case TEXTURE_FORMAT_RGBA8:
+        return "RGBA8";
+    case TEXTURE_FORMAT_BC1:
+        return "BC1";
+    case TEXTURE_FORMAT_BC3:
+        return "BC3";
+    case TEXTURE_FORMAT_BC5:
+        return "BC5";
+    default:
+        return "RG8";
+    }
+}
+
+static GLenum compressed_internal_format(TextureFormat format) {
+    switch (format) {
+    case TEXTURE_FORMAT_BC1:
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TEXTURE_FORMAT_BC3:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    default:
+        return GL_COMPRESSED_RG_RGTC2;
+    }
+}
+
+static bool is_compressed(TextureFormat format) {
+    return format != TEXTURE_FORMAT_RGB8 && format != TEXTURE_FORMAT_RGBA8 && format != TEXTURE_FORMAT_RG8;
+}
+
+/* Client and internal format of the uncompressed formats */
+static GLenum pixel_format(TextureFormat format) {
+    switch (format) {
+    case TEXTURE_FORMAT_RG8:
+        return GL_RG;
+    case TEXTURE_FORMAT_RGBA8:
+        return GL_RGBA;
+    default:
+        return GL_RGB;
+    }
+}
+
+/* The work step of every load, staging into the ring on the worker when one is free */
+static DecodedImage decode_and_stage(const std::string& path, const TextureOptions& options, bool use_cache, TextureUploadRing* ring) {
+    DecodedImage image = TextureDecoder::decode(path.c_str(), options, use_cache);
+    if (ring) {
+        ring->stage(image);
+    }
+    return image;
+}
+
+static bool fits_array(const TextureArray& array, const DecodedImage& image) {
+    return image.width == array.width && image.height == array.height && image.format == array.format &&
+        image.levels.size() == array.level_count;
+}
+
+static double ms_between(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+TextureLoader::TextureLoader(AssetStreamer& streamer, bool use_cache) : streamer(streamer) {
+    this->use_cache = use_cache;
+    this->compress_colors = false;
+    this->compress_normals = false;
+    this->start = std::chrono::steady_clock::now();
+    this->last_decoded = this->start;
+}
+
+TextureLoader::~TextureLoader() {
+    this->streamer.cancel();
+}
+
+void TextureLoader::enable_upload_ring() {
+    this->ring = std::make_unique<TextureUploadRing>();
+}
+
+void TextureLoader::pump() {
+    if (this->ring) {
+        this->ring->pump();
+    }
+}
+
+void TextureLoader::enable_compression(bool enabled) {
+    this->compress_colors = enabled && GLAD_GL_EXT_texture_compression_s3tc;
+    this->compress_normals = enabled && (GLAD_GL_VERSION_3_0 || GLAD_GL_ARB_texture_compression_rgtc);
+    if (enabled && !this->compress_colors) {
+        std::cout << "EXT_texture_compression_s3tc is missing, color textures load uncompressed" << std::endl;
+    }
+    if (enabled && !this->compress_normals) {
+        std::cout << "RGTC is missing, normal maps load as RG8" << std::endl;
+    }
+}
+
+TextureOptions TextureLoader::options_for(bool flip, bool mips, bool normal_map) const {
+    TextureOptions options;
+    options.flip = flip;
+    options.mips = mips;
+    options.normal_map = normal_map;
+    options.compress = normal_map ? this->compress_normals : this->compress_colors;
+    return options;
+}
+
+size_t TextureLoader::begin_texture(const std::string& path) {
+    TextureLoadStats entry;
+    entry.path = path;
+    entry.width = 0;
+    entry.height = 0;
+    entry.channels = 0;
+    entry.format = TEXTURE_FORMAT_RGB8;
+    entry.level_count = 0;
+    entry.from_cache = false;
+    entry.decode_ms = 0.0;
+    entry.cold_ms = 0.0;
+    entry.upload_ms = 0.0;
+    entry.from_ring = false;
+    entry.gpu_bytes = 0;
+    entry.raw_bytes = 0;
+    entry.failed = true;
+    this->stats.push_back(entry);
+    return this->stats.size() - 1;
+}
+
+bool TextureLoader::upload_levels(GLenum target, int layer, size_t first_level, size_t end_level, const DecodedImage& image, size_t& bytes) {
+    bytes = 0;
+
+    /* From a ring buffer the pointers below are offsets into it, the calls return before the driver has read them */
+    bool from_ring = image.upload_slot >= 0;
+    if (from_ring && !this->ring->bind(image)) {
+        return false;
+    }
+
+    bool compressed = is_compressed(image.format);
+    GLenum format = pixel_format(image.format);
+
+    /* RGB and RG rows of odd widths are not 4 byte aligned */
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t l = first_level; l < end_level && l < image.levels.size(); l++) {
+        const TextureLevel& level = image.levels[l];
+        const void* pixels = from_ring ? (const void*)(uintptr_t)level.offset : (const void*)(image.data + level.offset);
+        if (layer >= 0 && compressed) {
+            glCompressedTexSubImage3D(target, (GLint)l, 0, 0, layer, level.width, level.height, 1,
+                compressed_internal_format(image.format), (GLsizei)level.size, pixels);
+        } else if (layer >= 0) {
+            glTexSubImage3D(target, (GLint)l, 0, 0, layer, level.width, level.height, 1, format, GL_UNSIGNED_BYTE, pixels);
+        } else if (compressed) {
+            glCompressedTexImage2D(target, (GLint)l, compressed_internal_format(image.format), level.width, level.height, 0,
+                (GLsizei)level.size, pixels);
+        } else {
+            glTexImage2D(target, (GLint)l, format, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, pixels);
+        }
+        bytes += level.size;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (from_ring) {
+        this->ring->release(image);
+    }
+    return true;
+}
+
+void TextureLoader::discard(const DecodedImage& image) {
+    if (image.upload_slot >= 0 && this->ring->bind(image)) {
+        this->ring->release(image);
+    }
+}
+
+void TextureLoader::upload_image(size_t slot, GLenum target, int layer, size_t first_level, const DecodedImage& image) {
+    auto upload_start = std::chrono::steady_clock::now();
+    TextureLoadStats& entry = this->stats[slot];
+    entry.decode_ms = image.decode_ms;
+    this->last_decoded = std::max(this->last_decoded, image.decoded_time);
+    if (!image.data || !upload_levels(target, layer, first_level, image.levels.size(), image, entry.gpu_bytes)) {
+        return;
+    }
+    for (size_t l = first_level; l < image.levels.size(); l++) {
+        entry.raw_bytes += (size_t)image.levels[l].width * image.levels[l].height * image.channels;
+    }
+
+    entry.width = image.width;
+    entry.height = image.height;
+    entry.channels = image.channels;
+    entry.format = image.format;
+    entry.level_count = image.levels.size() - std::min(first_level, image.levels.size());
+    entry.from_cache = image.from_cache;
+    entry.cold_ms = image.cold_ms;
+    entry.from_ring = image.upload_slot >= 0;
+    entry.failed = false;
+    entry.upload_ms = ms_between(upload_start, std::chrono::steady_clock::now());
+}
+
+void TextureLoader::load_2d(const std::string& path, GLuint texture, bool flip, bool normal_map) {
+    size_t slot = begin_texture(path);
+    bool use_cache = this->use_cache;
+    TextureOptions options = options_for(flip, true, normal_map);
+    TextureUploadRing* ring = this->ring.get();
+
+    this->streamer.submit(path,
+        [path, options, use_cache, ring] { return decode_and_stage(path, options, use_cache, ring); },
+        [this, slot, texture](DecodedImage& image) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            upload_image(slot, GL_TEXTURE_2D, -1, 0, image);
+            if (image.data) {
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+            }
+        });
+}
+
+void TextureLoader::allocate_array(TextureArray& array) {
+    std::vector<TextureLevel> levels;
+    TextureCache::layout_levels(array.width, array.height, array.format, true, levels);
+    array.level_count = levels.size();
+    array.base_level = (int)levels.size();
+    array.resident_levels.assign(array.layer_count, (int)levels.size());
+    array.gpu_bytes = 0;
+
+    glGenTextures(1, &array.texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+}
+
+void TextureLoader::set_array_base(size_t index, int base_level) {
+    TextureArray& array = this->arrays[index];
+    base_level = std::min(std::max(base_level, 0), (int)array.level_count - 1);
+    if (base_level == array.base_level) {
+        return;
+    }
+
+    std::vector<TextureLevel> levels;
+    TextureCache::layout_levels(array.width, array.height, array.format, true, levels);
+    GLenum format = pixel_format(array.format);
+    bool grow = base_level < array.base_level;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+
+    /* Levels gained get storage for every layer, levels dropped give theirs back by being redefined empty */
+    for (int l = std::min(base_level, array.base_level); l < std::max(base_level, array.base_level); l++) {
+        const TextureLevel& level = levels[l];
+        size_t bytes = level.size * array.layer_count;
+        int width = grow ? level.width : 0, height = grow ? level.height : 0, layers = grow ? array.layer_count : 0;
+        if (is_compressed(array.format)) {
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, l, compressed_internal_format(array.format), width, height, layers, 0,
+                grow ? (GLsizei)bytes : 0, nullptr);
+        } else {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, l, format, width, height, layers, 0, format, GL_UNSIGNED_BYTE, nullptr);
+        }
+        array.gpu_bytes = grow ? array.gpu_bytes + bytes : array.gpu_bytes - bytes;
+    }
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, base_level);
+    array.base_level = base_level;
+    for (int& resident : array.resident_levels) {
+        resident = std::max(resident, base_level);
+    }
+}
+
+void TextureLoader::load_array(const std::vector<std::string>& paths, bool flip, int first_level, size_t split_bytes,
+    std::vector<TextureArraySlot>& slots) {
+    TextureOptions options = options_for(flip, true, false);
+    bool use_cache = this->use_cache;
+    TextureUploadRing* ring = this->ring.get();
+    size_t first_array = this->arrays.size();
+    std::vector<size_t> array_of(paths.size(), SIZE_MAX);
+    slots.assign(paths.size(), TextureArraySlot{ 0, 0 });
+
+    /* Bucketed by what the headers say, so every array is allocated before the first layer decodes */
+    for (size_t i = 0; i < paths.size(); i++) {
+        int width = 0, height = 0, channels = 0;
+        if (!TextureDecoder::read_info(paths[i].c_str(), width, height, channels)) {
+            std::cout << "Failed to load " << paths[i] << std::endl;
+            continue;
+        }
+
+        size_t a = first_array;
+        while (a < this->arrays.size() &&
+            !(this->arrays[a].width == width && this->arrays[a].height == height && this->arrays[a].channels == channels)) {
+            a++;
+        }
+        if (a == this->arrays.size()) {
+            TextureArray array;
+            array.texture = 0;
+            array.width = width;
+            array.height = height;
+            array.channels = channels;
+            array.format = TextureDecoder::choose_format(options, channels);
+            array.options = options;
+            array.level_count = 0;
+            array.base_level = 0;
+            array.layer_count = 0;
+            array.split_count = 1;
+            array.gpu_bytes = 0;
+            this->arrays.push_back(array);
+        }
+        array_of[i] = a;
+        slots[i].layer = this->arrays[a].layer_count++;
+        this->arrays[a].layer_paths.push_back(paths[i]);
+    }
+
+    /* Asked to, a size too large for split_bytes keeps its first share of layers and moves the rest into arrays of their own */
+    size_t bucket_end = this->arrays.size();
+    for (size_t a = first_array; a < bucket_end && split_bytes > 0; a++) {
+        std::vector<TextureLevel> levels;
+        TextureCache::layout_levels(this->arrays[a].width, this->arrays[a].height, this->arrays[a].format, true, levels);
+        size_t layer_bytes = 0;
+        for (const TextureLevel& level : levels) {
+            layer_bytes += level.size;
+        }
+
+        int layer_count = this->arrays[a].layer_count;
+        int fitting = (int)std::max<size_t>(1, split_bytes / layer_bytes);
+        if (layer_count <= fitting) {
+            continue;
+        }
+        int split_count = (layer_count + fitting - 1) / fitting;
+        int share = (layer_count + split_count - 1) / split_count;
+        split_count = (layer_count + share - 1) / share;
+
+        size_t first_part = this->arrays.size();
+        TextureArray part = this->arrays[a];
+        part.layer_count = 0;
+        part.split_count = split_count;
+        part.layer_paths.clear();
+        for (int s = 1; s < split_count; s++) {
+            this->arrays.push_back(part);
+        }
+        for (size_t i = 0; i < paths.size(); i++) {
+            if (array_of[i] == a && slots[i].layer >= share) {
+                array_of[i] = first_part + slots[i].layer / share - 1;
+                slots[i].layer = this->arrays[array_of[i]].layer_count++;
+                this->arrays[array_of[i]].layer_paths.push_back(paths[i]);
+            }
+        }
+        this->arrays[a].layer_count = share;
+        this->arrays[a].layer_paths.resize(share);
+        this->arrays[a].split_count = split_count;
+    }
+
+    for (size_t a = first_array; a < this->arrays.size(); a++) {
+        allocate_array(this->arrays[a]);
+        set_array_base(a, first_level);
+    }
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        size_t slot = begin_texture(paths[i]);
+        if (array_of[i] == SIZE_MAX) {
+            continue;
+        }
+
+        size_t a = array_of[i];
+        int layer = slots[i].layer;
+        slots[i].texture = this->arrays[a].texture;
+        std::string path = paths[i];
+
+        /* Only the levels allocated by the time it arrives are uploaded, a TextureResidency streams the finer ones in */
+        this->streamer.submit(path,
+            [path, options, use_cache, ring] { return decode_and_stage(path, options, use_cache, ring); },
+            [this, slot, a, layer, path](DecodedImage& image) {
+                TextureArray& array = this->arrays[a];
+                if (image.data && !fits_array(array, image)) {
+                    std::cout << path << " changed while loading and no longer fits its texture array" << std::endl;
+                    this->stats[slot].decode_ms = image.decode_ms;
+                    discard(image);
+                    return;
+                }
+                glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+                upload_image(slot, GL_TEXTURE_2D_ARRAY, layer, array.base_level, image);
+                if (!this->stats[slot].failed) {
+                    array.resident_levels[layer] = array.base_level;
+                }
+            });
+    }
+}
+
+void TextureLoader::load_layer_levels(size_t index, int layer, int first_level, int end_level, std::function<void(size_t)> done) {
+    const TextureArray& array = this->arrays[index];
+    std::string path = array.layer_paths[layer];
+    TextureOptions options = array.options;
+    bool use_cache = this->use_cache;
+    TextureUploadRing* ring = this->ring.get();
+
+    /* Not part of loading the scene, the residency reports these itself. The rest of the chain stays in the mapped cache file */
+    this->streamer.submit_background(
+        [path, options, use_cache, ring, first_level, end_level] {
+            DecodedImage image = TextureDecoder::decode(path.c_str(), options, use_cache);
+            TextureDecoder::keep_levels(image, first_level, end_level);
+            if (ring) {
+                ring->stage(image);
+            }
+            return image;
+        },
+        [this, index, layer, first_level, end_level, done](DecodedImage& image) {
+            TextureArray& array = this->arrays[index];
+            if (!image.data || !fits_array(array, image)) {
+                discard(image);
+                done(0);
+                return;
+            }
+
+            /* Levels dropped while this was loading are skipped, the rest continue the layer's resident chain */
+            int first = std::max(first_level, array.base_level);
+            size_t bytes = 0;
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+            if (upload_levels(GL_TEXTURE_2D_ARRAY, layer, first, end_level, image, bytes) &&
+                first < end_level && end_level >= array.resident_levels[layer]) {
+                array.resident_levels[layer] = std::min(array.resident_levels[layer], first);
+            }
+            done(bytes);
+        });
+}
+
+bool TextureLoader::streams_levels() const {
+    return this->use_cache;
+}
+
+size_t TextureLoader::array_count() const {
+    return this->arrays.size();
+}
+
+const TextureArray& TextureLoader::array(size_t index) const {
+    return this->arrays[index];
+}
+
+size_t TextureLoader::find_array(GLuint texture) const {
+    for (size_t a = 0; a < this->arrays.size(); a++) {
+        if (this->arrays[a].texture == texture) {
+            return a;
+        }
+    }
+    return SIZE_MAX;
+}
+
+void TextureLoader::load_cube_face(const std::string& path, GLuint texture, unsigned int face, bool flip) {
+    size_t slot = begin_texture(path);
+    bool use_cache = this->use_cache;
+    TextureOptions options = options_for(flip, false, false);
+    TextureUploadRing* ring = this->ring.get();
+
+    this->streamer.submit(path,
+        [path, options, use_cache, ring] { return decode_and_stage(path, options, use_cache, ring); },
+        [this, slot, texture, face](DecodedImage& image) {
+            glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+            upload_image(slot, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, -1, 0, image);
+        });
+}
+
+void TextureLoader::print_report() {
+    double decode_ms = 0.0, upload_ms = 0.0;
+    double warm_ms = 0.0, warm_cold_ms = 0.0, cold_ms = 0.0;
+    size_t warm_count = 0, cold_count = 0;
+    size_t gpu_bytes = 0, raw_bytes = 0;
+    size_t compressed_count = 0, compressed_bytes = 0, compressed_raw_bytes = 0;
+
+    std::cout << "Textures\n";
+    for (const TextureLoadStats& entry : this->stats) {
+        decode_ms += entry.decode_ms;
+        upload_ms += entry.upload_ms;
+        gpu_bytes += entry.gpu_bytes;
+        raw_bytes += entry.raw_bytes;
+        if (entry.gpu_bytes < entry.raw_bytes) {
+            compressed_count++;
+            compressed_bytes += entry.gpu_bytes;
+            compressed_raw_bytes += entry.raw_bytes;
+        }
+        if (entry.from_cache) {
+            warm_count++;
+            warm_ms += entry.decode_ms;
+            warm_cold_ms += entry.cold_ms;
+        } else if (!entry.failed) {
+            cold_count++;
+            cold_ms += entry.decode_ms;
+        }
+
+        char line[256];
+        snprintf(line, sizeof(line), "  %-28s %5d x %-5d %dch %-5s %2zu levels  %-7s %7.1f ms (cold %7.1f ms)  upload %6.2f ms %-6s  %7.2f MB%s\n",
+            entry.path.c_str(), entry.width, entry.height, entry.channels, format_name(entry.format), entry.level_count,
+            entry.from_cache ? "cache" : "decoded", entry.decode_ms, entry.from_cache ? entry.cold_ms : entry.decode_ms,
+            entry.upload_ms, entry.from_ring ? "ring" : "client", entry.gpu_bytes / (1024.0 * 1024.0), entry.failed ? "  FAILED" : "");
+        std::cout << line;
+    }
+
+    char summary[256];
+    if (warm_count > 0) {
+        snprintf(summary, sizeof(summary), "  %zu from the cache in %.1f ms, %.1f ms to decode, build mips and compress them cold (%.1fx)\n",
+            warm_count, warm_ms, warm_cold_ms, warm_ms > 0.0 ? warm_cold_ms / warm_ms : 0.0);
+        std::cout << summary;
+    }
+    if (cold_count > 0) {
+        snprintf(summary, sizeof(summary), "  %zu decoded with their mips in %.1f ms\n", cold_count, cold_ms);
+        std::cout << summary;
+    }
+
+    for (const TextureArray& array : this->arrays) {
+        char split[64] = "";
+        if (array.split_count > 1) {
+            snprintf(split, sizeof(split), ", size split over %d arrays to fit the budget", array.split_count);
+        }
+        snprintf(summary, sizeof(summary), "  array %5d x %-5d %-5s levels %d to %zu of %2d layers, %.2f MB, one bind for its layers%s\n",
+            array.width, array.height, format_name(array.format), array.base_level, array.level_count - 1, array.layer_count,
+            array.gpu_bytes / (1024.0 * 1024.0), split);
+        std::cout << summary;
+    }
+    if (compressed_count > 0) {
+        snprintf(summary, sizeof(summary), "  %zu block compressed or two channel, %.2f MB instead of %.2f MB, %.2f MB of VRAM saved (%.1fx smaller)\n",
+            compressed_count, compressed_bytes / (1024.0 * 1024.0), compressed_raw_bytes / (1024.0 * 1024.0),
+            (compressed_raw_bytes - compressed_bytes) / (1024.0 * 1024.0), (double)compressed_raw_bytes / compressed_bytes);
+        std::cout << summary;
+    }
+
+    if (this->ring) {
+        snprintf(summary, sizeof(summary), "  upload ring of %d x %.0f MB buffers: %zu staged on workers, %zu found every buffer busy, %zu buffers recycled\n",
+            TextureUploadRing::SLOT_COUNT, TextureUploadRing::SLOT_BYTES / (1024.0 * 1024.0), this->ring->staged_count(),
+            this->ring->busy_count(), this->ring->recycled_count());
+        std::cout << summary;
+    }
+
+    /* Decodes overlap on the pool, so their sum is longer than the time it took for the last one to finish */
+    snprintf(summary, sizeof(summary), "  %zu textures, %.1f ms on workers done %.1f ms after loading started, %.1f ms of uploads, %.2f MB (%.2f MB uncompressed)\n",
+        this->stats.size(), decode_ms, ms_between(this->start, this->last_decoded), upload_ms, gpu_bytes / (1024.0 * 1024.0),
+        raw_bytes / (1024.0 * 1024.0));
+    std::cout << summary << std::flush;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AssetStreamer.h"
+#include "TextureDecoder.h"
+#include "TextureUploadRing.h"
+
+/* One row of the texture report */
+struct TextureLoadStats {
+    std::string path;
+    int width, height, channels;
+    TextureFormat format;
+    size_t level_count;
+    bool from_cache;
+    double decode_ms; // on a worker, reading the cache or decoding
+    double cold_ms; // decoding and building mips, as measured when the cache file was written
+    double upload_ms; // on the GL thread
+    bool from_ring; // staged into a TextureUploadRing buffer on its worker, uploaded from there
+    size_t gpu_bytes; // every level uploaded
+    size_t raw_bytes; // the same levels as 8 bit rows, what gpu_bytes would be without compression
+    bool failed;
+};
+
+/* Where one texture of load_array went */
+struct TextureArraySlot {
+    GLuint texture; // GL_TEXTURE_2D_ARRAY, 0 when the file could not be read
+    int layer;
+};
+
+/* One GL_TEXTURE_2D_ARRAY, every layer has the same size, format and mip chain */
+struct TextureArray {
+    GLuint texture;
+    int width, height, channels;
+    TextureFormat format;
+    TextureOptions options;
+    size_t level_count; // of the full chain
+    int base_level; // finest level with storage, GL_TEXTURE_BASE_LEVEL
+    int layer_count;
+    int split_count; // arrays its size went into, more than 1 only when load_array had to fit a budget
+    std::vector<std::string> layer_paths;
+    std::vector<int> resident_levels; // finest level uploaded for each layer, every coarser one is too. level_count before the first
+    size_t gpu_bytes; // every level with storage, for every layer
+};
+
+/*
+ * Streams textures in through an AssetStreamer. Every image is decoded by TextureDecoder on the streamer's
+ * pool, so all of them decode at once, and every level of its mip chain is uploaded on the GL thread as it
+ * finishes. With the texture cache warm nothing is decoded and the GPU generates no mips. Once compression
+ * is enabled the levels are BC1, BC3 or BC5 blocks wherever the driver can sample them. Normal maps keep red
+ * and green alone either way, as RG8 where they are not BC5.
+ */
+class TextureLoader {
+
+public:
+
+    TextureLoader(AssetStreamer& streamer, bool use_cache);
+
+    /* Cancels the streamer's work first, it may still be staging into the upload ring */
+    ~TextureLoader();
+
+    TextureLoader(const TextureLoader&) = delete;
+
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    /* Needs a current context, checks which of the compressed formats it has. Textures load as 8 bit rows until then */
+    void enable_compression(bool enabled);
+
+    /* Needs a current context. Textures loaded from then on upload from a TextureUploadRing instead of client memory */
+    void enable_upload_ring();
+
+    /* GL thread, once per frame. Recycles upload buffers the driver is done with */
+    void pump();
+
+    /* Fills texture with path and a full mip chain. flip turns the rows bottom up for GL, normal maps keep only red and green */
+    void load_2d(const std::string& path, GLuint texture, bool flip, bool normal_map);
+
+    /*
+     * Packs the textures in paths into GL_TEXTURE_2D_ARRAYs, one array for each size and channel count among them. Only
+     * their headers are read here to allocate the arrays from first_level down, the layers stream in like load_2d does.
+     * A size whose whole mip chain for every layer is over split_bytes is split evenly into the fewest arrays that each
+     * fit, 0 never splits. slots receives the array and layer of every path
+     */
+    void load_array(const std::vector<std::string>& paths, bool flip, int first_level, size_t split_bytes,
+        std::vector<TextureArraySlot>& slots);
+
+    size_t array_count() const;
+
+    const TextureArray& array(size_t index) const;
+
+    /* Index of the array with this texture name, SIZE_MAX when there is none */
+    size_t find_array(GLuint texture) const;
+
+    /* Gives every level from base_level down storage, or frees the levels finer than it, and makes it GL_TEXTURE_BASE_LEVEL */
+    void set_array_base(size_t index, int base_level);
+
+    /*
+     * Streams levels first_level to end_level - 1 of one layer in again, through the texture cache, staging only those.
+     * done(bytes) runs on the GL thread once they are uploaded, with 0 when loading failed or the levels were freed in the meantime
+     */
+    void load_layer_levels(size_t index, int layer, int first_level, int end_level, std::function<void(size_t)> done);
+
+    /* Whether load_layer_levels reads levels out of the texture cache. Without it every call decodes and compresses the whole image */
+    bool streams_levels() const;
+
+    /* Fills one face of a cube map without mips, face counts from GL_TEXTURE_CUBE_MAP_POSITIVE_X */
+    void load_cube_face(const std::string& path, GLuint texture, unsigned int face, bool flip);
+
+    void print_report();
+
+private:
+
+    AssetStreamer& streamer;
+    bool use_cache;
+    bool compress_colors; // EXT_texture_compression_s3tc, BC1 and BC3
+    bool compress_normals; // RGTC, BC5
+    std::unique_ptr<TextureUploadRing> ring;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point last_decoded;
+    std::vector<TextureLoadStats> stats;
+    std::vector<TextureArray> arrays;
+
+    size_t begin_texture(const std::string& path);
+
+    TextureOptions options_for(bool flip, bool mips, bool normal_map) const;
+
+    /* Creates the texture of array without storage for any level, its size and format are set already */
+    void allocate_array(TextureArray& array);
+
+    /* Uploads levels first_level to end_level - 1 of image into target of the bound texture, or into layer of the bound array when layer is not negative */
+    bool upload_levels(GLenum target, int layer, size_t first_level, size_t end_level, const DecodedImage& image, size_t& bytes);
+
+    /* upload_levels from first_level to the end of the chain, recorded into its stats slot */
+    void upload_image(size_t slot, GLenum target, int layer, size_t first_level, const DecodedImage& image);
+
+    /* Hands the ring buffer of an image that will not be uploaded back */
+    void discard(const DecodedImage& image);
+
+};
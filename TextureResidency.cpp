@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#include "TextureLoader.h"
+#include "TextureResidency.h"
+
+TextureResidency::TextureResidency(TextureLoader& loader, size_t budget_bytes) : loader(loader) {
+    this->budget_bytes = budget_bytes;
+    this->frame = 0;
+    this->frame_streamed_bytes = 0;
+    this->frame_evicted_bytes = 0;
+    this->streamed_bytes = 0;
+    this->evicted_bytes = 0;
+    this->level_loads = 0;
+    this->peak_resident_bytes = 0;
+    this->peak_frame_streamed_bytes = 0;
+    this->peak_frame_evicted_bytes = 0;
+    this->frames_over_budget = 0;
+}
+
+float TextureResidency::request(GLuint texture, int layer, float screen_pixels) {
+    size_t index = this->loader.find_array(texture);
+    if (index == SIZE_MAX) {
+        return 0.0f;
+    }
+    const TextureArray& array = this->loader.array(index);
+    while (this->states.size() < this->loader.array_count()) {
+        ArrayState state;
+        const TextureArray& added = this->loader.array(this->states.size());
+        state.wanted_levels.assign(added.layer_count, (int)added.level_count);
+        state.loading.assign(added.layer_count, false);
+        state.level_used_frames.assign(added.level_count, 0);
+        this->states.push_back(state);
+    }
+
+    /* The texture is taken to span the model once, so a level as wide as the pixels it covers is the finest one needed */
+    int last_level = (int)array.level_count - 1;
+    int level = screen_pixels > 0.0f ? (int)std::floor(std::log2(std::max(array.width, array.height) / screen_pixels)) : last_level;
+    level = std::min(std::max(level, 0), last_level);
+
+    ArrayState& state = this->states[index];
+    state.wanted_levels[layer] = std::min(state.wanted_levels[layer], level);
+    for (int l = level; l <= last_level; l++) {
+        state.level_used_frames[l] = this->frame;
+    }
+
+    return (float)std::min(std::max(array.resident_levels[layer], array.base_level), last_level) - array.base_level;
+}
+
+size_t TextureResidency::evict_one(size_t keep) {
+    size_t oldest = SIZE_MAX;
+    for (size_t a = 0; a < this->states.size(); a++) {
+        const TextureArray& array = this->loader.array(a);
+        if (a == keep || array.base_level + 1 >= (int)array.level_count) {
+            continue;
+        }
+        size_t used = this->states[a].level_used_frames[array.base_level];
+        if (used < this->frame && (oldest == SIZE_MAX || used < this->states[oldest].level_used_frames[this->loader.array(oldest).base_level])) {
+            oldest = a;
+        }
+    }
+    if (oldest == SIZE_MAX) {
+        return 0;
+    }
+
+    size_t before = this->loader.array(oldest).gpu_bytes;
+    this->loader.set_array_base(oldest, this->loader.array(oldest).base_level + 1);
+    size_t freed = before - this->loader.array(oldest).gpu_bytes;
+    this->frame_evicted_bytes += freed;
+    this->evicted_bytes += freed;
+    return freed;
+}
+
+void TextureResidency::update() {
+    bool streams = this->loader.streams_levels();
+    for (size_t a = 0; a < this->states.size(); a++) {
+        ArrayState& state = this->states[a];
+        const TextureArray& array = this->loader.array(a);
+        int wanted = streams ? *std::min_element(state.wanted_levels.begin(), state.wanted_levels.end()) : array.base_level;
+
+        /* Finer levels get storage only when it fits, making room from other arrays first and settling for less otherwise */
+        int base = array.base_level;
+        while (wanted < base) {
+            size_t needed = TextureCache::level_size(std::max(1, array.width >> (base - 1)), std::max(1, array.height >> (base - 1)),
+                array.format) * array.layer_count;
+            while (resident_bytes() + needed > this->budget_bytes && evict_one(a) > 0) {
+            }
+            if (resident_bytes() + needed > this->budget_bytes) {
+                break;
+            }
+            base--;
+        }
+        this->loader.set_array_base(a, base);
+
+        /* Layers stream the levels between what they hold and what was wanted, ones still waiting for their first upload get those with it */
+        for (int layer = 0; layer < array.layer_count; layer++) {
+            int resident = array.resident_levels[layer];
+            int first = std::max(state.wanted_levels[layer], array.base_level);
+            if (streams && !state.loading[layer] && resident < (int)array.level_count && first < resident) {
+                state.loading[layer] = true;
+                this->level_loads++;
+                this->loader.load_layer_levels(a, layer, first, resident, [this, a, layer](size_t bytes) {
+                    this->states[a].loading[layer] = false;
+                    this->frame_streamed_bytes += bytes;
+                    this->streamed_bytes += bytes;
+                });
+            }
+            state.wanted_levels[layer] = (int)array.level_count;
+        }
+    }
+
+    /* Still over, eg. after the first loads, levels not drawn this frame go */
+    while (resident_bytes() > this->budget_bytes && evict_one(SIZE_MAX) > 0) {
+    }
+
+    size_t resident = resident_bytes();
+    this->peak_resident_bytes = std::max(this->peak_resident_bytes, resident);
+    this->peak_frame_streamed_bytes = std::max(this->peak_frame_streamed_bytes, this->frame_streamed_bytes);
+    this->peak_frame_evicted_bytes = std::max(this->peak_frame_evicted_bytes, this->frame_evicted_bytes);
+    if (resident > this->budget_bytes) {
+        this->frames_over_budget++;
+    }
+
+    /* Levels streamed in count towards the frame whose pump uploaded them */
+    this->frame_streamed_bytes = 0;
+    this->frame_evicted_bytes = 0;
+    this->frame++;
+}
+
+size_t TextureResidency::resident_bytes() const {
+    size_t bytes = 0;
+    for (size_t a = 0; a < this->loader.array_count(); a++) {
+        bytes += this->loader.array(a).gpu_bytes;
+    }
+    return bytes;
+}
+
+void TextureResidency::print_report() {
+    std::cout << "Texture residency\n";
+    for (size_t a = 0; a < this->loader.array_count(); a++) {
+        const TextureArray& array = this->loader.array(a);
+        char line[256];
+        snprintf(line, sizeof(line), "  array %5d x %-5d levels %d to %zu resident, %.2f MB\n",
+            array.width, array.height, array.base_level, array.level_count - 1, array.gpu_bytes / (1024.0 * 1024.0));
+        std::cout << line;
+    }
+
+    char summary[256];
+    snprintf(summary, sizeof(summary), "  %.2f of %.2f MB resident, peak %.2f MB, %zu of %zu frames over budget\n",
+        resident_bytes() / (1024.0 * 1024.0), this->budget_bytes / (1024.0 * 1024.0), this->peak_resident_bytes / (1024.0 * 1024.0),
+        this->frames_over_budget, this->frame);
+    std::cout << summary;
+
+    snprintf(summary, sizeof(summary), "  %zu level loads streamed %.2f MB in (%.1f KB per frame, peak %.1f KB), %.2f MB evicted (peak %.1f KB per frame)\n",
+        this->level_loads, this->streamed_bytes / (1024.0 * 1024.0),
+        this->frame > 0 ? this->streamed_bytes / 1024.0 / this->frame : 0.0, this->peak_frame_streamed_bytes / 1024.0,
+        this->evicted_bytes / (1024.0 * 1024.0), this->peak_frame_evicted_bytes / 1024.0);
+    std::cout << summary;
+
+    if (!this->loader.streams_levels()) {
+        std::cout << "  no texture cache, levels were only dropped, streaming them back in would decode every image again\n";
+    }
+    std::cout << std::flush;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+class TextureLoader;
+
+/*
+ * Keeps the texture arrays of a TextureLoader within a VRAM budget. Every draw requests the mip level its
+ * model needs for the pixels it covers, once per frame update() streams finer levels in through the texture
+ * cache for layers drawn closer than what they hold, and when that would go over budget drops the finest
+ * level of the arrays used longest ago. Levels are allocated for every layer of an array at once, so the
+ * budget is kept per array and level. An array keeps a level while any of its layers wants it and it fits,
+ * layers drawn further away or whose finer levels have not arrived yet are clamped in the shader and stream
+ * nothing finer. The LRU picks between arrays, a size that cannot fit whole is only split when load_array is asked to.
+ * Without the texture cache a level load would decode and compress the whole image, so levels are only dropped.
+ */
+class TextureResidency {
+
+public:
+
+    /* The fauna array with its whole mip chain as BC1, or down to level 1 when it is uploaded uncompressed */
+    static constexpr size_t DEFAULT_BUDGET_BYTES = 16 * 1024 * 1024;
+
+    /* Level arrays are first loaded from, a quarter of the full size on each side */
+    static const int START_LEVEL = 2;
+
+    TextureResidency(TextureLoader& loader, size_t budget_bytes);
+
+    /*
+     * For every draw sampling layer of texture over screen_pixels across. Returns the level relative to the array's
+     * base level that sampling must not go below, the finest one the layer holds
+     */
+    float request(GLuint texture, int layer, float screen_pixels);
+
+    /* GL thread, once per frame after the draws. Evicts and streams levels for the requests made since the last one */
+    void update();
+
+    size_t resident_bytes() const;
+
+    void print_report();
+
+private:
+
+    struct ArrayState {
+        std::vector<int> wanted_levels; // finest level requested for each layer this frame
+        std::vector<bool> loading; // layers with levels streaming in
+        std::vector<size_t> level_used_frames; // last frame each level was requested by any layer
+    };
+
+    TextureLoader& loader;
+    size_t budget_bytes;
+    std::vector<ArrayState> states; // by array index
+    size_t frame;
+
+    size_t frame_streamed_bytes;
+    size_t frame_evicted_bytes;
+    size_t streamed_bytes;
+    size_t evicted_bytes;
+    size_t level_loads;
+    size_t peak_resident_bytes;
+    size_t peak_frame_streamed_bytes;
+    size_t peak_frame_evicted_bytes;
+    size_t frames_over_budget;
+
+    /* Drops the finest level of the array whose finest level was used longest ago, skipping keep and levels used this frame. Returns the bytes freed */
+    size_t evict_one(size_t keep);
+
+};
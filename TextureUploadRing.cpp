@@ -0,0 +1,169 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "TextureUploadRing.h"
+
+TextureUploadRing::TextureUploadRing() {
+    this->staged = 0;
+    this->busy = 0;
+    this->recycled = 0;
+
+    this->slots.resize(SLOT_COUNT);
+    for (Slot& slot : this->slots) {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, SLOT_BYTES, nullptr, GL_STREAM_DRAW);
+        slot.fence = nullptr;
+        slot.generation = 0;
+        map(slot);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+/* A ring still around when the window is gone goes down with the context instead */
+TextureUploadRing::~TextureUploadRing() {
+    if (glfwGetCurrentContext() == nullptr) {
+        return;
+    }
+    for (Slot& slot : this->slots) {
+        if (slot.fence) {
+            glDeleteSync(slot.fence);
+        }
+        if (slot.mapped) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        glDeleteBuffers(1, &slot.buffer);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void TextureUploadRing::map(Slot& slot) {
+    /* Invalidating lets the driver hand back fresh memory instead of syncing on what the buffer held */
+    slot.mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, SLOT_BYTES, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    slot.state = slot.mapped ? SLOT_FREE : SLOT_IN_FLIGHT;
+    if (!slot.mapped) {
+        std::cout << "Could not map texture upload buffer " << slot.buffer << std::endl;
+    }
+}
+
+bool TextureUploadRing::stage(DecodedImage& image) {
+    if (!image.data || image.levels.empty()) {
+        return false;
+    }
+    /* Up to the end of the last level holding anything, an image narrowed by keep_levels stages only what it kept */
+    size_t bytes = 0;
+    for (const TextureLevel& level : image.levels) {
+        bytes = std::max(bytes, level.offset + level.size);
+    }
+
+    int index = -1;
+    unsigned int generation = 0;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        for (size_t i = 0; i < this->slots.size() && bytes <= SLOT_BYTES; i++) {
+            if (this->slots[i].state == SLOT_FREE) {
+                this->slots[i].state = SLOT_STAGED;
+                generation = ++this->slots[i].generation;
+                index = (int)i;
+                break;
+            }
+        }
+        if (index < 0) {
+            this->busy++;
+            return false;
+        }
+        this->staged++;
+    }
+
+    /* The mapping stays put until the GL thread unmaps it in bind(), after this image is handed over */
+    unsigned char* mapped = this->slots[index].mapped;
+    memcpy(mapped, image.data, bytes);
+    image.data = mapped;
+    image.upload_slot = index;
+    image.upload_lease = std::shared_ptr<void>(nullptr, [this, index, generation](void*) { unstage(index, generation); });
+    image.storage.clear();
+    image.storage.shrink_to_fit();
+    image.file.reset();
+    return true;
+}
+
+bool TextureUploadRing::bind(const DecodedImage& image) {
+    Slot& slot = this->slots[image.upload_slot];
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+
+    /* False means the contents were lost while mapped, eg. to a mode switch */
+    bool intact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+    std::lock_guard<std::mutex> lock(this->mutex);
+    slot.mapped = nullptr;
+    slot.state = SLOT_IN_FLIGHT;
+    if (!intact) {
+        std::cout << "Texture upload buffer " << slot.buffer << " lost its contents" << std::endl;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    return intact;
+}
+
+void TextureUploadRing::release(const DecodedImage& image) {
+    Slot& slot = this->slots[image.upload_slot];
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void TextureUploadRing::pump() {
+    bool bound = false;
+    for (Slot& slot : this->slots) {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (slot.state != SLOT_IN_FLIGHT) {
+                continue;
+            }
+        }
+
+        /* Polled without waiting, a buffer the driver still reads from is tried again next frame */
+        if (slot.fence) {
+            GLenum status = glClientWaitSync(slot.fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+                continue;
+            }
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        bound = true;
+        std::lock_guard<std::mutex> lock(this->mutex);
+        map(slot);
+        this->recycled++;
+    }
+    if (bound) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+}
+
+void TextureUploadRing::unstage(int index, unsigned int generation) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    Slot& slot = this->slots[index];
+    if (slot.state == SLOT_STAGED && slot.generation == generation) {
+        slot.state = SLOT_FREE;
+    }
+}
+
+size_t TextureUploadRing::staged_count() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->staged;
+}
+
+size_t TextureUploadRing::busy_count() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->busy;
+}
+
+size_t TextureUploadRing::recycled_count() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->recycled;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "TextureCache.h"
+
+/*
+ * Ring of pixel unpack buffers that texture levels stream through. Free buffers stay mapped, so a loader thread
+ * copies a finished image straight into one instead of the GL thread copying it at upload time. The GL thread
+ * unmaps it and points glTex(Sub)Image at buffer offsets, the driver then transfers it while rendering goes on.
+ * A fence after the upload tells pump() when the buffer can be mapped and handed out again.
+ */
+class TextureUploadRing {
+
+public:
+
+    static const int SLOT_COUNT = 8;
+
+    /* Fits a 1024x1024 RGB mip chain, the largest texture the scene uploads uncompressed */
+    static constexpr size_t SLOT_BYTES = 4 * 1024 * 1024;
+
+    /* GL thread, creates and maps every buffer */
+    TextureUploadRing();
+
+    ~TextureUploadRing();
+
+    TextureUploadRing(const TextureUploadRing&) = delete;
+
+    TextureUploadRing& operator=(const TextureUploadRing&) = delete;
+
+    /*
+     * Any thread. Copies every level of image into a free buffer and points image.data into it, the client copy is
+     * released. False when all buffers are busy or image is too big, image is left as it was. An image dropped
+     * without reaching bind(), eg. when its upload is cancelled, frees the buffer again through image.upload_lease
+     */
+    bool stage(DecodedImage& image);
+
+    /* GL thread. Unmaps the buffer image was staged into and binds it to GL_PIXEL_UNPACK_BUFFER, level offsets become buffer offsets */
+    bool bind(const DecodedImage& image);
+
+    /* GL thread, after the uploads reading from the bound buffer. Fences it and unbinds it */
+    void release(const DecodedImage& image);
+
+    /* GL thread, once per frame. Maps the buffers whose uploads have finished again */
+    void pump();
+
+    size_t staged_count() const;
+
+    size_t busy_count() const; // images that found no free buffer and uploaded from client memory
+
+    size_t recycled_count() const;
+
+private:
+
+    enum SlotState {
+        SLOT_FREE, // mapped, waiting for an image
+        SLOT_STAGED, // mapped and holding an image until its upload
+        SLOT_IN_FLIGHT // unmapped, read by the driver until its fence passes
+    };
+
+    struct Slot {
+        GLuint buffer;
+        unsigned char* mapped;
+        GLsync fence;
+        SlotState state;
+        unsigned int generation; // counts the images staged into it, so a stale lease cannot free a later one
+    };
+
+    mutable std::mutex mutex;
+    std::vector<Slot> slots;
+    size_t staged;
+    size_t busy;
+    size_t recycled;
+
+    /* GL thread, buffer bound to GL_PIXEL_UNPACK_BUFFER */
+    void map(Slot& slot);
+
+    /* Any thread. Frees a slot still holding the image of this generation, it is still mapped */
+    void unstage(int index, unsigned int generation);
+
+};
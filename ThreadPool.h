@@ -0,0 +1,127 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* Fixed size pool of worker threads. Work is submitted as callables and results come back as futures */
+class ThreadPool {
+
+public:
+
+    /* Defaults to one worker per hardware thread */
+    explicit ThreadPool(unsigned int thread_count = 0) {
+        if (thread_count == 0) {
+            thread_count = std::thread::hardware_concurrency();
+        }
+        if (thread_count == 0) {
+            thread_count = 1;
+        }
+
+        for (unsigned int i = 0; i < thread_count; i++) {
+            this->workers.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(this->queue_mutex);
+            this->stopping = true;
+        }
+        this->queue_condition.notify_all();
+
+        for (std::thread& worker : this->workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template <typename F>
+    std::future<typename std::invoke_result<F>::type> submit(F&& task) {
+        using Result = typename std::invoke_result<F>::type;
+
+        /* packaged_task is move only, std::function needs something copyable */
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packaged->get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(this->queue_mutex);
+            this->tasks.emplace([packaged] { (*packaged)(); });
+        }
+        this->queue_condition.notify_one();
+
+        return result;
+    }
+
+    unsigned int size() const {
+        return (unsigned int)this->workers.size();
+    }
+
+    /*
+     * Shared by every job that splits itself into parallel pieces. It is separate from the pool the scene meshes
+     * are loaded on, so a loader thread waiting for its pieces never holds up the workers running them.
+     */
+    static ThreadPool& shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    /* Runs work(0) to work(count - 1) on the pool and waits for all of them, or runs them inline without a pool */
+    template <typename F>
+    static void for_each(ThreadPool* pool, size_t count, F work) {
+        if (pool == nullptr || count < 2) {
+            for (size_t i = 0; i < count; i++) {
+                work(i);
+            }
+            return;
+        }
+
+        std::vector<std::future<void>> done;
+        done.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            done.push_back(pool->submit([&work, i] { work(i); }));
+        }
+        for (std::future<void>& piece_done : done) {
+            piece_done.get();
+        }
+    }
+
+private:
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queue_mutex;
+    std::condition_variable queue_condition;
+    bool stopping = false;
+
+    void worker_loop() {
+        while (true) {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(this->queue_mutex);
+                this->queue_condition.wait(lock, [this] { return this->stopping || !this->tasks.empty(); });
+
+                if (this->stopping && this->tasks.empty()) {
+                    return;
+                }
+
+                task = std::move(this->tasks.front());
+                this->tasks.pop();
+            }
+
+            task();
+        }
+    }
+
+};
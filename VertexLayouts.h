@@ -0,0 +1,316 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/* How Model3D lays out its vertex buffer on the GPU */
+enum VertexFormat {
+    VERTEX_FORMAT_FLOAT, // 8 or 14 floats, exactly what MeshLoader builds
+    VERTEX_FORMAT_COMPACT, // float positions, 2_10_10_10 normals and tangents, 16 bit uvs
+    VERTEX_FORMAT_COMPACT_POSITIONS // as compact, with 16 bit positions scaled by the mesh bounds
+};
+
+/* Everything needed to bind and draw a packed buffer once the bytes themselves are gone */
+struct VertexLayout {
+    VertexFormat format;
+    bool has_tangents;
+    unsigned int stride; // bytes per vertex on the GPU
+    unsigned int float_stride; // bytes per vertex in the float layout it was packed from
+    GLenum uv_type; // GL_UNSIGNED_SHORT normalized when every uv is in [0, 1], GL_HALF_FLOAT within [-1, 1], else GL_FLOAT
+    glm::vec3 position_min; // positionMin uniform, zero unless positions are quantized
+    glm::vec3 position_extent; // positionExtent uniform, one unless positions are quantized
+};
+
+/* Shader locations, fixed by main.vert and normalmap.vert */
+enum VertexAttribute {
+    VERTEX_ATTRIBUTE_POSITION,
+    VERTEX_ATTRIBUTE_NORMAL,
+    VERTEX_ATTRIBUTE_UV,
+    VERTEX_ATTRIBUTE_TANGENT,
+    VERTEX_ATTRIBUTE_BITANGENT,
+    VERTEX_ATTRIBUTE_COUNT
+};
+
+/* One vertex read back from any layout the way GL would see it, by shader location */
+struct DecodedVertex {
+    glm::vec4 attributes[VERTEX_ATTRIBUTE_COUNT];
+};
+
+/*
+ * Vertex attributes. Each one names its shader location, its GL type, its size in the vertex and how many
+ * floats of MeshLoader's float vertex it reads, and packs itself from that float vertex and decodes itself back.
+ * The float vertex is position, normal, uv, then tangent and bitangent when normal mapped.
+ */
+
+/* COUNT floats copied as they are from float FIRST of the source vertex */
+template <VertexAttribute ATTRIBUTE, unsigned int FIRST, int COUNT>
+struct FloatAttribute {
+    static constexpr GLuint LOCATION = ATTRIBUTE;
+    static constexpr GLint COMPONENTS = COUNT;
+    static constexpr GLenum TYPE = GL_FLOAT;
+    static constexpr GLboolean NORMALIZED = GL_FALSE;
+    static constexpr unsigned int SIZE = COUNT * sizeof(GLfloat);
+    static constexpr unsigned int SOURCE_FIRST = FIRST;
+    static constexpr unsigned int SOURCE_FLOATS = FIRST + COUNT;
+
+    static void pack(const GLfloat* vertex, unsigned char* out, const VertexLayout&) {
+        memcpy(out, vertex + FIRST, SIZE);
+    }
+
+    static void decode(const unsigned char* in, const VertexLayout&, DecodedVertex& decoded) {
+        GLfloat values[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        memcpy(values, in, SIZE);
+        decoded.attributes[ATTRIBUTE] = glm::vec4(values[0], values[1], values[2], values[3]);
+    }
+};
+
+typedef FloatAttribute<VERTEX_ATTRIBUTE_POSITION, 0, 3> Position;
+typedef FloatAttribute<VERTEX_ATTRIBUTE_NORMAL, 3, 3> Normal;
+typedef FloatAttribute<VERTEX_ATTRIBUTE_UV, 6, 2> UV;
+typedef FloatAttribute<VERTEX_ATTRIBUTE_TANGENT, 8, 3> Tangent;
+typedef FloatAttribute<VERTEX_ATTRIBUTE_BITANGENT, 11, 3> Bitangent;
+
+/* Normalized 16 bit position inside the mesh bounds, padded to 4 shorts so whatever follows stays 4 byte aligned */
+struct QuantizedPosition {
+    static constexpr GLuint LOCATION = VERTEX_ATTRIBUTE_POSITION;
+    static constexpr GLint COMPONENTS = 3;
+    static constexpr GLenum TYPE = GL_UNSIGNED_SHORT;
+    static constexpr GLboolean NORMALIZED = GL_TRUE;
+    static constexpr unsigned int SIZE = 4 * sizeof(GLushort);
+    static constexpr unsigned int SOURCE_FLOATS = Position::SOURCE_FLOATS;
+
+    static void pack(const GLfloat* vertex, unsigned char* out, const VertexLayout& layout) {
+        glm::vec3 position(vertex[0], vertex[1], vertex[2]);
+        glm::vec3 unit = glm::clamp((position - layout.position_min) / layout.position_extent, 0.0f, 1.0f);
+        GLushort quantized[4] = {
+            (GLushort)std::lround(unit.x * 65535.0f),
+            (GLushort)std::lround(unit.y * 65535.0f),
+            (GLushort)std::lround(unit.z * 65535.0f),
+            0
+        };
+        memcpy(out, quantized, SIZE);
+    }
+
+    static void decode(const unsigned char* in, const VertexLayout& layout, DecodedVertex& decoded) {
+        GLushort quantized[4];
+        memcpy(quantized, in, SIZE);
+        glm::vec3 position = layout.position_min + glm::vec3(quantized[0], quantized[1], quantized[2]) / 65535.0f * layout.position_extent;
+        decoded.attributes[LOCATION] = glm::vec4(position, 0.0f);
+    }
+};
+
+/* Unit vector in GL_INT_2_10_10_10_REV, packed types always have 4 components */
+template <VertexAttribute ATTRIBUTE, unsigned int FIRST>
+struct PackedDirection {
+    static constexpr GLuint LOCATION = ATTRIBUTE;
+    static constexpr GLint COMPONENTS = 4;
+    static constexpr GLenum TYPE = GL_INT_2_10_10_10_REV;
+    static constexpr GLboolean NORMALIZED = GL_TRUE;
+    static constexpr unsigned int SIZE = sizeof(uint32_t);
+    static constexpr unsigned int SOURCE_FLOATS = FIRST + 3;
+
+    static glm::vec3 unit(const GLfloat* vertex, unsigned int first) {
+        glm::vec3 v(vertex[first], vertex[first + 1], vertex[first + 2]);
+        float length = glm::length(v);
+        return length > 0.0f ? v / length : glm::vec3(0.0f);
+    }
+
+    static void pack(const GLfloat* vertex, unsigned char* out, const VertexLayout&) {
+        uint32_t packed = glm::packSnorm3x10_1x2(glm::vec4(unit(vertex, FIRST), 0.0f));
+        memcpy(out, &packed, SIZE);
+    }
+
+    static void decode(const unsigned char* in, const VertexLayout&, DecodedVertex& decoded) {
+        uint32_t packed;
+        memcpy(&packed, in, SIZE);
+        decoded.attributes[ATTRIBUTE] = glm::unpackSnorm3x10_1x2(packed);
+    }
+};
+
+typedef PackedDirection<VERTEX_ATTRIBUTE_NORMAL, Normal::SOURCE_FIRST> PackedNormal;
+
+/* Tangent with the bitangent sign in w, normalmap.vert rebuilds the bitangent as cross(N, T) * w */
+struct PackedTangent : PackedDirection<VERTEX_ATTRIBUTE_TANGENT, Tangent::SOURCE_FIRST> {
+    static constexpr unsigned int SOURCE_FLOATS = Bitangent::SOURCE_FLOATS;
+
+    static void pack(const GLfloat* vertex, unsigned char* out, const VertexLayout&) {
+        glm::vec3 normal = unit(vertex, Normal::SOURCE_FIRST);
+        glm::vec3 tangent = unit(vertex, Tangent::SOURCE_FIRST);
+        glm::vec3 bitangent = unit(vertex, Bitangent::SOURCE_FIRST);
+        float handedness = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+        uint32_t packed = glm::packSnorm3x10_1x2(glm::vec4(tangent, handedness));
+        memcpy(out, &packed, SIZE);
+    }
+};
+
+/* Two uv components as normalized 16 bit values, only for uvs inside [0, 1] */
+struct UnormUV {
+    static constexpr GLuint LOCATION = VERTEX_ATTRIBUTE_UV;
+    static constexpr GLint COMPONENTS = 2;
+    static constexpr GLenum TYPE = GL_UNSIGNED_SHORT;
+    static constexpr GLboolean NORMALIZED = GL_TRUE;
+    static constexpr unsigned int SIZE = 2 * sizeof(GLushort);
+    static constexpr unsigned int SOURCE_FLOATS = UV::SOURCE_FLOATS;
+
+    static void pack(const GLfloat* vertex, unsigned char* out, const VertexLayout&) {
+        uint32_t packed = glm::packUnorm2x16(glm::vec2(vertex[UV::SOURCE_FIRST], vertex[UV::SOURCE_FIRST + 1]));
+        memcpy(out, &packed, SIZE);
+    }
+
+    static void decode(const unsigned char* in, const VertexLayout&, DecodedVertex& decoded) {
+        uint32_t packed;
+        memcpy(&packed, in, SIZE);
+        decoded.attributes[LOCATION] = glm::vec4(glm::unpackUnorm2x16(packed), 0.0f, 0.0f);
+    }
+};
+
+/* Two uv components as half floats */
+struct HalfUV {
+    static constexpr GLuint LOCATION = VERTEX_ATTRIBUTE_UV;
+    static constexpr GLint COMPONENTS = 2;
+    static constexpr GLenum TYPE = GL_HALF_FLOAT;
+    static constexpr GLboolean NORMALIZED = GL_FALSE;
+    static constexpr unsigned int SIZE = 2 * sizeof(GLushort);
+    static constexpr unsigned int SOURCE_FLOATS = UV::SOURCE_FLOATS;
+
+    static void pack(const GLfloat* vertex, unsigned char* out, const VertexLayout&) {
+        uint32_t packed = glm::packHalf2x16(glm::vec2(vertex[UV::SOURCE_FIRST], vertex[UV::SOURCE_FIRST + 1]));
+        memcpy(out, &packed, SIZE);
+    }
+
+    static void decode(const unsigned char* in, const VertexLayout&, DecodedVertex& decoded) {
+        uint32_t packed;
+        memcpy(&packed, in, SIZE);
+        decoded.attributes[LOCATION] = glm::vec4(glm::unpackHalf2x16(packed), 0.0f, 0.0f);
+    }
+};
+
+/*
+ * A vertex made of the listed attributes in order. The stride, every offset, the packing loop and the
+ * glVertexAttribPointer calls all come from the list, so a new format is one more typedef.
+ */
+template <typename... Attributes>
+struct VertexLayoutOf {
+
+    /* Bytes per vertex in the buffer */
+    static constexpr unsigned int STRIDE = (Attributes::SIZE + ...);
+
+    /* Floats per vertex of the float vertices it is packed from */
+    static constexpr unsigned int FLOATS = std::max({ Attributes::SOURCE_FLOATS... });
+
+    static constexpr unsigned int LOCATIONS = ((1u << Attributes::LOCATION) | ...);
+
+    static constexpr bool HAS_TANGENTS = (LOCATIONS & (1u << VERTEX_ATTRIBUTE_TANGENT)) != 0;
+
+    static_assert(((Attributes::SIZE % 4 == 0) && ...), "attributes must keep 4 byte alignment");
+    static_assert(((1u << Attributes::LOCATION) + ...) == LOCATIONS, "two attributes share a location");
+    static_assert((LOCATIONS & (1u << VERTEX_ATTRIBUTE_POSITION)) != 0, "every vertex needs a position");
+
+    static size_t vertex_count(size_t float_count) {
+        return float_count / FLOATS;
+    }
+
+    /* vertices holds vertex_count * FLOATS floats, out receives vertex_count * STRIDE bytes */
+    static void pack(const GLfloat* vertices, size_t vertex_count, const VertexLayout& layout, unsigned char* out) {
+        for (size_t i = 0; i < vertex_count; i++) {
+            const GLfloat* vertex = vertices + i * FLOATS;
+            unsigned char* cursor = out + i * STRIDE;
+            ((Attributes::pack(vertex, cursor, layout), cursor += Attributes::SIZE), ...);
+        }
+    }
+
+    static void decode(const unsigned char* in, const VertexLayout& layout, DecodedVertex& decoded) {
+        for (glm::vec4& attribute : decoded.attributes) {
+            attribute = glm::vec4(0.0f);
+        }
+        ((Attributes::decode(in, layout, decoded), in += Attributes::SIZE), ...);
+    }
+
+    /* Sets up the buffer bound to GL_ARRAY_BUFFER, recorded in the bound VAO. Locations not in the list are disabled */
+    static void bind() {
+        size_t offset = 0;
+        ((glVertexAttribPointer(Attributes::LOCATION, Attributes::COMPONENTS, Attributes::TYPE, Attributes::NORMALIZED,
+            STRIDE, (void*)offset), glEnableVertexAttribArray(Attributes::LOCATION), offset += Attributes::SIZE), ...);
+
+        for (GLuint location = 0; location < VERTEX_ATTRIBUTE_COUNT; location++) {
+            if ((LOCATIONS & (1u << location)) == 0) {
+                glDisableVertexAttribArray(location);
+            }
+        }
+    }
+
+};
+
+/* What MeshLoader builds */
+typedef VertexLayoutOf<Position, Normal, UV> FloatVertex;
+typedef VertexLayoutOf<Position, Normal, UV, Tangent, Bitangent> FloatTangentVertex;
+
+/* The compact formats, for each way the uvs can be stored */
+template <typename PositionAttribute, typename UVAttribute>
+using CompactVertex = VertexLayoutOf<PositionAttribute, PackedNormal, UVAttribute>;
+
+template <typename PositionAttribute, typename UVAttribute>
+using CompactTangentVertex = VertexLayoutOf<PositionAttribute, PackedNormal, UVAttribute, PackedTangent>;
+
+static_assert(FloatVertex::FLOATS == 8 && FloatTangentVertex::FLOATS == 14, "float layouts must match MeshLoader");
+static_assert(FloatTangentVertex::STRIDE == FloatTangentVertex::FLOATS * sizeof(GLfloat), "float layouts are unpadded");
+static_assert(CompactTangentVertex<QuantizedPosition, UnormUV>::STRIDE == 20, "compact16 vertex is 20 bytes");
+
+class VertexLayouts {
+
+public:
+
+    /* Floats per vertex MeshLoader builds, with or without the tangent frame */
+    static constexpr unsigned int floats_per_vertex(bool has_tangents) {
+        return has_tangents ? FloatTangentVertex::FLOATS : FloatVertex::FLOATS;
+    }
+
+    /*
+     * Calls visit with an instance of the layout type that matches the runtime description, the one branch
+     * taken per mesh. Everything per vertex inside visit is then fixed at compile time.
+     */
+    template <typename Visitor>
+    static void dispatch(const VertexLayout& layout, Visitor&& visit) {
+        if (layout.format == VERTEX_FORMAT_FLOAT) {
+            if (layout.has_tangents) {
+                visit(FloatTangentVertex());
+            } else {
+                visit(FloatVertex());
+            }
+        } else if (layout.format == VERTEX_FORMAT_COMPACT_POSITIONS) {
+            dispatch_uv<QuantizedPosition>(layout, visit);
+        } else {
+            dispatch_uv<Position>(layout, visit);
+        }
+    }
+
+private:
+
+    template <typename PositionAttribute, typename Visitor>
+    static void dispatch_uv(const VertexLayout& layout, Visitor& visit) {
+        if (layout.uv_type == GL_UNSIGNED_SHORT) {
+            dispatch_tangents<PositionAttribute, UnormUV>(layout, visit);
+        } else if (layout.uv_type == GL_HALF_FLOAT) {
+            dispatch_tangents<PositionAttribute, HalfUV>(layout, visit);
+        } else {
+            dispatch_tangents<PositionAttribute, UV>(layout, visit);
+        }
+    }
+
+    template <typename PositionAttribute, typename UVAttribute, typename Visitor>
+    static void dispatch_tangents(const VertexLayout& layout, Visitor& visit) {
+        if (layout.has_tangents) {
+            visit(CompactTangentVertex<PositionAttribute, UVAttribute>());
+        } else {
+            visit(CompactVertex<PositionAttribute, UVAttribute>());
+        }
+    }
+
+};
@@ -0,0 +1,233 @@
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <type_traits>
+
+#include "VertexPacker.h"
+
+/* Half floats stay within MAX_UV_ERROR up to this magnitude, past it their step doubles */
+static const float HALF_FLOAT_UV_LIMIT = 1.0f;
+
+static glm::vec3 safe_normalize(glm::vec3 v) {
+    float length = glm::length(v);
+    return length > 0.0f ? v / length : glm::vec3(0.0f);
+}
+
+static double degrees_between(glm::vec3 a, glm::vec3 b) {
+    double dot = (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+    return std::acos(std::min(1.0, std::max(-1.0, dot))) * 180.0 / 3.14159265358979323846;
+}
+
+VertexLayout VertexPacker::float_layout(bool has_tangents) {
+    VertexLayout layout;
+    layout.format = VERTEX_FORMAT_FLOAT;
+    layout.has_tangents = has_tangents;
+    layout.stride = has_tangents ? FloatTangentVertex::STRIDE : FloatVertex::STRIDE;
+    layout.float_stride = layout.stride;
+    layout.uv_type = GL_FLOAT;
+    layout.position_min = glm::vec3(0.0f);
+    layout.position_extent = glm::vec3(1.0f);
+    return layout;
+}
+
+VertexLayout VertexPacker::pack(const GLfloat* vertices, size_t vertex_count, bool has_tangents,
+    VertexFormat format, std::vector<unsigned char>& packed) {
+    VertexLayout layout = float_layout(has_tangents);
+    packed.clear();
+    if (format == VERTEX_FORMAT_FLOAT) {
+        return layout;
+    }
+
+    const unsigned int floats_per_vertex = VertexLayouts::floats_per_vertex(has_tangents);
+
+    /* One pass for the bounds and the uv range */
+    glm::vec3 position_max(0.0f);
+    float uv_min = 0.0f, uv_max = 0.0f;
+    for (size_t i = 0; i < vertex_count; i++) {
+        const GLfloat* vertex = vertices + i * floats_per_vertex;
+        glm::vec3 position(vertex[0], vertex[1], vertex[2]);
+        const GLfloat* uv = vertex + UV::SOURCE_FIRST;
+        if (i == 0) {
+            layout.position_min = position;
+            position_max = position;
+            uv_min = uv_max = uv[0];
+        }
+        layout.position_min = glm::min(layout.position_min, position);
+        position_max = glm::max(position_max, position);
+        uv_min = std::min(uv_min, std::min(uv[0], uv[1]));
+        uv_max = std::max(uv_max, std::max(uv[0], uv[1]));
+    }
+
+    layout.format = format;
+    if (format == VERTEX_FORMAT_COMPACT_POSITIONS) {
+        layout.position_extent = position_max - layout.position_min;
+        for (int axis = 0; axis < 3; axis++) {
+            if (layout.position_extent[axis] <= 0.0f) {
+                layout.position_extent[axis] = 1.0f;
+            }
+        }
+    } else {
+        layout.position_min = glm::vec3(0.0f);
+    }
+
+    if (uv_min >= 0.0f && uv_max <= 1.0f) {
+        layout.uv_type = GL_UNSIGNED_SHORT;
+    } else if (std::max(-uv_min, uv_max) <= HALF_FLOAT_UV_LIMIT) {
+        layout.uv_type = GL_HALF_FLOAT;
+    } else {
+        layout.uv_type = GL_FLOAT; // tiled uvs, halves would be too coarse
+    }
+
+    /* The layout type is picked once here, the per vertex loop inside it has no branches on the format */
+    VertexLayouts::dispatch(layout, [&](auto vertex) {
+        typedef decltype(vertex) Layout;
+        layout.stride = Layout::STRIDE;
+        packed.resize(vertex_count * Layout::STRIDE);
+        Layout::pack(vertices, vertex_count, layout, packed.data());
+    });
+
+    return layout;
+}
+
+/* Decodes every vertex the way GL does and compares it against the source floats */
+VertexPackError VertexPacker::measure_error(const GLfloat* vertices, size_t vertex_count,
+    const VertexLayout& layout, const unsigned char* packed) {
+    VertexPackError error = {};
+    if (layout.format == VERTEX_FORMAT_FLOAT) {
+        return error;
+    }
+
+    const VertexLayout source_layout = float_layout(layout.has_tangents);
+    glm::vec3 position_min(0.0f), position_max(0.0f);
+
+    double normal_degrees = 0.0, tangent_degrees = 0.0, bitangent_degrees = 0.0;
+    VertexLayouts::dispatch(layout, [&](auto vertex) {
+        typedef decltype(vertex) Layout;
+        typedef std::conditional_t<Layout::HAS_TANGENTS, FloatTangentVertex, FloatVertex> Source;
+        for (size_t i = 0; i < vertex_count; i++) {
+            DecodedVertex source, decoded;
+            Source::decode((const unsigned char*)(vertices + i * Source::FLOATS), source_layout, source);
+            Layout::decode(packed + i * Layout::STRIDE, layout, decoded);
+
+            glm::vec3 position(source.attributes[VERTEX_ATTRIBUTE_POSITION]);
+            glm::vec3 delta = glm::abs(glm::vec3(decoded.attributes[VERTEX_ATTRIBUTE_POSITION]) - position);
+            error.position = std::max(error.position, std::max(delta.x, std::max(delta.y, delta.z)));
+            position_min = i == 0 ? position : glm::min(position_min, position);
+            position_max = i == 0 ? position : glm::max(position_max, position);
+
+            glm::vec3 normal = safe_normalize(glm::vec3(source.attributes[VERTEX_ATTRIBUTE_NORMAL]));
+            glm::vec3 decoded_normal = safe_normalize(glm::vec3(decoded.attributes[VERTEX_ATTRIBUTE_NORMAL]));
+            if (normal != glm::vec3(0.0f)) {
+                normal_degrees = std::max(normal_degrees, degrees_between(normal, decoded_normal));
+            }
+
+            glm::vec2 uv_delta = glm::abs(glm::vec2(decoded.attributes[VERTEX_ATTRIBUTE_UV]) - glm::vec2(source.attributes[VERTEX_ATTRIBUTE_UV]));
+            error.uv = std::max(error.uv, std::max(uv_delta.x, uv_delta.y));
+
+            if constexpr (Layout::HAS_TANGENTS) {
+                glm::vec3 tangent = safe_normalize(glm::vec3(source.attributes[VERTEX_ATTRIBUTE_TANGENT]));
+                glm::vec3 bitangent = safe_normalize(glm::vec3(source.attributes[VERTEX_ATTRIBUTE_BITANGENT]));
+                glm::vec4 decoded_tangent = decoded.attributes[VERTEX_ATTRIBUTE_TANGENT];
+                glm::vec3 decoded_tangent3 = safe_normalize(glm::vec3(decoded_tangent));
+                if (tangent != glm::vec3(0.0f)) {
+                    tangent_degrees = std::max(tangent_degrees, degrees_between(tangent, decoded_tangent3));
+                }
+
+                /* Same reconstruction as normalmap.vert */
+                glm::vec3 rebuilt = safe_normalize(glm::cross(decoded_normal, decoded_tangent3) * (decoded_tangent.w < 0.0f ? -1.0f : 1.0f));
+                if (bitangent != glm::vec3(0.0f) && rebuilt != glm::vec3(0.0f)) {
+                    bitangent_degrees = std::max(bitangent_degrees, degrees_between(bitangent, rebuilt));
+                    if (glm::dot(bitangent, rebuilt) < 0.0f) {
+                        error.bitangent_flips++;
+                    }
+                }
+            }
+        }
+    });
+
+    glm::vec3 extent = position_max - position_min;
+    float largest_extent = std::max(extent.x, std::max(extent.y, extent.z));
+    error.position = largest_extent > 0.0f ? error.position / largest_extent : error.position;
+    error.normal_degrees = (float)normal_degrees;
+    error.tangent_degrees = (float)tangent_degrees;
+    error.bitangent_degrees = (float)bitangent_degrees;
+    return error;
+}
+
+bool VertexPacker::within_tolerance(const VertexPackError& error) {
+    return error.position <= MAX_POSITION_ERROR &&
+        error.normal_degrees <= MAX_NORMAL_DEGREES &&
+        error.tangent_degrees <= MAX_NORMAL_DEGREES &&
+        error.uv <= MAX_UV_ERROR;
+}
+
+void VertexPacker::bind_attributes(const VertexLayout& layout) {
+    VertexLayouts::dispatch(layout, [](auto vertex) {
+        decltype(vertex)::bind();
+    });
+}
+
+void VertexPacker::apply_uniforms(const VertexLayout& layout, GLuint shader_id) {
+    unsigned int positionMinLoc = glGetUniformLocation(shader_id, "positionMin");
+    glUniform3fv(positionMinLoc, 1, &layout.position_min[0]);
+
+    unsigned int positionExtentLoc = glGetUniformLocation(shader_id, "positionExtent");
+    glUniform3fv(positionExtentLoc, 1, &layout.position_extent[0]);
+
+    unsigned int packedTangentsLoc = glGetUniformLocation(shader_id, "packedTangents");
+    glUniform1i(packedTangentsLoc, layout.format != VERTEX_FORMAT_FLOAT);
+}
+
+const char* VertexPacker::format_name(VertexFormat format) {
+    switch (format) {
+    case VERTEX_FORMAT_COMPACT:
+        return "compact";
+    case VERTEX_FORMAT_COMPACT_POSITIONS:
+        return "compact16";
+    default:
+        return "float";
+    }
+}
+
+static const char* uv_type_name(GLenum uv_type) {
+    switch (uv_type) {
+    case GL_UNSIGNED_SHORT:
+        return "unorm16";
+    case GL_HALF_FLOAT:
+        return "half";
+    default:
+        return "float";
+    }
+}
+
+void VertexPacker::print_report(const std::vector<VertexPackStats>& stats) {
+    size_t total_bytes = 0, total_float_bytes = 0;
+
+    std::cout << "Vertex buffers\n";
+    for (const VertexPackStats& entry : stats) {
+        size_t bytes = entry.vertex_count * entry.layout.stride;
+        size_t float_bytes = entry.vertex_count * entry.layout.float_stride;
+        total_bytes += bytes;
+        total_float_bytes += float_bytes;
+
+        char line[320];
+        snprintf(line, sizeof(line), "  %-24s %-9s uv %-7s %2u B/vertex (float %2u)  %9.1f KB  pos %.2e  normal %5.2f deg  uv %.2e  tangent %5.2f deg  bitangent %6.2f deg, %zu flipped%s\n",
+            entry.name.c_str(), format_name(entry.layout.format), uv_type_name(entry.layout.uv_type),
+            entry.layout.stride, entry.layout.float_stride, bytes / 1024.0,
+            entry.error.position, entry.error.normal_degrees, entry.error.uv,
+            entry.error.tangent_degrees, entry.error.bitangent_degrees, entry.error.bitangent_flips,
+            entry.fell_back ? "  over tolerance, kept float" : "");
+        std::cout << line;
+    }
+
+    char summary[256];
+    snprintf(summary, sizeof(summary), "  %.1f KB uploaded instead of %.1f KB (%.0f%%)\n",
+        total_bytes / 1024.0, total_float_bytes / 1024.0,
+        total_float_bytes > 0 ? 100.0 * total_bytes / total_float_bytes : 0.0);
+    std::cout << summary << std::flush;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+#include "VertexLayouts.h"
+
+/* Largest difference between the float vertices and what the vertex shader will decode from the packed ones */
+struct VertexPackError {
+    float position; // as a fraction of the largest bounds extent
+    float normal_degrees;
+    float uv; // in uv units, 1/1024 is one texel of a 1024 wide texture
+    float tangent_degrees;
+    float bitangent_degrees; // against the stored bitangent, only reported since per face tangents are not orthogonal
+    size_t bitangent_flips; // vertices whose reconstructed bitangent points away from the stored one
+};
+
+/* One row of the vertex buffer report */
+struct VertexPackStats {
+    std::string name;
+    size_t vertex_count;
+    VertexLayout layout;
+    VertexPackError error;
+    bool fell_back; // packing exceeded the tolerances and the float layout was uploaded instead
+};
+
+/*
+ * Packs the interleaved float vertices built by MeshLoader into smaller GPU formats right before upload.
+ * Normals and tangents become GL_INT_2_10_10_10_REV with the bitangent sign in the tangent's 2 bit w,
+ * the vertex shader rebuilds the bitangent as cross(N, T) * w. Uvs become normalized 16 bit or half floats,
+ * positions optionally become normalized 16 bit values inside the mesh bounds.
+ * The packed result is decoded again on the CPU and compared against the floats, meshes that would change
+ * visibly are uploaded unpacked.
+ */
+class VertexPacker {
+
+public:
+
+    /* Tolerances for the visual diff check */
+    static constexpr float MAX_POSITION_ERROR = 1.0f / 4096.0f;
+    static constexpr float MAX_NORMAL_DEGREES = 0.5f;
+    static constexpr float MAX_UV_ERROR = 1.0f / 4096.0f;
+
+    static VertexLayout float_layout(bool has_tangents);
+
+    /* vertices holds vertex_count * VertexLayouts::floats_per_vertex(has_tangents) floats */
+    static VertexLayout pack(const GLfloat* vertices, size_t vertex_count, bool has_tangents,
+        VertexFormat format, std::vector<unsigned char>& packed);
+
+    static VertexPackError measure_error(const GLfloat* vertices, size_t vertex_count,
+        const VertexLayout& layout, const unsigned char* packed);
+
+    static bool within_tolerance(const VertexPackError& error);
+
+    /* Sets up attributes 0 to 4 for the buffer bound to GL_ARRAY_BUFFER, recorded in the bound VAO */
+    static void bind_attributes(const VertexLayout& layout);
+
+    /* Sets positionMin, positionExtent and packedTangents on the shader currently in use */
+    static void apply_uniforms(const VertexLayout& layout, GLuint shader_id);
+
+    static const char* format_name(VertexFormat format);
+
+    static void print_report(const std::vector<VertexPackStats>& stats);
+
+};
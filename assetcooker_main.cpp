@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "AssetCooker.h"
+#include "MeshCache.h"
+#include "MeshLoader.h"
+#include "TextureCache.h"
+#include "TextureDecoder.h"
+#include "ThreadPool.h"
+#include "VertexLayouts.h"
+
+static const char COOK_MANIFEST_PATH[] = "Cache/cook.manifest";
+
+/* Objs finalproject draws with a normal map, they are cooked with tangents */
+static const char* const NORMAL_MAPPED_MESHES[] = { "3D/shark.obj" };
+
+/* Textures finalproject loads as normal maps, they are compressed to BC5 instead of BC1 */
+static const char* const NORMAL_MAP_TEXTURES[] = { "3D/rock_normal.jpg" };
+
+/* Skybox faces finalproject flips, it flips every model texture and none of the other faces */
+static const char* const FLIPPED_SKYBOX_FACES[] = { "Skybox/uw_up.jpg" };
+
+/* Sorted paths of the files in directory with the given extension */
+static bool list_files(const char* directory, const char* extension, std::vector<std::string>& files) {
+    std::error_code ec;
+    for (auto it = std::filesystem::directory_iterator(directory, ec); !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+        if (it->is_regular_file() && it->path().extension() == extension) {
+            files.push_back(it->path().generic_string());
+        }
+    }
+    if (ec) {
+        std::cout << "Could not list " << directory << ": " << ec.message() << std::endl;
+        return false;
+    }
+    std::sort(files.begin(), files.end());
+    return true;
+}
+
+/*
+ * Cooks every obj in 3D/ into the mesh cache the game maps at startup: welded, optimized, with tangents where
+ * they are normal mapped and with their LOD chain. Every jpg in 3D/ and Skybox/ goes into the texture cache,
+ * decoded, flipped and block compressed the way the game asks for it on a driver with S3TC and RGTC, model textures
+ * with their mip chain. Run from the project directory, only inputs that changed
+ * since the last run are cooked again, assetcooker --force cooks everything.
+ */
+int main(int argc, char** argv)
+{
+    bool force = argc > 1 && std::string(argv[1]) == "--force";
+
+    std::vector<std::string> meshes, textures, faces;
+    if (!list_files("3D", ".obj", meshes) || !list_files("3D", ".jpg", textures) || !list_files("Skybox", ".jpg", faces)) {
+        return 1;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories("Cache", ec);
+
+    AssetCooker cooker(COOK_MANIFEST_PATH);
+    for (const std::string& mesh : meshes) {
+        bool hasNormalMaps = std::find(std::begin(NORMAL_MAPPED_MESHES), std::end(NORMAL_MAPPED_MESHES), mesh) != std::end(NORMAL_MAPPED_MESHES);
+        unsigned int floatsPerVertex = VertexLayouts::floats_per_vertex(hasNormalMaps);
+
+        /* MeshLoader writes the cache entry itself, the same one the game would write on its first run */
+        cooker.add(mesh, MeshCache::cache_path(mesh.c_str(), floatsPerVertex), MeshCache::VERSION, [mesh, hasNormalMaps] {
+            return !MeshLoader::load(mesh.c_str(), hasNormalMaps, true).lods.empty();
+        });
+    }
+
+    for (const std::string& texture : textures) {
+        TextureOptions options;
+        options.flip = true;
+        options.mips = true;
+        options.normal_map = std::find(std::begin(NORMAL_MAP_TEXTURES), std::end(NORMAL_MAP_TEXTURES), texture) != std::end(NORMAL_MAP_TEXTURES);
+        options.compress = true;
+        cooker.add(texture, TextureCache::cache_path(texture.c_str(), options), TextureCache::VERSION, [texture, options] {
+            return TextureDecoder::decode(texture.c_str(), options, true).data != nullptr;
+        });
+    }
+
+    for (const std::string& face : faces) {
+        TextureOptions options;
+        options.flip = std::find(std::begin(FLIPPED_SKYBOX_FACES), std::end(FLIPPED_SKYBOX_FACES), face) != std::end(FLIPPED_SKYBOX_FACES);
+        options.mips = false;
+        options.normal_map = false;
+        options.compress = true;
+        cooker.add(face, TextureCache::cache_path(face.c_str(), options), TextureCache::VERSION, [face, options] {
+            return TextureDecoder::decode(face.c_str(), options, true).data != nullptr;
+        });
+    }
+
+    /* Separate from ThreadPool::shared(), which the parser splits each obj across */
+    ThreadPool cookPool;
+    bool success = cooker.run(cookPool, force);
+    cooker.print_report();
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,49 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "AssetArchive.h"
+
+/* Folders the game reads from, packed under the same relative paths it opens them by */
+static const char* const ASSET_FOLDERS[] = { "3D", "Skybox", "Shaders" };
+
+/*
+ * Packs every asset the game loads into one archive. Run from the project directory,
+ * assetpacker [output] writes assets.pak next to the folders unless given another path.
+ */
+int main(int argc, char** argv)
+{
+    const char* outputPath = argc > 1 ? argv[1] : "assets.pak";
+
+    std::vector<std::string> files;
+    for (const char* folder : ASSET_FOLDERS) {
+        std::error_code ec;
+        for (auto it = std::filesystem::recursive_directory_iterator(folder, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            if (it->is_regular_file()) {
+                files.push_back(it->path().generic_string());
+            }
+        }
+        if (ec) {
+            std::cout << "Could not list " << folder << ": " << ec.message() << std::endl;
+            return 1;
+        }
+    }
+
+    /* Sorted so the same assets always pack into the same archive */
+    std::sort(files.begin(), files.end());
+
+    if (!AssetArchive::write(outputPath, files)) {
+        return 1;
+    }
+
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(outputPath, ec);
+    char summary[256];
+    snprintf(summary, sizeof(summary), "Packed %zu files into %s, %.2f MB\n", files.size(), outputPath, ec ? 0.0 : size / (1024.0 * 1024.0));
+    std::cout << summary;
+    return 0;
+}
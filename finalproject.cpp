@@ -1,11 +1,13 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
 #include <string>
 #include <iostream>
+#include <chrono>
+#include <future>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -16,10 +18,22 @@
 #include "MyCamera.h"
 #include "Light.h"
 #include "Player.h"
+#include "FastObjParser.h"
+#include "MeshLoader.h"
+#include "ThreadPool.h"
+#include "VertexPacker.h"
+#include "AssetStreamer.h"
+#include "MeshRegistry.h"
+#include "AssetArchive.h"
+#include "TextureLoader.h"
+#include "TextureResidency.h"
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void processInput(GLFWwindow* window);
 
+/* Built by the assetpacker target, loose files are used when it is missing */
+static const char ASSET_ARCHIVE_PATH[] = "assets.pak";
+
 /* Window size */
 float screenWidth = 750.0f;
 float screenHeight = 750.0f;
@@ -68,6 +82,9 @@ bool high = false;
 
 bool isFirstPerson = false;
 
+/* Pixels of LOD error allowed on screen, [ and ] halve and double it */
+float lodBias = 1.0f;
+
 /* Contains all model data */
 std::vector<Model3D> modelList;
 
@@ -109,18 +126,111 @@ void Key_Callback(GLFWwindow* window,
         }
     }
 
+    if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS)
+    {
+        lodBias = std::max(lodBias * 0.5f, 0.125f);
+        std::cout << "LOD bias " << lodBias << " px" << std::endl;
+    }
+    if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS)
+    {
+        lodBias = std::min(lodBias * 2.0f, 64.0f);
+        std::cout << "LOD bias " << lodBias << " px" << std::endl;
+    }
+
     modelList[0].printDepth();
 }
 
-int main(void)
+/* Flags may be given in any order and combined */
+static bool has_flag(int argc, char** argv, const char* flag) {
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == flag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* The argument following flag, null when the flag is missing or is the last argument */
+static const char* flag_value(int argc, char** argv, const char* flag) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == flag) {
+            return argv[i + 1];
+        }
+    }
+    return nullptr;
+}
+
+int main(int argc, char** argv)
 {
     GLFWwindow* window;
 
+    /* --bench-obj times the obj parsers on the scene's meshes and exits */
+    if (has_flag(argc, argv, "--bench-obj")) {
+        FastObjParser::benchmark({ "3D/shark.obj", "3D/dolphin.obj", "3D/whale.obj", "3D/turtle.obj",
+            "3D/angelfish.obj", "3D/coral.obj", "3D/diver.obj" }, 5);
+        return 0;
+    }
+
+    /* --float-vertices uploads the unpacked float layout, for comparing against the compact one */
+    VertexFormat vertexFormat = VERTEX_FORMAT_COMPACT_POSITIONS;
+    if (has_flag(argc, argv, "--float-vertices")) {
+        vertexFormat = VERTEX_FORMAT_FLOAT;
+    }
+
+    /* --no-mesh-opt keeps triangles and vertices in obj order and skips the mesh cache, for comparing ACMR and frame times */
+    bool optimizeMeshes = !has_flag(argc, argv, "--no-mesh-opt");
+
+    /* --no-texture-cache decodes every texture and builds its mips again, for comparing cold loads against warm ones */
+    bool useTextureCache = !has_flag(argc, argv, "--no-texture-cache");
+
+    /* --no-texture-compression uploads 8 bit rows instead of BC blocks, for comparing VRAM and quality */
+    bool useTextureCompression = !has_flag(argc, argv, "--no-texture-compression");
+
+    /* --no-upload-ring uploads textures straight from client memory, for comparing hitch frames while streaming */
+    bool useUploadRing = !has_flag(argc, argv, "--no-upload-ring");
+
+    /* --upload-budget <ms> sets how long each frame may spend uploading streamed assets */
+    double uploadBudgetMs = AssetStreamer::DEFAULT_UPLOAD_BUDGET_MS;
+    if (const char* value = flag_value(argc, argv, "--upload-budget")) {
+        uploadBudgetMs = std::atof(value);
+    }
+
+    /* --texture-budget <MB> sets how much VRAM the fauna texture arrays may hold, finer mips are dropped to stay within it */
+    size_t textureBudgetBytes = TextureResidency::DEFAULT_BUDGET_BYTES;
+    if (const char* value = flag_value(argc, argv, "--texture-budget")) {
+        textureBudgetBytes = (size_t)(std::atof(value) * 1024.0 * 1024.0);
+    }
+
+    /* --split-texture-arrays splits a texture size whose whole mip chain is over the texture budget into several arrays,
+       trading binds for letting close textures keep finer levels than far ones */
+    size_t textureSplitBytes = has_flag(argc, argv, "--split-texture-arrays") ? textureBudgetBytes : 0;
+
+    /* --measure-overdraw <frames> renders offscreen in a hidden window once everything has loaded, that many frames with the
+       skybox drawn last and as many with it drawn first, then reports the fragments each order shaded and exits */
+    int overdrawFrames = 0;
+    if (const char* value = flag_value(argc, argv, "--measure-overdraw")) {
+        overdrawFrames = std::max(std::atoi(value), 1);
+    }
+
+    /* Everything is read from assets.pak when it has been built, --loose-assets reads the folders instead */
+    if (!has_flag(argc, argv, "--loose-assets")) {
+        AssetArchive::mount(ASSET_ARCHIVE_PATH);
+    }
+
+    /* Assets are decoded on the worker pool and uploaded a few per frame, the window renders while they arrive */
+    ThreadPool loaderPool;
+    AssetStreamer streamer(loaderPool);
+    TextureLoader textureLoader(streamer, useTextureCache);
+    TextureResidency textureResidency(textureLoader, textureBudgetBytes);
+
     /* Initialize the library */
     if (!glfwInit())
         return -1;
 
     /* Create a windowed mode window and its OpenGL context */
+    if (overdrawFrames > 0) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
     window = glfwCreateWindow(screenWidth, screenHeight, "Final Project", NULL, NULL);
 
     if (!window)
@@ -132,6 +242,14 @@ int main(void)
     /* Make the window's context current */
     glfwMakeContextCurrent(window);
     gladLoadGL();
+    textureLoader.enable_compression(useTextureCompression);
+    if (useUploadRing) {
+        textureLoader.enable_upload_ring();
+    }
+
+    glEnable(GL_DEPTH_TEST);
+    /* The skybox sits exactly on the far plane, it has to pass against the cleared depth */
+    glDepthFunc(GL_LEQUAL);
 
     /* Variables for texture initialization */
     const int textures_count = 7;
@@ -139,51 +257,13 @@ int main(void)
     "3D/whale_texture.jpg", "3D/turtle_texture.jpg", "3D/angelfish_texture.jpg", "3D/coral_texture.jpg", 
     "3D/diver_texture.jpg" };
 
-    int img_width, img_height, color_channels;
-
-    GLuint textures[textures_count];
-    glGenTextures(textures_count, textures);
-
-    /* Load the respective textures */
-    for (int i = 0; i < textures_count; i++) {
-        stbi_set_flip_vertically_on_load(true);
-
-        unsigned char* tex_bytes = stbi_load(texture_filenames[i], &img_width, &img_height, &color_channels, 0);
-
-        glBindTexture(GL_TEXTURE_2D, textures[i]);
-
-        std::string current_filename = texture_filenames[i];
-
-        /* Check if texture is a png or jpg then load with respective parameters */
-        if (current_filename.find("png") != std::string::npos) {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img_width, img_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, tex_bytes);
-        }
-        else {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, img_width, img_height, 0, GL_RGB, GL_UNSIGNED_BYTE, tex_bytes);
-        }
-
-        glGenerateMipmap(GL_TEXTURE_2D);
-        stbi_image_free(tex_bytes);
-
-        glEnable(GL_DEPTH_TEST);
-    }
-
-    /* Load the normal map */
+    /* Normal map, filled in once it has streamed in */
     GLuint norm_tex;
     glGenTextures(1, &norm_tex);
     glBindTexture(GL_TEXTURE_2D, norm_tex);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
 
-    stbi_set_flip_vertically_on_load(true);
-
-    int img_width2, img_height2, color_channels2;
-    unsigned char* norm_bytes = stbi_load("3D/rock_normal.jpg", &img_width2, &img_height2, &color_channels2, 0);
-    /* https://www.filterforge.com/filters/1160-normal.jpg */
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, img_width2, img_height2, 0, GL_RGB, GL_UNSIGNED_BYTE, norm_bytes);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(norm_bytes);
-
     /* For keyboard events */
     /* TODO: The Player ship can be controlled using WASDQE */
     glfwSetKeyCallback(window, Key_Callback);
@@ -281,85 +361,90 @@ int main(void)
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
-    for (unsigned int i = 0; i < 6; i++) {
-
-        int w, h, skyColorChannel;
-        if (i == 2) { /* uw_up looks wrong is not flipped */
-            stbi_set_flip_vertically_on_load(true);
-        } else {
-            stbi_set_flip_vertically_on_load(false);
-        }
-        
-        unsigned char* data = stbi_load(facesSkybox[i].c_str(),
-            &w, &h, &skyColorChannel, 0);
-
-        if (data) {
-            glTexImage2D(
-                GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE,
-                data
-            );
-            stbi_image_free(data);
-        }
-
-    }
-
-    stbi_set_flip_vertically_on_load(true);
+    /* Place every model right away, each obj is loaded once however many models use it and drawn once it is in */
+    MeshRegistry meshRegistry(streamer, vertexFormat, optimizeMeshes);
 
     /* Create main object, will be normal mapped. Set last parameter to true as it is normal mapped */
     /* https://free3d.com/3d-model/shark-v2--367955.html */
-    Player mainObj = Player("3D/shark.obj", 0.0f, -10.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.03f, 0.03f, 0.03f, 270.0f, true, 4.0f);
+    Player mainObj = Player(meshRegistry.acquire("3D/shark.obj", true), 0.0f, -10.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.03f, 0.03f, 0.03f, 270.0f, 4.0f);
     mainObj.rotate_on_axis(-90.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-    modelList.push_back(mainObj);
+    modelList.push_back(std::move(mainObj));
 
     /* MODELS AT DEPTH -20.0 */
 
     /* https://free3d.com/3d-model/-dolphin-v1--12175.html */
-    Model3D dolphinObj = Model3D("3D/dolphin.obj", 20.0f, -20.0f, 20.0f, 0.0f, 0.0f, 1.0f, 0.025f, 0.025f, 0.025f, 90.0f, false, 4.0f);
+    Model3D dolphinObj = Model3D(meshRegistry.acquire("3D/dolphin.obj", false), 20.0f, -20.0f, 20.0f, 0.0f, 0.0f, 1.0f, 0.025f, 0.025f, 0.025f, 90.0f, 4.0f);
     dolphinObj.rotate_on_axis(90.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-    modelList.push_back(dolphinObj);
+    modelList.push_back(std::move(dolphinObj));
 
     /* https://free3d.com/3d-model/whale-v4--501429.html */
-    Model3D whaleObj = Model3D("3D/whale.obj", -20.0f, -20.0f, -20.0f, 0.0f, 0.0f, 1.0f, 0.05f, 0.05f, 0.05f, 90.0f, false, 7.0f);
+    Model3D whaleObj = Model3D(meshRegistry.acquire("3D/whale.obj", false), -20.0f, -20.0f, -20.0f, 0.0f, 0.0f, 1.0f, 0.05f, 0.05f, 0.05f, 90.0f, 7.0f);
     whaleObj.rotate_on_axis(90.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-    modelList.push_back(whaleObj);
+    modelList.push_back(std::move(whaleObj));
 
     /* https://free3d.com/3d-model/-sea-turtle-v1--427786.html */
-    Model3D turtleObj = Model3D("3D/turtle.obj", -10.0f, -20.0f, 10.0f, 0.0f, 0.0f, 1.0f, 0.05f, 0.05f, 0.05f, 90.0f, false, 4.0f);
+    Model3D turtleObj = Model3D(meshRegistry.acquire("3D/turtle.obj", false), -10.0f, -20.0f, 10.0f, 0.0f, 0.0f, 1.0f, 0.05f, 0.05f, 0.05f, 90.0f, 4.0f);
     turtleObj.rotate_on_axis(90.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-    modelList.push_back(turtleObj);
+    modelList.push_back(std::move(turtleObj));
 
     /* MODELS AT DEPTH -30.0 */
 
     /* https://free3d.com/3d-model/coral-beauty-angelfish-v1--473554.html */
-    Model3D angelfishObj = Model3D("3D/angelfish.obj", 0.0f, -30.0f, 10.0f, 0.0f, 0.0f, 1.0f, 2.0f, 2.0f, 2.0f, 90.0f, false, 4.0f);
+    Model3D angelfishObj = Model3D(meshRegistry.acquire("3D/angelfish.obj", false), 0.0f, -30.0f, 10.0f, 0.0f, 0.0f, 1.0f, 2.0f, 2.0f, 2.0f, 90.0f, 4.0f);
     angelfishObj.rotate_on_axis(2.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-    modelList.push_back(angelfishObj);
+    modelList.push_back(std::move(angelfishObj));
 
     /* https://free3d.com/3d-model/coral-v1--901825.html */
-    Model3D coralObj = Model3D("3D/coral.obj", -10.0f, -30.0f, 20.0f, 0.0f, 0.0f, 1.0f, 0.1f, 0.1f, 0.1f, 90.0f, false, 4.0f);
-    modelList.push_back(coralObj);
+    Model3D coralObj = Model3D(meshRegistry.acquire("3D/coral.obj", false), -10.0f, -30.0f, 20.0f, 0.0f, 0.0f, 1.0f, 0.1f, 0.1f, 0.1f, 90.0f, 4.0f);
+    modelList.push_back(std::move(coralObj));
 
     /* https://free3d.com/3d-model/aquarium-deep-sea-diver-v1--436500.html */
-    Model3D diverObj = Model3D("3D/diver.obj", 20.0f, -30.0f, -10.0f, 0.0f, 0.0f, 1.0f, 0.3f, 0.3f, 0.3f, 90.0f, false, 4.0f);
-    modelList.push_back(diverObj);
+    Model3D diverObj = Model3D(meshRegistry.acquire("3D/diver.obj", false), 20.0f, -30.0f, -10.0f, 0.0f, 0.0f, 1.0f, 0.3f, 0.3f, 0.3f, 90.0f, 4.0f);
+    modelList.push_back(std::move(diverObj));
+
+    /* Materials, the fauna textures are in the same order as the models. They go into texture arrays by size, every one of them decodes at the same time on the loader pool.
+       Only the smaller mips are loaded at first, textureResidency streams the finer ones in as models come closer. Without the texture cache
+       it cannot, every image is decoded whole anyway so the whole chain is loaded and the residency only drops levels */
+    std::vector<TextureArraySlot> faunaSlots;
+    textureLoader.load_array(std::vector<std::string>(texture_filenames, texture_filenames + textures_count), true,
+        textureLoader.streams_levels() ? TextureResidency::START_LEVEL : 0, textureSplitBytes, faunaSlots);
+    for (int i = 0; i < textures_count; i++) {
+        modelList[i].texture = faunaSlots[i].texture;
+        modelList[i].texture_layer = faunaSlots[i].layer;
+    }
 
-    const int modelCount = 7;
-    GLuint VAO[modelCount], VBO[modelCount];
+    /* --turtles <count> adds a school of turtles around the first one, they all share its buffers */
+    if (const char* value = flag_value(argc, argv, "--turtles")) {
+        int turtleCount = std::atoi(value);
+        for (int i = 0; i < turtleCount; i++) {
+            Model3D schoolTurtle = Model3D(modelList[3].mesh, -10.0f + 6.0f * (i % 10), -20.0f - 6.0f * (i / 100), 16.0f + 6.0f * (i / 10 % 10),
+                0.0f, 0.0f, 1.0f, 0.05f, 0.05f, 0.05f, 90.0f, 4.0f);
+            schoolTurtle.rotate_on_axis(90.0f, glm::vec3(0.0f, 1.0f, 0.0f));
+            schoolTurtle.texture = modelList[3].texture;
+            schoolTurtle.texture_layer = modelList[3].texture_layer;
+            modelList.push_back(std::move(schoolTurtle));
+        }
+    }
 
-    /* Setup VAO and VBOs */
-    glGenVertexArrays(modelCount, VAO);
-    glGenBuffers(modelCount, VBO);
+    /* Models drawn with the main shader, grouped by texture array so each array is bound once per frame */
+    std::vector<size_t> drawOrder;
+    for (size_t i = 1; i < modelList.size(); i++) {
+        drawOrder.push_back(i);
+    }
+    std::stable_sort(drawOrder.begin(), drawOrder.end(), [](size_t a, size_t b) {
+        return modelList[a].texture < modelList[b].texture;
+    });
 
-    /* Initialize buffers for main ship obj with normal maps */
-    glBindVertexArray(VAO[0]);
-    modelList[0].init_buffers_with_normals(VAO[0], VBO[0]);
+    /* Load the normal map */
+    /* https://www.filterforge.com/filters/1160-normal.jpg */
+    textureLoader.load_2d("3D/rock_normal.jpg", norm_tex, true, true);
 
-    /* Inititalize buffers for rest of obj in list */
-    for (int i = 1; i < modelCount; i++) {
-        glBindVertexArray(VAO[i]);
-        modelList[i].init_buffers(VAO[i], VBO[i]);
+    /* Skybox faces, the cube map samples black until all six are in */
+    for (unsigned int i = 0; i < 6; i++) {
+        bool flip = i == 2; /* uw_up looks wrong is not flipped */
+        textureLoader.load_cube_face(facesSkybox[i], skyboxTexture, i, flip);
     }
+    bool loadReported = false;
 
     projection_matrix = pcam.GetPer(60.f);
     skybox_projection_matrix = pcam.GetPer(60.f);
@@ -372,13 +457,63 @@ int main(void)
 
     glm::vec3 ambientColor = glm::vec3(1, 1, 1);
 
+    /* Triangles drawn against what full detail would have drawn, averaged over the run */
+    double lodTriangles = 0.0;
+    double fullTriangles = 0.0;
+    size_t lodFrames = 0;
+    double textureBinds = 0.0;
+
+    /* Hidden windows may not own their pixels, measuring renders into a framebuffer of the same size instead */
+    GLuint overdrawFramebuffer = 0, overdrawColor = 0, overdrawDepth = 0;
+    GLuint skyboxQuery = 0, modelQuery = 0;
+    int overdrawFramesDone = 0;
+    double skyboxFragments[2] = { 0.0, 0.0 }; // skybox last, skybox first
+    double modelFragments[2] = { 0.0, 0.0 };
+    if (overdrawFrames > 0) {
+        glGenRenderbuffers(1, &overdrawColor);
+        glBindRenderbuffer(GL_RENDERBUFFER, overdrawColor);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, (GLsizei)screenWidth, (GLsizei)screenHeight);
+        glGenRenderbuffers(1, &overdrawDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, overdrawDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, (GLsizei)screenWidth, (GLsizei)screenHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &overdrawFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, overdrawFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, overdrawColor);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, overdrawDepth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Overdraw framebuffer is incomplete" << std::endl;
+        }
+        glViewport(0, 0, (GLsizei)screenWidth, (GLsizei)screenHeight);
+
+        glGenQueries(1, &skyboxQuery);
+        glGenQueries(1, &modelQuery);
+    }
+
     while (!glfwWindowShouldClose(window))
     {
         processInput(window);
 
+        /* Upload whatever finished loading since the last frame */
+        textureLoader.pump();
+        streamer.pump(uploadBudgetMs);
+        if (!loadReported && streamer.is_done()) {
+            loadReported = true;
+            MeshLoader::print_load_report(meshRegistry.load_stats(), streamer.elapsed_ms(), loaderPool.size());
+            VertexPacker::print_report(meshRegistry.vertex_stats());
+            meshRegistry.print_report();
+            textureLoader.print_report();
+            streamer.print_report();
+        }
+
         /* Render here */
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        /* Frames measured for overdraw alternate, even ones draw the skybox last as usual and odd ones first as it used to be */
+        bool measuring = overdrawFrames > 0 && loadReported;
+        bool skyboxFirst = measuring && overdrawFramesDone % 2 == 1;
+
         /* Get projection and view matrix from perspective camera */
         if (isPers) {
             viewMatrix = camera.GetViewMatrixThird();
@@ -400,30 +535,41 @@ int main(void)
         plight.lightPos.y = modelList[0].transformation_matrix[3][1];
         plight.lightPos.z = modelList[0].transformation_matrix[3][2] - 2.f;
 
-        /* Render skybox */
-        glDepthMask(GL_FALSE);
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader.useShaderProgram();
+        /* Render skybox. Its vertices sit at the far plane, drawn after the models with GL_LEQUAL only the pixels they left
+           uncovered pass the depth test and sample the cubemap. It never writes depth, so drawn first it shades every pixel */
+        auto drawSkybox = [&]() {
+            glDepthMask(GL_FALSE);
+            skyboxShader.useShaderProgram();
 
-        glm::mat4 sky_view = glm::mat4(1.0f);
-        sky_view = glm::mat4(glm::mat3(viewMatrix));
+            glm::mat4 sky_view = glm::mat4(1.0f);
+            sky_view = glm::mat4(glm::mat3(viewMatrix));
 
-        unsigned int sky_projectionLoc = glGetUniformLocation(skyboxShader.getID() , "projection");
-        glUniformMatrix4fv(sky_projectionLoc, 1, GL_FALSE, glm::value_ptr(skybox_projection_matrix));
+            unsigned int sky_projectionLoc = glGetUniformLocation(skyboxShader.getID() , "projection");
+            glUniformMatrix4fv(sky_projectionLoc, 1, GL_FALSE, glm::value_ptr(skybox_projection_matrix));
 
-        unsigned int sky_viewLoc = glGetUniformLocation(skyboxShader.getID(), "view");
-        glUniformMatrix4fv(sky_viewLoc, 1, GL_FALSE, glm::value_ptr(sky_view));
+            unsigned int sky_viewLoc = glGetUniformLocation(skyboxShader.getID(), "view");
+            glUniformMatrix4fv(sky_viewLoc, 1, GL_FALSE, glm::value_ptr(sky_view));
 
-        unsigned int firstPersonSkyboxLoc = glGetUniformLocation(skyboxShader.getID(), "firstPerson");
-        glUniform1f(firstPersonSkyboxLoc, isFirstPerson);
+            unsigned int firstPersonSkyboxLoc = glGetUniformLocation(skyboxShader.getID(), "firstPerson");
+            glUniform1f(firstPersonSkyboxLoc, isFirstPerson);
+
+            if (measuring) {
+                glBeginQuery(GL_SAMPLES_PASSED, skyboxQuery);
+            }
+            glBindVertexArray(skyboxVAO);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
+            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+            if (measuring) {
+                glEndQuery(GL_SAMPLES_PASSED);
+            }
+            glDepthMask(GL_TRUE);
+        };
+        if (skyboxFirst) {
+            drawSkybox();
+        }
 
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-        glDepthMask(GL_TRUE);
-        glDepthFunc(GL_LEQUAL);
-        
         /* Set uniforms in main shader files */
         mainShader.useShaderProgram();
 
@@ -497,6 +643,8 @@ int main(void)
 
         GLuint texOAddress = glGetUniformLocation(mainShader.getID(), "tex0");
         glUniform1i(texOAddress, 0);
+        unsigned int layerLoc = glGetUniformLocation(mainShader.getID(), "layer");
+        unsigned int minLodLoc = glGetUniformLocation(mainShader.getID(), "minLod");
 
         unsigned int firstPersonLoc = glGetUniformLocation(mainShader.getID(), "firstPerson");
         glUniform1f(firstPersonLoc, isFirstPerson);
@@ -551,41 +699,137 @@ int main(void)
         glUniform1i(normTexOAddress, 0);
         GLuint normTex2Address = glGetUniformLocation(normalShader.getID(), "norm_tex");
         glUniform1i(normTex2Address, 1);
+        unsigned int normLayerLoc = glGetUniformLocation(normalShader.getID(), "layer");
+        glUniform1i(normLayerLoc, modelList[0].texture_layer);
+        unsigned int normMinLodLoc = glGetUniformLocation(normalShader.getID(), "minLod");
 
         /* Draw submarine object */
+        if (measuring) {
+            glBeginQuery(GL_SAMPLES_PASSED, modelQuery);
+        }
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textures[0]);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, modelList[0].texture);
+        textureBinds++;
 
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, norm_tex); 
 
-        if (isPers or isOrtho) {
-            modelList[0].draw(normTransformationLoc, 0, mainObj.fullVertexData.size() / 14, VAO[0]);
+        if ((isPers or isOrtho) && modelList[0].is_ready()) {
+            unsigned int lod = modelList[0].select_lod(viewMatrix, projection_matrix, screenHeight, lodBias);
+            glUniform1f(normMinLodLoc, textureResidency.request(modelList[0].texture, modelList[0].texture_layer,
+                modelList[0].screen_size(camera.Position, projection_matrix, screenHeight)));
+            modelList[0].apply_vertex_layout(normalShader.getID());
+            modelList[0].draw(normTransformationLoc, lod);
+            lodTriangles += modelList[0].mesh->lods[lod].index_count / 3;
+            fullTriangles += modelList[0].get_index_count() / 3;
             //modelList[0].printDepth();
         }
 
-        /* Unbind textures */
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        /* Unbind the normal map, the shark's array stays on unit 0 for the models that share it */
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, 0);
 
         /* Use main shader to draw rest of models */
         mainShader.useShaderProgram();
 
-        /* Draw rest of models in dolphin, shark, turtle, angelfish, coral, diver */
-        for (int i = 1; i < modelList.size(); i++) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, textures[i]);
-            modelList[i].draw(transformationLoc, 0, modelList[i].fullVertexData.size() / 8, VAO[i]);
+        /* Draw rest of models in dolphin, shark, turtle, angelfish, coral, diver, only the layer changes between models in one array */
+        glActiveTexture(GL_TEXTURE0);
+        GLuint boundTexture = modelList[0].texture;
+        for (size_t i : drawOrder) {
+            if (!modelList[i].is_ready()) {
+                continue;
+            }
+            if (modelList[i].texture != boundTexture) {
+                boundTexture = modelList[i].texture;
+                glBindTexture(GL_TEXTURE_2D_ARRAY, boundTexture);
+                textureBinds++;
+            }
+            glUniform1i(layerLoc, modelList[i].texture_layer);
+            glUniform1f(minLodLoc, textureResidency.request(modelList[i].texture, modelList[i].texture_layer,
+                modelList[i].screen_size(camera.Position, projection_matrix, screenHeight)));
+            unsigned int lod = modelList[i].select_lod(viewMatrix, projection_matrix, screenHeight, lodBias);
+            modelList[i].apply_vertex_layout(mainShader.getID());
+            modelList[i].draw(transformationLoc, lod);
+            lodTriangles += modelList[i].mesh->lods[lod].index_count / 3;
+            fullTriangles += modelList[i].get_index_count() / 3;
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        lodFrames++;
+        if (measuring) {
+            glEndQuery(GL_SAMPLES_PASSED);
         }
+
+        if (!skyboxFirst) {
+            drawSkybox();
+        }
+
+        /* Mips the draws asked for stream in or make room now, they are sampled from the next frames on */
+        textureResidency.update();
   
         /* Swap front and back buffers */
         glfwSwapBuffers(window);
+        streamer.end_frame();
+
+        /* Waiting on the queries stalls, which only the measuring run does */
+        if (measuring) {
+            GLuint samples = 0;
+            glGetQueryObjectuiv(skyboxQuery, GL_QUERY_RESULT, &samples);
+            skyboxFragments[skyboxFirst ? 1 : 0] += samples;
+            glGetQueryObjectuiv(modelQuery, GL_QUERY_RESULT, &samples);
+            modelFragments[skyboxFirst ? 1 : 0] += samples;
+            overdrawFramesDone++;
+            if (overdrawFramesDone >= 2 * overdrawFrames) {
+                glfwSetWindowShouldClose(window, true);
+            }
+        }
 
         /* Poll for and process events */
         glfwPollEvents();
     }
+
+    if (lodFrames > 0) {
+        char lodReport[256];
+        snprintf(lodReport, sizeof(lodReport), "LOD: %.0f of %.0f triangles per frame on average (%.1f%%), bias %.3f px\n",
+            lodTriangles / lodFrames, fullTriangles / lodFrames, fullTriangles > 0.0 ? 100.0 * lodTriangles / fullTriangles : 0.0, lodBias);
+        std::cout << lodReport << std::flush;
+
+        snprintf(lodReport, sizeof(lodReport), "Texture binds: %.1f per frame on average for %zu models\n",
+            textureBinds / lodFrames, modelList.size());
+        std::cout << lodReport << std::flush;
+        textureResidency.print_report();
+    }
+
+    if (overdrawFramesDone > 0) {
+        const char* orders[2] = { "skybox last ", "skybox first" };
+        double pixels = (double)screenWidth * screenHeight;
+        double frames[2] = { (double)((overdrawFramesDone + 1) / 2), (double)(overdrawFramesDone / 2) };
+        char overdrawReport[256];
+        snprintf(overdrawReport, sizeof(overdrawReport), "Overdraw over %d frames of each order at %.0f x %.0f\n",
+            overdrawFramesDone / 2, screenWidth, screenHeight);
+        std::cout << overdrawReport;
+        for (int order = 0; order < 2; order++) {
+            if (frames[order] <= 0.0) {
+                continue;
+            }
+            double skybox = skyboxFragments[order] / frames[order], models = modelFragments[order] / frames[order];
+            snprintf(overdrawReport, sizeof(overdrawReport), "  %s skybox %9.0f fragments (%5.1f%% of the screen)  models %9.0f  %.2f fragments per pixel\n",
+                orders[order], skybox, 100.0 * skybox / pixels, models, (skybox + models) / pixels);
+            std::cout << overdrawReport;
+        }
+        if (frames[1] > 0.0) {
+            double saved = skyboxFragments[1] / frames[1] - skyboxFragments[0] / frames[0];
+            snprintf(overdrawReport, sizeof(overdrawReport), "  drawing it last skips %.0f cubemap fragments per frame (%.1f%%)\n",
+                saved, skyboxFragments[1] > 0.0 ? 100.0 * saved * frames[1] / skyboxFragments[1] : 0.0);
+            std::cout << overdrawReport;
+        }
+        std::cout << std::flush;
+
+        glDeleteQueries(1, &skyboxQuery);
+        glDeleteQueries(1, &modelQuery);
+        glDeleteFramebuffers(1, &overdrawFramebuffer);
+        glDeleteRenderbuffers(1, &overdrawColor);
+        glDeleteRenderbuffers(1, &overdrawDepth);
+    }
     
     glfwTerminate();
     return 0;